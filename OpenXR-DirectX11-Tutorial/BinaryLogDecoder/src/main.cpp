@@ -0,0 +1,294 @@
+// Turns a binary log written by BinaryLog (the BLOG macro) back into text.
+//
+//   BinaryLogDecoder <log file> [output file]
+//
+// Without an output file, the text goes to stdout.
+
+#include "../../OpenXR-DirectX11-Tutorial/src/BinaryLogFormat.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace BinaryLogFormat;
+
+struct DecodedFormat
+{
+	Level		level;
+	uint32_t	line;
+	std::string	file;
+	std::string	format;
+};
+
+struct DecodedArg
+{
+	ArgType		type;
+	int64_t		intValue;
+	uint64_t	uintValue;
+	double		doubleValue;
+	std::string	stringValue;
+};
+
+const char* LevelName(Level level)
+{
+	switch (level)
+	{
+	case Level::Debug:   return "DEBUG";
+	case Level::Info:    return "INFO";
+	case Level::Warning: return "WARNING";
+	case Level::Error:   return "ERROR";
+	}
+	return "?";
+}
+
+// Reads a value from the payload, and fails rather than running off the end
+template <typename T>
+bool ReadValue(const uint8_t*& in, const uint8_t* end, T& value)
+{
+	if ((size_t)(end - in) < sizeof(T))
+		return false;
+	memcpy(&value, in, sizeof(T));
+	in += sizeof(T);
+	return true;
+}
+
+bool ReadString(const uint8_t*& in, const uint8_t* end, std::string& value)
+{
+	uint16_t length = 0;
+	if (!ReadValue(in, end, length) || (size_t)(end - in) < length)
+		return false;
+	value.assign((const char*)in, length);
+	in += length;
+	return true;
+}
+
+bool ReadArgs(const uint8_t* in, const uint8_t* end, std::vector<DecodedArg>& args)
+{
+	args.clear();
+	while (in < end)
+	{
+		uint8_t type = *in++;
+		DecodedArg arg = {};
+		arg.type = (ArgType)type;
+		bool ok = false;
+		switch ((ArgType)type)
+		{
+		case ArgType::Int64:   ok = ReadValue(in, end, arg.intValue); arg.uintValue = (uint64_t)arg.intValue; arg.doubleValue = (double)arg.intValue; break;
+		case ArgType::UInt64:
+		case ArgType::Pointer: ok = ReadValue(in, end, arg.uintValue); arg.intValue = (int64_t)arg.uintValue; arg.doubleValue = (double)arg.uintValue; break;
+		case ArgType::Double:  ok = ReadValue(in, end, arg.doubleValue); arg.intValue = (int64_t)arg.doubleValue; arg.uintValue = (uint64_t)arg.intValue; break;
+		case ArgType::String:  ok = ReadString(in, end, arg.stringValue); break;
+		default:
+			// Records are padded out to their alignment with zeroes
+			if (type == 0)
+				return true;
+			break;
+		}
+		if (!ok)
+			return false;
+		args.push_back(arg);
+	}
+	return true;
+}
+
+// Walks the printf format string, and formats each conversion with the next
+// argument. Length modifiers are thrown away, since every integer was stored
+// as 64 bits anyway.
+std::string FormatMessage(const std::string& format, const std::vector<DecodedArg>& args)
+{
+	std::string result;
+	size_t nextArg = 0;
+	char buffer[512];
+
+	for (size_t i = 0; i < format.size(); i++)
+	{
+		if (format[i] != '%')
+		{
+			result += format[i];
+			continue;
+		}
+		if (i + 1 < format.size() && format[i + 1] == '%')
+		{
+			result += '%';
+			i++;
+			continue;
+		}
+
+		// Flags, width and precision are kept as they are
+		std::string spec = "%";
+		size_t j = i + 1;
+		while (j < format.size() && strchr("-+ #0123456789.", format[j]) != nullptr)
+			spec += format[j++];
+		while (j < format.size() && strchr("hljztL", format[j]) != nullptr)
+			j++;
+		if (j >= format.size())
+		{
+			result += format.substr(i);
+			break;
+		}
+		char conversion = format[j];
+		i = j;
+
+		if (nextArg >= args.size())
+		{
+			result += "<missing>";
+			continue;
+		}
+		const DecodedArg& arg = args[nextArg++];
+
+		switch (conversion)
+		{
+		case 'd': case 'i':
+			snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), (long long)arg.intValue);
+			break;
+		case 'u': case 'x': case 'X': case 'o':
+			snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(), (unsigned long long)arg.uintValue);
+			break;
+		case 'c':
+			snprintf(buffer, sizeof(buffer), (spec + "c").c_str(), (int)arg.intValue);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), arg.doubleValue);
+			break;
+		case 's':
+			snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), arg.type == ArgType::String ? arg.stringValue.c_str() : "<not a string>");
+			break;
+		case 'p':
+			snprintf(buffer, sizeof(buffer), "0x%016llx", (unsigned long long)arg.uintValue);
+			break;
+		default:
+			snprintf(buffer, sizeof(buffer), "<bad format %%%c>", conversion);
+			break;
+		}
+		result += buffer;
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: BinaryLogDecoder <log file> [output file]\n");
+		return 1;
+	}
+
+	FILE* input = fopen(argv[1], "rb");
+	if (input == nullptr)
+	{
+		fprintf(stderr, "Couldn't open %s\n", argv[1]);
+		return 1;
+	}
+	fseek(input, 0, SEEK_END);
+	long fileSize = ftell(input);
+	fseek(input, 0, SEEK_SET);
+	std::vector<uint8_t> data(fileSize > 0 ? (size_t)fileSize : 0);
+	size_t bytesRead = data.empty() ? 0 : fread(data.data(), 1, data.size(), input);
+	fclose(input);
+
+	FileHeader header = {};
+	if (bytesRead < sizeof(FileHeader))
+	{
+		fprintf(stderr, "%s is too small to be a binary log\n", argv[1]);
+		return 1;
+	}
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+	{
+		fprintf(stderr, "%s isn't a binary log, or is from a different version\n", argv[1]);
+		return 1;
+	}
+	if (header.headerSize < sizeof(FileHeader) || header.headerSize > bytesRead)
+	{
+		fprintf(stderr, "%s has a broken header\n", argv[1]);
+		return 1;
+	}
+
+	FILE* output = stdout;
+	if (argc >= 3)
+	{
+		output = fopen(argv[2], "w");
+		if (output == nullptr)
+		{
+			fprintf(stderr, "Couldn't create %s\n", argv[2]);
+			return 1;
+		}
+	}
+
+	// If the app crashed, used can run past the data. It can also run past
+	// capacity if the log filled up.
+	const uint8_t* records = data.data() + header.headerSize;
+	uint64_t available = bytesRead - header.headerSize;
+	uint64_t end = header.used < header.capacity ? header.used : header.capacity;
+	if (end > available)
+		end = available;
+
+	// Formats can show up after messages that use them, so gather them all
+	// up front.
+	std::unordered_map<uint16_t, DecodedFormat> formats;
+	uint64_t pendingRecords = 0;
+	for (int32_t pass = 0; pass < 2; pass++)
+	{
+		std::vector<DecodedArg> args;
+		for (uint64_t offset = 0; offset + sizeof(RecordHeader) <= end; )
+		{
+			RecordHeader record;
+			memcpy(&record, records + offset, sizeof(record));
+			if (record.size < sizeof(RecordHeader) || offset + record.size > end)
+				break;
+
+			const uint8_t* payload = records + offset + sizeof(RecordHeader);
+			const uint8_t* payloadEnd = records + offset + record.size;
+			offset += record.size;
+
+			if (pass == 0 && record.kind == (uint8_t)RecordKind::Format)
+			{
+				DecodedFormat format = {};
+				uint8_t level = 0;
+				if (ReadValue(payload, payloadEnd, level) && ReadValue(payload, payloadEnd, format.line) &&
+					ReadString(payload, payloadEnd, format.file) && ReadString(payload, payloadEnd, format.format))
+				{
+					format.level = (Level)level;
+					formats[record.formatID] = format;
+				}
+			}
+			else if (pass == 1 && record.kind == (uint8_t)RecordKind::Pending)
+			{
+				pendingRecords++;
+			}
+			else if (pass == 1 && record.kind == (uint8_t)RecordKind::Message)
+			{
+				double milliseconds = (double)(int64_t)(record.time - header.startTime) / 1000000.0;
+				auto found = formats.find(record.formatID);
+				if (found == formats.end())
+				{
+					fprintf(output, "%12.3f [%3u] ? Unknown format %u\n", milliseconds, record.threadID, record.formatID);
+					continue;
+				}
+
+				const DecodedFormat& format = found->second;
+				std::string message = ReadArgs(payload, payloadEnd, args) ? FormatMessage(format.format, args) : "<corrupt arguments>";
+
+				// Just the file name, the full path is mostly noise
+				const char* fileName = format.file.c_str();
+				for (const char* c = fileName; *c != '\0'; c++)
+				{
+					if (*c == '/' || *c == '\\')
+						fileName = c + 1;
+				}
+				fprintf(output, "%12.3f [%3u] %-7s %s:%u %s\n", milliseconds, record.threadID, LevelName(format.level), fileName, format.line, message.c_str());
+			}
+		}
+	}
+
+	if (pendingRecords > 0)
+		fprintf(stderr, "%llu records were never finished\n", (unsigned long long)pendingRecords);
+	if (header.dropped > 0)
+		fprintf(stderr, "The log filled up, %llu messages were dropped\n", (unsigned long long)header.dropped);
+
+	if (output != stdout)
+		fclose(output);
+	return 0;
+}
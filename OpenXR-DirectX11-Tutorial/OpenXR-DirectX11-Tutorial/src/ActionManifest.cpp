@@ -0,0 +1,340 @@
+#include "ActionManifest.h"
+#include "Platform.h"
+#include "StartupTrace.h"
+
+#include "easylogging++.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+using namespace ActionManifest;
+
+struct ManifestActionSet
+{
+	std::string		name;
+	std::string		localizedName;
+	XrActionSet		handle;
+};
+
+struct ManifestAction
+{
+	std::string					name;
+	std::string					localizedName;
+	XrActionType				type;
+	uint32_t					actionSet;
+	std::vector<std::string>	subactionNames;
+	std::vector<XrPath>			subactionPaths;
+	XrAction					handle;
+};
+
+struct ManifestBinding
+{
+	uint32_t		profile;
+	ActionID		action;
+	std::string		path;
+};
+
+// The same layout the app used before it had a manifest
+const char* manifestDefault =
+	"action_set gameplay Gameplay\n"
+	"subactions /user/hand/left /user/hand/right\n"
+	"action hand_pose pose Hand Pose\n"
+	"action select boolean Select\n"
+	"profile /interaction_profiles/khr/simple_controller\n"
+	"bind hand_pose /user/hand/left/input/grip/pose\n"
+	"bind hand_pose /user/hand/right/input/grip/pose\n"
+	"bind select /user/hand/left/input/select/click\n"
+	"bind select /user/hand/right/input/select/click\n";
+
+XrInstance								manifestInstance = XR_NULL_HANDLE;
+std::vector<ManifestActionSet>			manifestActionSets;
+std::vector<ManifestAction>				manifestActions;
+std::vector<std::string>				manifestProfiles;
+std::vector<ManifestBinding>			manifestBindings;
+std::vector<XrActiveActionSet>			manifestActiveSets;
+
+// Interned paths. The reverse table points at the keys of the forward one,
+// which stay put as the table grows.
+std::unordered_map<std::string, XrPath>			manifestPathByName;
+std::unordered_map<XrPath, const std::string*>	manifestNameByPath;
+
+bool ManifestParseActionType(const std::string& name, XrActionType& type)
+{
+	if      (name == "boolean")   type = XR_ACTION_TYPE_BOOLEAN_INPUT;
+	else if (name == "float")     type = XR_ACTION_TYPE_FLOAT_INPUT;
+	else if (name == "vector2")   type = XR_ACTION_TYPE_VECTOR2F_INPUT;
+	else if (name == "pose")      type = XR_ACTION_TYPE_POSE_INPUT;
+	else if (name == "vibration") type = XR_ACTION_TYPE_VIBRATION_OUTPUT;
+	else return false;
+	return true;
+}
+
+bool ActionManifest::Load(const char* path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		LOG(INFO) << "No action manifest at " << path << ", using the built-in one";
+		return Parse(manifestDefault);
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+	LOG(INFO) << "Loading actions from " << path;
+	if (!Parse(text.str().c_str()))
+	{
+		LOG(ERROR) << "The action manifest " << path << " has errors";
+		return false;
+	}
+	return true;
+}
+
+bool ActionManifest::Parse(const char* text)
+{
+	manifestActionSets.clear();
+	manifestActions.clear();
+	manifestProfiles.clear();
+	manifestBindings.clear();
+
+	std::vector<std::string> subactions;
+	std::istringstream lines(text);
+	std::string line;
+	int32_t lineNumber = 0;
+	bool ok = true;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		// Whatever's left of the line, for localized names with spaces in them
+		auto restOfLine = [&words]()
+		{
+			std::string rest;
+			std::getline(words >> std::ws, rest);
+			while (!rest.empty() && (rest.back() == '\r' || rest.back() == ' ' || rest.back() == '\t'))
+				rest.pop_back();
+			return rest;
+		};
+
+		if (keyword == "action_set")
+		{
+			ManifestActionSet actionSet = {};
+			words >> actionSet.name;
+			actionSet.localizedName = restOfLine();
+			if (actionSet.localizedName.empty())
+				actionSet.localizedName = actionSet.name;
+			manifestActionSets.push_back(actionSet);
+		}
+		else if (keyword == "subactions")
+		{
+			subactions.clear();
+			std::string path;
+			while (words >> path)
+				subactions.push_back(path);
+		}
+		else if (keyword == "action" && !manifestActionSets.empty())
+		{
+			ManifestAction action = {};
+			std::string type;
+			words >> action.name >> type;
+			if (!ManifestParseActionType(type, action.type))
+			{
+				LOG(WARNING) << "Action manifest line " << lineNumber << ": unknown action type " << type;
+				ok = false;
+				continue;
+			}
+			action.localizedName = restOfLine();
+			if (action.localizedName.empty())
+				action.localizedName = action.name;
+			action.actionSet = (uint32_t)manifestActionSets.size() - 1;
+			action.subactionNames = subactions;
+			manifestActions.push_back(action);
+		}
+		else if (keyword == "profile")
+		{
+			std::string profile;
+			words >> profile;
+			manifestProfiles.push_back(profile);
+		}
+		else if (keyword == "bind" && !manifestProfiles.empty())
+		{
+			ManifestBinding binding = {};
+			std::string actionName;
+			words >> actionName >> binding.path;
+			binding.profile = (uint32_t)manifestProfiles.size() - 1;
+			binding.action = FindAction(actionName.c_str());
+			if (binding.action < 0)
+			{
+				LOG(WARNING) << "Action manifest line " << lineNumber << ": unknown action " << actionName;
+				ok = false;
+				continue;
+			}
+			manifestBindings.push_back(binding);
+		}
+		else
+		{
+			LOG(WARNING) << "Action manifest line " << lineNumber << ": don't know what to do with " << keyword;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+XrPath ActionManifest::InternPath(const char* path)
+{
+	auto found = manifestPathByName.find(path);
+	if (found != manifestPathByName.end())
+		return found->second;
+	if (manifestInstance == XR_NULL_HANDLE)
+		return XR_NULL_PATH;
+
+	XrPath xrPath = XR_NULL_PATH;
+	if (XR_FAILED(xrStringToPath(manifestInstance, path, &xrPath)))
+	{
+		LOG(WARNING) << "Invalid OpenXR path " << path;
+		return XR_NULL_PATH;
+	}
+	auto inserted = manifestPathByName.emplace(path, xrPath).first;
+	manifestNameByPath[xrPath] = &inserted->first;
+	return xrPath;
+}
+
+const char* ActionManifest::PathToString(XrPath path)
+{
+	auto found = manifestNameByPath.find(path);
+	return found == manifestNameByPath.end() ? "" : found->second->c_str();
+}
+
+bool ActionManifest::Create(XrInstance instance)
+{
+	StartupTrace::Scope trace("Create actions");
+	manifestInstance = instance;
+
+	manifestActiveSets.clear();
+	for (ManifestActionSet& actionSet : manifestActionSets)
+	{
+		XrActionSetCreateInfo actionsetCreateInfo = { XR_TYPE_ACTION_SET_CREATE_INFO };
+		Platform::CopyString(actionsetCreateInfo.actionSetName, actionSet.name.c_str());
+		Platform::CopyString(actionsetCreateInfo.localizedActionSetName, actionSet.localizedName.c_str());
+		if (XR_FAILED(xrCreateActionSet(instance, &actionsetCreateInfo, &actionSet.handle)))
+		{
+			LOG(WARNING) << "Couldn't create action set " << actionSet.name;
+			return false;
+		}
+		manifestActiveSets.push_back({ actionSet.handle, XR_NULL_PATH });
+	}
+
+	for (ManifestAction& action : manifestActions)
+	{
+		action.subactionPaths.clear();
+		for (const std::string& subaction : action.subactionNames)
+			action.subactionPaths.push_back(InternPath(subaction.c_str()));
+
+		XrActionCreateInfo actionCreateInfo = { XR_TYPE_ACTION_CREATE_INFO };
+		actionCreateInfo.countSubactionPaths = (uint32_t)action.subactionPaths.size();
+		actionCreateInfo.subactionPaths = action.subactionPaths.data();
+		actionCreateInfo.actionType = action.type;
+		Platform::CopyString(actionCreateInfo.actionName, action.name.c_str());
+		Platform::CopyString(actionCreateInfo.localizedActionName, action.localizedName.c_str());
+		if (XR_FAILED(xrCreateAction(manifestActionSets[action.actionSet].handle, &actionCreateInfo, &action.handle)))
+		{
+			LOG(WARNING) << "Couldn't create action " << action.name;
+			return false;
+		}
+	}
+
+	// Each profile gets its bindings in a single call. The runtime throws out
+	// the whole profile if any binding in it is bad, and runtimes that don't
+	// know a profile at all just fail the call, so neither is fatal.
+	std::vector<std::vector<XrActionSuggestedBinding>> profileBindings(manifestProfiles.size());
+	for (const ManifestBinding& binding : manifestBindings)
+		profileBindings[binding.profile].push_back({ manifestActions[binding.action].handle, InternPath(binding.path.c_str()) });
+
+	for (size_t i = 0; i < manifestProfiles.size(); i++)
+	{
+		XrInteractionProfileSuggestedBinding suggestedBindings = { XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING };
+		suggestedBindings.interactionProfile = InternPath(manifestProfiles[i].c_str());
+		suggestedBindings.suggestedBindings = profileBindings[i].data();
+		suggestedBindings.countSuggestedBindings = (uint32_t)profileBindings[i].size();
+		XrResult result = xrSuggestInteractionProfileBindings(instance, &suggestedBindings);
+		if (XR_FAILED(result))
+			LOG(WARNING) << "Bindings for " << manifestProfiles[i] << " weren't accepted (" << result << ")";
+	}
+
+	LOG(INFO) << manifestActions.size() << " actions, " << manifestProfiles.size() << " interaction profiles, "
+		<< manifestBindings.size() << " bindings, " << manifestPathByName.size() << " unique paths";
+	return true;
+}
+
+bool ActionManifest::Attach(XrSession session)
+{
+	std::vector<XrActionSet> actionSets;
+	for (const ManifestActionSet& actionSet : manifestActionSets)
+		actionSets.push_back(actionSet.handle);
+
+	XrSessionActionSetsAttachInfo actionsetsAttachInfo = { XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO };
+	actionsetsAttachInfo.countActionSets = (uint32_t)actionSets.size();
+	actionsetsAttachInfo.actionSets = actionSets.data();
+	return XR_SUCCEEDED(xrAttachSessionActionSets(session, &actionsetsAttachInfo));
+}
+
+void ActionManifest::Destroy()
+{
+	// Destroying an action set takes its actions with it
+	for (ManifestActionSet& actionSet : manifestActionSets)
+	{
+		if (actionSet.handle != XR_NULL_HANDLE)
+			xrDestroyActionSet(actionSet.handle);
+		actionSet.handle = XR_NULL_HANDLE;
+	}
+	for (ManifestAction& action : manifestActions)
+		action.handle = XR_NULL_HANDLE;
+	manifestActiveSets.clear();
+	manifestPathByName.clear();
+	manifestNameByPath.clear();
+	manifestInstance = XR_NULL_HANDLE;
+}
+
+ActionID ActionManifest::FindAction(const char* name)
+{
+	for (size_t i = 0; i < manifestActions.size(); i++)
+	{
+		if (manifestActions[i].name == name)
+			return (ActionID)i;
+	}
+	return -1;
+}
+
+uint32_t ActionManifest::GetActionCount()
+{
+	return (uint32_t)manifestActions.size();
+}
+
+XrAction ActionManifest::GetAction(ActionID action)
+{
+	return action >= 0 && (size_t)action < manifestActions.size() ? manifestActions[action].handle : XR_NULL_HANDLE;
+}
+
+XrActionType ActionManifest::GetActionType(ActionID action)
+{
+	return manifestActions[action].type;
+}
+
+const std::vector<XrPath>& ActionManifest::GetSubactionPaths(ActionID action)
+{
+	return manifestActions[action].subactionPaths;
+}
+
+const std::vector<XrActiveActionSet>& ActionManifest::GetActiveActionSets()
+{
+	return manifestActiveSets;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+#include <vector>
+
+// The app's actions and their suggested bindings, loaded from a manifest file
+// rather than written out in code. Supporting another controller is a few
+// more lines in the file, and costs nothing per frame.
+//
+// The manifest is plain text, one "keyword arguments" line at a time, with #
+// starting a comment:
+//
+//   action_set gameplay Gameplay
+//   subactions /user/hand/left /user/hand/right
+//   action select boolean Select
+//   profile /interaction_profiles/khr/simple_controller
+//   bind select /user/hand/left/input/select/click
+//
+// Actions belong to the last action_set, and use the last subactions line.
+// Action types are boolean, float, vector2, pose and vibration. bind lines
+// belong to the last profile, and each profile's bindings are suggested in
+// one call.
+//
+// Every path string is turned into an XrPath exactly once, however many
+// bindings use it, and kept in a hash table both ways. PathToString never
+// calls the runtime.
+namespace ActionManifest
+{
+	typedef int32_t ActionID;
+
+	// Falls back on a built-in manifest (the simple controller only) if the
+	// file can't be read. A file that's there but doesn't parse is an error,
+	// rather than something to quietly replace.
+	bool			Load(const char* path);
+	bool			Parse(const char* text);
+
+	// Creates the action sets and actions, and suggests the bindings for every
+	// profile. Attach must come after everything else has been suggested.
+	bool			Create(XrInstance instance);
+	bool			Attach(XrSession session);
+	void			Destroy();
+
+	ActionID		FindAction(const char* name);
+	uint32_t		GetActionCount();
+	XrAction		GetAction(ActionID action);
+	XrActionType	GetActionType(ActionID action);
+	const std::vector<XrPath>&	GetSubactionPaths(ActionID action);
+
+	// Ready to hand to xrSyncActions
+	const std::vector<XrActiveActionSet>&	GetActiveActionSets();
+
+	XrPath			InternPath(const char* path);
+	const char*		PathToString(XrPath path);
+}
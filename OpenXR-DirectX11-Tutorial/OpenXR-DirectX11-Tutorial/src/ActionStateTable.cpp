@@ -0,0 +1,222 @@
+#include "ActionStateTable.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace ActionStateTable;
+
+// How many times each edge has happened on a row, ever
+struct ActionTableEdges
+{
+	uint32_t	changed;
+	uint32_t	pressed;
+	uint32_t	released;
+};
+
+// The columns Poll fills in, one copy per buffer
+struct ActionTableState
+{
+	std::vector<ActionTableEdges>	edges;
+	std::vector<uint8_t>		flags;
+	std::vector<XrTime>			changeTime;
+	std::vector<XrBool32>		boolean;
+	std::vector<float>			value;
+	std::vector<XrVector2f>		vector2;
+};
+
+// Set on the middle index when it holds a poll the reader hasn't taken yet
+constexpr uint32_t actionTableFresh = 4;
+
+// Where each action's rows start, and the columns that don't change
+std::vector<uint32_t>		actionTableFirstRow;
+std::vector<XrAction>		actionTableAction;
+std::vector<XrPath>			actionTableSubaction;
+std::vector<XrActionType>	actionTableType;
+
+// Poses are only ever set and read on the reading side, so there's one copy
+std::vector<XrPosef>		actionTablePose;
+
+ActionTableState			actionTableStates[3];
+uint32_t					actionTablePolled = 0;		// Poller's copy
+uint32_t					actionTableRead = 1;		// Reader's copy
+std::atomic<uint32_t>		actionTableMiddle = { 2 };
+
+// Edge counts so far on the polling side, and as of the last Acquire on the
+// reading side. Acquire turns the difference back into flags, so edges from
+// polls that were published over before the reader took them aren't lost.
+std::vector<ActionTableEdges>	actionTablePolledEdges;
+std::vector<ActionTableEdges>	actionTableReadEdges;
+
+View ActionTableGetView(const ActionTableState& state, ActionManifest::ActionID action)
+{
+	View view = {};
+	if (action < 0 || (size_t)action + 1 >= actionTableFirstRow.size())
+		return view;
+
+	uint32_t row = actionTableFirstRow[action];
+	view.subactionCount = actionTableFirstRow[action + 1] - row;
+	view.type = actionTableType[row];
+	view.flags = &state.flags[row];
+	view.changeTime = &state.changeTime[row];
+	view.boolean = &state.boolean[row];
+	view.value = &state.value[row];
+	view.vector2 = &state.vector2[row];
+	view.pose = &actionTablePose[row];
+	return view;
+}
+
+void ActionStateTable::Build()
+{
+	actionTableFirstRow.clear();
+	actionTableAction.clear();
+	actionTableSubaction.clear();
+	actionTableType.clear();
+
+	// Actions without subaction paths still get one row, for XR_NULL_PATH
+	uint32_t actionCount = ActionManifest::GetActionCount();
+	for (ActionManifest::ActionID action = 0; action < (ActionManifest::ActionID)actionCount; action++)
+	{
+		actionTableFirstRow.push_back((uint32_t)actionTableAction.size());
+		const std::vector<XrPath>& subactions = ActionManifest::GetSubactionPaths(action);
+		uint32_t rows = subactions.empty() ? 1 : (uint32_t)subactions.size();
+		for (uint32_t i = 0; i < rows; i++)
+		{
+			actionTableAction.push_back(ActionManifest::GetAction(action));
+			actionTableSubaction.push_back(subactions.empty() ? XR_NULL_PATH : subactions[i]);
+			actionTableType.push_back(ActionManifest::GetActionType(action));
+		}
+	}
+	actionTableFirstRow.push_back((uint32_t)actionTableAction.size());
+
+	size_t rowCount = actionTableAction.size();
+	for (ActionTableState& state : actionTableStates)
+	{
+		state.edges.assign(rowCount, {});
+		state.flags.assign(rowCount, 0);
+		state.changeTime.assign(rowCount, 0);
+		state.boolean.assign(rowCount, XR_FALSE);
+		state.value.assign(rowCount, 0.0f);
+		state.vector2.assign(rowCount, { 0.0f, 0.0f });
+	}
+	actionTablePose.assign(rowCount, { { 0, 0, 0, 1 }, { 0, 0, 0 } });
+	actionTablePolledEdges.assign(rowCount, {});
+	actionTableReadEdges.assign(rowCount, {});
+	actionTablePolled = 0;
+	actionTableRead = 1;
+	actionTableMiddle.store(2);
+}
+
+void ActionStateTable::Poll(XrSession session)
+{
+	PROFILE_ZONE("ActionStateTable::Poll");
+
+	ActionTableState& table = actionTableStates[actionTablePolled];
+	XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
+	size_t rowCount = actionTableAction.size();
+	for (size_t row = 0; row < rowCount; row++)
+	{
+		getInfo.action = actionTableAction[row];
+		getInfo.subactionPath = actionTableSubaction[row];
+
+		uint8_t flags = 0;
+		switch (actionTableType[row])
+		{
+		case XR_ACTION_TYPE_BOOLEAN_INPUT:
+		{
+			XrActionStateBoolean state = { XR_TYPE_ACTION_STATE_BOOLEAN };
+			xrGetActionStateBoolean(session, &getInfo, &state);
+			flags = (state.isActive ? Active : 0) | (state.changedSinceLastSync ? Changed : 0);
+			if (state.changedSinceLastSync)
+				flags |= state.currentState ? Pressed : Released;
+			table.boolean[row] = state.currentState;
+			table.changeTime[row] = state.lastChangeTime;
+		} break;
+		case XR_ACTION_TYPE_FLOAT_INPUT:
+		{
+			XrActionStateFloat state = { XR_TYPE_ACTION_STATE_FLOAT };
+			xrGetActionStateFloat(session, &getInfo, &state);
+			flags = (state.isActive ? Active : 0) | (state.changedSinceLastSync ? Changed : 0);
+			table.value[row] = state.currentState;
+			table.changeTime[row] = state.lastChangeTime;
+		} break;
+		case XR_ACTION_TYPE_VECTOR2F_INPUT:
+		{
+			XrActionStateVector2f state = { XR_TYPE_ACTION_STATE_VECTOR2F };
+			xrGetActionStateVector2f(session, &getInfo, &state);
+			flags = (state.isActive ? Active : 0) | (state.changedSinceLastSync ? Changed : 0);
+			table.vector2[row] = state.currentState;
+			table.changeTime[row] = state.lastChangeTime;
+		} break;
+		case XR_ACTION_TYPE_POSE_INPUT:
+		{
+			XrActionStatePose state = { XR_TYPE_ACTION_STATE_POSE };
+			xrGetActionStatePose(session, &getInfo, &state);
+			flags = state.isActive ? Active : 0;
+		} break;
+		default:
+			// Output actions have no state to read
+			break;
+		}
+		table.flags[row] = flags;
+
+		ActionTableEdges& edges = actionTablePolledEdges[row];
+		edges.changed += (flags & Changed) != 0;
+		edges.pressed += (flags & Pressed) != 0;
+		edges.released += (flags & Released) != 0;
+		table.edges[row] = edges;
+	}
+}
+
+View ActionStateTable::GetPolledView(ActionManifest::ActionID action)
+{
+	return ActionTableGetView(actionTableStates[actionTablePolled], action);
+}
+
+void ActionStateTable::Publish()
+{
+	uint32_t previous = actionTableMiddle.exchange(actionTablePolled | actionTableFresh, std::memory_order_acq_rel);
+	actionTablePolled = previous & ~actionTableFresh;
+}
+
+bool ActionStateTable::Acquire()
+{
+	if ((actionTableMiddle.load(std::memory_order_relaxed) & actionTableFresh) == 0)
+		return false;
+	uint32_t previous = actionTableMiddle.exchange(actionTableRead, std::memory_order_acq_rel);
+	actionTableRead = previous & ~actionTableFresh;
+
+	// Flag every edge since the last poll we took, not just the newest one's
+	ActionTableState& table = actionTableStates[actionTableRead];
+	for (size_t row = 0; row < table.flags.size(); row++)
+	{
+		const ActionTableEdges& edges = table.edges[row];
+		ActionTableEdges& seen = actionTableReadEdges[row];
+		uint8_t flags = table.flags[row] & Active;
+		flags |= edges.changed != seen.changed ? Changed : 0;
+		flags |= edges.pressed != seen.pressed ? Pressed : 0;
+		flags |= edges.released != seen.released ? Released : 0;
+		table.flags[row] = flags;
+		seen = edges;
+	}
+	return true;
+}
+
+View ActionStateTable::GetView(ActionManifest::ActionID action)
+{
+	return ActionTableGetView(actionTableStates[actionTableRead], action);
+}
+
+uint32_t ActionStateTable::GetRowCount()
+{
+	return (uint32_t)actionTableAction.size();
+}
+
+void ActionStateTable::SetPose(ActionManifest::ActionID action, uint32_t subaction, const XrPosef& pose)
+{
+	if (action < 0 || (size_t)action + 1 >= actionTableFirstRow.size())
+		return;
+	uint32_t row = actionTableFirstRow[action] + subaction;
+	if (row < actionTableFirstRow[action + 1])
+		actionTablePose[row] = pose;
+}
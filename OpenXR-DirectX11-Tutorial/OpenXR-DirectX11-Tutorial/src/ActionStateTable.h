@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ActionManifest.h"
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+
+// The current state of every action in the manifest, for every subaction
+// path, kept in flat arrays: one row per action and subaction pair, one array
+// per kind of value. Build sizes the arrays once, after the actions exist.
+// Poll refills them without allocating, and everything else reads them
+// through const views that point straight into the table.
+//
+// Rows for an action are next to each other, so a View for an action is just
+// the address of its first row in each column, and the subaction index picks
+// the row.
+//
+// Polling can happen on a different thread to the reading, as it does when
+// the input sampler runs. There are three copies of the state: the poller
+// fills one, Publish swaps it with the one in the middle, and Acquire swaps
+// the middle one with the copy GetView reads. Neither side ever waits, and
+// the reader always gets a whole poll. After an Acquire, Pressed, Released
+// and Changed cover every poll since the last one, so no edge is lost if the
+// poller runs faster than the reader.
+namespace ActionStateTable
+{
+	// Per row flags
+	enum RowFlags : uint8_t
+	{
+		Active		= 1 << 0,	// Bound, and the action set is active
+		Changed		= 1 << 1,	// Changed since the last sync
+		Pressed		= 1 << 2,	// Boolean went false to true this sync
+		Released	= 1 << 3,	// Boolean went true to false this sync
+	};
+
+	struct View
+	{
+		uint32_t			subactionCount;
+		XrActionType		type;
+		const uint8_t*		flags;
+		const XrTime*		changeTime;
+		const XrBool32*		boolean;	// Boolean actions
+		const float*		value;		// Float actions
+		const XrVector2f*	vector2;	// Vector2 actions
+		const XrPosef*		pose;		// Pose actions, as last set with SetPose
+	};
+
+	void		Build();
+
+	// Polling thread side. GetPolledView reads what the last Poll saw, until
+	// the next Publish.
+	void		Poll(XrSession session);
+	View		GetPolledView(ActionManifest::ActionID action);
+	void		Publish();
+
+	// Reading thread side. Acquire picks up the latest published state, and
+	// returns false if nothing new was published. Views from before it point
+	// at old state.
+	bool		Acquire();
+	View		GetView(ActionManifest::ActionID action);
+	uint32_t	GetRowCount();
+
+	// Pose actions only report whether they're active. Whoever locates the
+	// action's space puts the pose here.
+	void		SetPose(ActionManifest::ActionID action, uint32_t subaction, const XrPosef& pose);
+}
@@ -0,0 +1,161 @@
+#include "AllocationTracker.h"
+#include "FrameTelemetry.h"
+
+#include "easylogging++.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Frames before this are still creating things for the first time, like
+// profiler buffers and the first upload of the scene
+const uint64_t allocationWarmupFrames = 120;
+
+// Only the first few failed frames are logged, there could be one a frame
+const uint64_t allocationMaxLoggedFrames = 10;
+
+std::atomic<uint64_t>	allocationCount = { 0 };
+thread_local bool		allocationThreadTracked = false;
+
+uint64_t				allocationFrame = 0;
+uint64_t				allocationFrameStart = 0;
+std::atomic<bool>		allocationFrameAllowed = { false };
+uint64_t				allocationFailedFrames = 0;
+FrameTelemetry::CounterID allocationCounter = -1;
+
+#if defined(ENABLE_ALLOCATION_TRACKING)
+
+void* AllocationTrackerAllocate(size_t size)
+{
+	if (allocationThreadTracked)
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size == 0 ? 1 : size);
+}
+
+void* AllocationTrackerAllocateAligned(size_t size, size_t alignment)
+{
+	if (allocationThreadTracked)
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+	size = size == 0 ? alignment : (size + alignment - 1) & ~(alignment - 1);
+#if defined(_WIN32)
+	return _aligned_malloc(size, alignment);
+#else
+	return aligned_alloc(alignment, size);
+#endif
+}
+
+void AllocationTrackerFreeAligned(void* pointer)
+{
+#if defined(_WIN32)
+	_aligned_free(pointer);
+#else
+	free(pointer);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	void* pointer = AllocationTrackerAllocate(size);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocationTrackerAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocationTrackerAllocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pointer = AllocationTrackerAllocateAligned(size, (size_t)alignment);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept								{ free(pointer); }
+void operator delete[](void* pointer) noexcept								{ free(pointer); }
+void operator delete(void* pointer, size_t) noexcept						{ free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept						{ free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept			{ free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept		{ free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept				{ AllocationTrackerFreeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept			{ AllocationTrackerFreeAligned(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept		{ AllocationTrackerFreeAligned(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept	{ AllocationTrackerFreeAligned(pointer); }
+
+bool AllocationTracker::IsEnabled()
+{
+	return true;
+}
+
+#else
+
+bool AllocationTracker::IsEnabled()
+{
+	return false;
+}
+
+#endif
+
+void AllocationTracker::TrackCurrentThread()
+{
+	allocationThreadTracked = true;
+}
+
+uint64_t AllocationTracker::GetCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::BeginFrame()
+{
+	if (allocationCounter < 0 && IsEnabled())
+		allocationCounter = FrameTelemetry::RegisterCounter("Heap allocations");
+	allocationFrameStart = GetCount();
+	allocationFrameAllowed.store(false, std::memory_order_relaxed);
+}
+
+void AllocationTracker::AllowThisFrame()
+{
+	allocationFrameAllowed.store(true, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::EndFrame()
+{
+	uint64_t allocations = GetCount() - allocationFrameStart;
+	FrameTelemetry::Add(allocationCounter, (int64_t)allocations);
+	allocationFrame++;
+	if (allocations == 0 || allocationFrameAllowed.load(std::memory_order_relaxed) || allocationFrame <= allocationWarmupFrames)
+		return true;
+
+	allocationFailedFrames++;
+	if (allocationFailedFrames <= allocationMaxLoggedFrames)
+		LOG(WARNING) << "Frame " << allocationFrame << " made " << allocations << " heap allocations, the frame loop shouldn't allocate once it's warmed up";
+	return false;
+}
+
+uint64_t AllocationTracker::GetFailedFrames()
+{
+	return allocationFailedFrames;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Counts heap allocations made on the frame loop and job threads, so we can
+// tell when the frame loop allocates once it's warmed up. It should never
+// need to: per-frame data goes in the FrameArena, and containers that are
+// reused each frame keep their capacity.
+//
+// Define ENABLE_ALLOCATION_TRACKING to turn it on, Debug builds do. It works
+// by replacing the global operator new, so it sees the standard containers
+// and anything else that uses new, but not direct calls to malloc, like the
+// ones inside the OpenXR runtime and the D3D driver. Without it, nothing is
+// counted and every frame passes.
+namespace AllocationTracker
+{
+	bool		IsEnabled();
+
+	// Only threads that opt in are counted, so background threads like the
+	// log writer don't get blamed on the frame
+	void		TrackCurrentThread();
+	uint64_t	GetCount();
+
+	// Once the first few frames are out of the way, a frame that allocates
+	// counts as failed, unless something called AllowThisFrame, like adding
+	// a cube growing the scene. EndFrame returns false for a failed frame.
+	void		BeginFrame();
+	void		AllowThisFrame();
+	bool		EndFrame();
+	uint64_t	GetFailedFrames();
+}
@@ -1,37 +1,392 @@
-#include "TutorialStructs.h"
-#include "OpenXR.h"
-#include "D3DRenderer.h"
-
-#include "Application.h"
-
-std::vector<XrPosef> cubePoses;
-
-void Application::Draw(XrCompositionLayerProjectionView& view)
-{
-	D3DRenderer::DrawCubes(view, cubePoses);
-}
-
-void Application::Update()
-{
-	// If the user presses the select action, lets add a cube at that location!
-	auto inputState = OpenXR::GetInputState();
-	for (uint32_t i = 0; i < 2; i++) 
-	{
-		if (inputState.handSelect[i])
-			cubePoses.push_back(inputState.handPose[i]);
-	}
-}
-
-void Application::UpdatePredicted()
-{
-	// Update the location of the hand cubes. This is done after the inputs have been updated to 
-	// use the predicted location, but during the render code, so we have the most up-to-date location.
-	if (cubePoses.size() < 2)
-		cubePoses.resize(2, OpenXR::GetIdentityPose());
-
-	auto inputState = OpenXR::GetInputState();
-	for (uint32_t i = 0; i < 2; i++) 
-	{
-		cubePoses[i] = inputState.renderHand[i] ? inputState.handPose[i] : OpenXR::GetIdentityPose();
-	}
-}
+#include "TutorialStructs.h"
+#include "OpenXR.h"
+#include "AllocationTracker.h"
+#include "D3DRenderer.h"
+#include "HandTracking.h"
+#include "JobSystem.h"
+#include "Picking.h"
+#include "Profiler.h"
+#include "SceneBVH.h"
+#include "SceneFile.h"
+#include "SceneStore.h"
+
+#include "Application.h"
+
+#include <algorithm>
+#include <mutex>
+
+// The two cubes that follow the hands are dynamic, and placed cubes are
+// static. Placed cubes are also kept in a BVH by handle slot, so each view
+// only draws the ones it can see, and as oriented boxes for picking, in the
+// same order as the static partition. Both are brought up to date from the
+// cubes that changed since placedSynced.
+SceneStore::Store scene;
+SceneStore::Handle handCubes[2] = { SceneStore::nullHandle, SceneStore::nullHandle };
+SceneBVH::Tree placedCubes;
+Picking::Boxes placedBoxes;
+uint64_t placedSynced = 0;
+
+// Placed cubes are drawn in the order of the BVH's leaves, so anything the
+// BVH groups together is a single run. placedDrawOrder is that order as
+// indices into the static partition, and the GPU keeps a copy of it that's
+// only uploaded again when placedDrawVersion changes, which is whenever the
+// placed cubes or the tree's shape have. The dynamic cubes are all drawn, in
+// order.
+SceneBVH::LeafOrder placedLeafOrder;
+std::vector<uint32_t> placedDrawOrder;
+uint64_t placedDrawVersion = 0;
+uint64_t placedDrawSynced = 0;
+std::vector<uint32_t> dynamicDrawOrder;
+
+// The runs of placedDrawOrder each view can see. Cull fills these in, a job
+// per view, and Draw reads them. OpenXR's view configurations have at most
+// four views. Each list always has room for every placed cube, so culling
+// never has to grow one mid-frame.
+const uint32_t maxViews = 4;
+std::vector<SceneBVH::Range> visibleCubes[maxViews];
+
+// The input sampler picks from its own thread, so placedBoxes and the handle
+// of each box are only changed with this held. The frame loop is the only
+// thing that changes them, so it can read them without it.
+std::mutex placedBoxesLock;
+std::vector<SceneStore::Handle> placedBoxHandles;
+
+// What each hand's ray is pointing at, and the last cube picked with select
+Picking::Hit handPointing[2] = { { -1, 0.0f }, { -1, 0.0f } };
+XrVector3f handPointingAt[2];
+SceneStore::Handle selectedCube = SceneStore::nullHandle;
+
+// Cubes are 10cm across, and views are culled with the same clip planes
+// the renderer projects with
+const float cubeHalfExtent = 0.05f;
+const float viewNear = 0.05f;
+const float viewFar = 100.0f;
+const uint32_t cubeColor = 0xFFFFFFFF;
+
+// How far a hand can point, and how big the markers are
+const float pickDistance = 2.0f;
+const float cursorHalfExtent = 0.01f;
+const float selectedHalfExtent = 0.06f;
+
+// Placed cubes per job when building everything at once
+const uint32_t placedBuildGrain = 4096;
+
+// Visible runs closer together than this are drawn as one, cubes in between
+// and all. The GPU throws away a few hidden cubes quicker than it does
+// another draw call.
+const uint32_t cullMaxGap = 16;
+
+InstanceTransform ApplicationMakeTransform(const XrVector3f& position, float halfExtent)
+{
+	return { {
+		{ halfExtent, 0.0f, 0.0f, position.x },
+		{ 0.0f, halfExtent, 0.0f, position.y },
+		{ 0.0f, 0.0f, halfExtent, position.z },
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+	} };
+}
+
+void Application::Cull(const XrCompositionLayerProjectionView* views, uint32_t viewCount)
+{
+	PROFILE_ZONE("Application::Cull");
+
+	JobSystem::Counter culling;
+	for (uint32_t i = 0; i < viewCount && i < maxViews; i++)
+	{
+		JobSystem::Run([i, views]()
+		{
+			visibleCubes[i].clear();
+			SceneBVH::Frustum frustum = SceneBVH::MakeFrustum(views[i].pose, views[i].fov, viewNear, viewFar);
+			SceneBVH::QueryFrustum(placedCubes, placedLeafOrder, frustum, cullMaxGap, visibleCubes[i]);
+		}, &culling);
+	}
+	JobSystem::Wait(culling);
+}
+
+void Application::Draw(XrCompositionLayerProjectionView& view, uint32_t viewIndex)
+{
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	// The GPU keeps its own copy of the cubes, and only hears about the ones
+	// that changed. The first view of a frame does the uploading, so the
+	// second finds nothing to do.
+	const SceneStore::Columns& dynamicCubes = scene.partitions[SceneStore::partitionDynamic];
+	const SceneStore::Columns& staticCubes = scene.partitions[SceneStore::partitionStatic];
+	D3DRenderer::UpdateInstances(SceneStore::partitionDynamic, dynamicCubes);
+	D3DRenderer::UpdateInstances(SceneStore::partitionStatic, staticCubes);
+
+	// Every dynamic cube, and the runs of static ones this view can see. The
+	// draw orders only depend on the count and the BVH, so most frames they're
+	// already on the GPU and nothing goes up for either.
+	D3DRenderer::SetDrawOrder(SceneStore::partitionDynamic, dynamicDrawOrder.data(), (uint32_t)dynamicDrawOrder.size(), dynamicDrawOrder.size());
+	SceneBVH::Range dynamicRange = { 0, (uint32_t)dynamicDrawOrder.size() };
+	D3DRenderer::DrawInstances(view, SceneStore::partitionDynamic, &dynamicRange, 1);
+
+	D3DRenderer::SetDrawOrder(SceneStore::partitionStatic, placedDrawOrder.data(), (uint32_t)placedDrawOrder.size(), placedDrawVersion);
+	const std::vector<SceneBVH::Range>& visible = visibleCubes[std::min(viewIndex, maxViews - 1)];
+	uint32_t visibleCount = viewIndex < maxViews ? (uint32_t)visible.size() : 0;
+	D3DRenderer::DrawInstances(view, SceneStore::partitionStatic, visible.data(), visibleCount);
+
+	// A little cube on every joint of each tracked hand, a draw per hand
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (HandTracking::GetJoints(i).isActive)
+			D3DRenderer::DrawTransforms(view, HandTracking::GetTransforms(i), HandTracking::jointCount);
+	}
+
+	// A small cube where each hand is pointing, and a bigger one around the
+	// selected cube. The selected cube is axis aligned, which is near enough to
+	// show which one it is.
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (handPointing[i].index >= 0)
+		{
+			InstanceTransform cursor = ApplicationMakeTransform(handPointingAt[i], cursorHalfExtent);
+			D3DRenderer::DrawTransforms(view, &cursor, 1);
+		}
+	}
+	if (SceneStore::IsValid(scene, selectedCube))
+	{
+		InstanceTransform selected = ApplicationMakeTransform(SceneStore::GetPose(scene, selectedCube).position, selectedHalfExtent);
+		D3DRenderer::DrawTransforms(view, &selected, 1);
+	}
+#else
+	// Headless builds have nothing to draw with
+	(void)view;
+	(void)viewIndex;
+#endif
+}
+
+// The hand cubes are made the first time they're needed, even before the
+// first predicted update
+void ApplicationMakeHandCubes()
+{
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (!SceneStore::IsValid(scene, handCubes[i]))
+			handCubes[i] = SceneStore::Add(scene, SceneStore::partitionDynamic, OpenXR::GetIdentityPose(), cubeHalfExtent, cubeColor);
+	}
+}
+
+// Builds the BVH and the picking boxes from every placed cube at once,
+// split into jobs
+void ApplicationBuildPlacedCubes()
+{
+	PROFILE_ZONE("Application::BuildPlacedCubes");
+
+	const SceneStore::Columns& placed = scene.partitions[SceneStore::partitionStatic];
+	std::vector<SceneBVH::Bounds> bounds(scene.slots.size());
+	std::vector<SceneBVH::ItemID> items(placed.count);
+	std::unique_lock<std::mutex> lock(placedBoxesLock);
+	Picking::SetCount(placedBoxes, placed.count);
+	placedBoxHandles.assign(placed.handles.begin(), placed.handles.begin() + placed.count);
+	JobSystem::ParallelFor(placed.count, placedBuildGrain, [&placed, &bounds, &items](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			XrPosef pose = SceneStore::GetPose(placed, i);
+			items[i] = SceneStore::GetSlot(placed.handles[i]);
+			bounds[items[i]] = SceneBVH::MakeBounds(pose, placed.scale[i]);
+			Picking::Set(placedBoxes, i, pose, placed.scale[i]);
+		}
+	});
+	lock.unlock();
+
+	SceneBVH::Build(placedCubes, bounds.data(), items.data(), placed.count);
+	for (std::vector<SceneBVH::Range>& visible : visibleCubes)
+		visible.reserve(placed.count);
+	placedSynced = placed.generation;
+}
+
+// Brings the BVH and the picking boxes up to date with any placed cubes that
+// changed since they were last synced
+void ApplicationSyncPlacedCubes()
+{
+	PROFILE_ZONE("Application::SyncPlacedCubes");
+
+	const SceneStore::Columns& placed = scene.partitions[SceneStore::partitionStatic];
+	if (placed.generation == placedSynced)
+		return;
+
+	// Building the BVH in one go is much quicker than inserting a cube at a
+	// time, so that's how a freshly loaded scene gets its BVH
+	if (placedCubes.itemCount == 0 && placed.count > 0)
+	{
+		ApplicationBuildPlacedCubes();
+		return;
+	}
+
+	// If the dirty list was cleared since the last sync, it might be missing
+	// changes, so go over every cube instead
+	std::lock_guard<std::mutex> lock(placedBoxesLock);
+	Picking::SetCount(placedBoxes, placed.count);
+	placedBoxHandles.resize(placed.count);
+	bool syncAll = placedSynced < placed.dirtySince;
+	uint32_t count = syncAll ? placed.count : (uint32_t)placed.dirty.size();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t index = syncAll ? i : placed.dirty[i];
+		if (index >= placed.count || placed.changed[index] <= placedSynced)
+			continue;
+
+		XrPosef pose = SceneStore::GetPose(placed, index);
+		float scale = placed.scale[index];
+		SceneBVH::ItemID item = SceneStore::GetSlot(placed.handles[index]);
+		SceneBVH::Bounds bounds = SceneBVH::MakeBounds(pose, scale);
+		if (SceneBVH::Contains(placedCubes, item))
+			SceneBVH::Update(placedCubes, item, bounds);
+		else
+			SceneBVH::Insert(placedCubes, item, bounds);
+		Picking::Set(placedBoxes, index, pose, scale);
+		placedBoxHandles[index] = placed.handles[index];
+	}
+	for (std::vector<SceneBVH::Range>& visible : visibleCubes)
+		visible.reserve(placed.count);
+	placedSynced = placed.generation;
+}
+
+// Brings the draw orders up to date with the placed cubes and the BVH, after
+// they've been synced
+void ApplicationSyncDrawOrders()
+{
+	const SceneStore::Columns& dynamicCubes = scene.partitions[SceneStore::partitionDynamic];
+	if (dynamicDrawOrder.size() != dynamicCubes.count)
+	{
+		dynamicDrawOrder.resize(dynamicCubes.count);
+		for (uint32_t i = 0; i < dynamicCubes.count; i++)
+			dynamicDrawOrder[i] = i;
+	}
+
+	// A new tree shape means a new leaf order. Removing a cube can also move
+	// another one to a different index in the static partition, which only
+	// shows up as a new generation.
+	bool reordered = SceneBVH::UpdateLeafOrder(placedCubes, placedLeafOrder);
+	if (!reordered && placedDrawSynced == placedSynced)
+		return;
+
+	PROFILE_ZONE("Application::SyncDrawOrders");
+	placedDrawOrder.resize(placedLeafOrder.items.size());
+	for (size_t i = 0; i < placedDrawOrder.size(); i++)
+		placedDrawOrder[i] = scene.slots[placedLeafOrder.items[i]].index;
+	placedDrawSynced = placedSynced;
+	placedDrawVersion++;
+}
+
+// Casts the hand's ray at the placed cubes. Each hand only writes its own
+// entries, so both hands can pick at once.
+void ApplicationPickFromHand(uint32_t hand, const XrPosef& pose)
+{
+	XrVector3f origin, direction;
+	Picking::GetPoseRay(pose, origin, direction);
+	handPointing[hand] = Picking::CastRay(placedBoxes, origin, direction, pickDistance);
+	handPointingAt[hand] = {
+		origin.x + direction.x * handPointing[hand].distance,
+		origin.y + direction.y * handPointing[hand].distance,
+		origin.z + direction.z * handPointing[hand].distance,
+	};
+}
+
+uint32_t Application::Pick(const XrPosef& pose)
+{
+	XrVector3f origin, direction;
+	Picking::GetPoseRay(pose, origin, direction);
+	std::lock_guard<std::mutex> lock(placedBoxesLock);
+	Picking::Hit hit = Picking::CastRay(placedBoxes, origin, direction, pickDistance);
+	return hit.index >= 0 ? placedBoxHandles[hit.index] : SceneStore::nullHandle;
+}
+
+void Application::Update()
+{
+	PROFILE_ZONE("Application::Update");
+
+	// A new frame, so everything that reads the dirty lists has seen them
+	for (int32_t i = 0; i < SceneStore::partitionCount; i++)
+		SceneStore::ClearDirty(scene, (SceneStore::Partition)i);
+	ApplicationMakeHandCubes();
+
+	// Find what each hand is pointing at, a job per hand. If the user presses
+	// the select action while pointing at a cube, it becomes the selected one,
+	// otherwise lets add a cube at that location!
+	const InputState& inputState = OpenXR::GetInputState();
+	JobSystem::Counter picking;
+	for (uint32_t i = 0; i < 2; i++) 
+	{
+		handPointing[i] = { -1, 0.0f };
+		if (inputState.renderHand[i])
+			JobSystem::Run([i, &inputState]() { ApplicationPickFromHand(i, inputState.handPose[i]); }, &picking);
+	}
+	JobSystem::Wait(picking);
+
+	for (uint32_t i = 0; i < 2; i++) 
+	{
+		if (inputState.handSelect[i])
+		{
+			// The sampler's pick is from the moment select was pressed, ours
+			// is from wherever the hand is this frame
+			SceneStore::Handle target = SceneStore::nullHandle;
+			if (inputState.handPicked[i])
+				target = inputState.handPickedCube[i];
+			else if (handPointing[i].index >= 0)
+				target = placedBoxHandles[handPointing[i].index];
+
+			if (SceneStore::IsValid(scene, target))
+				selectedCube = target;
+			else
+			{
+				// The scene, the BVH and the GPU copy may all need to grow
+				SceneStore::Add(scene, SceneStore::partitionStatic, inputState.handPose[i], cubeHalfExtent, cubeColor);
+				AllocationTracker::AllowThisFrame();
+			}
+		}
+	}
+
+	// Saving only reads the placed cubes, and so does syncing, so they can
+	// happen at the same time
+	JobSystem::Counter saving;
+	JobSystem::Run([]() { SceneFile::Save(scene.partitions[SceneStore::partitionStatic]); }, &saving);
+	ApplicationSyncPlacedCubes();
+	ApplicationSyncDrawOrders();
+	JobSystem::Wait(saving);
+	PROFILE_COUNTER("Cubes", scene.partitions[SceneStore::partitionDynamic].count + scene.partitions[SceneStore::partitionStatic].count);
+}
+
+void Application::UpdatePredicted()
+{
+	PROFILE_ZONE("Application::UpdatePredicted");
+
+	// Update the location of the hand cubes. This is done after the inputs have been updated to 
+	// use the predicted location, but during the render code, so we have the most up-to-date location.
+	ApplicationMakeHandCubes();
+
+	const InputState& inputState = OpenXR::GetInputState();
+	for (uint32_t i = 0; i < 2; i++) 
+	{
+		SceneStore::SetPose(scene, handCubes[i], inputState.renderHand[i] ? inputState.handPose[i] : OpenXR::GetIdentityPose());
+	}
+}
+
+bool Application::LoadScene(const char* path)
+{
+	PROFILE_ZONE("Application::LoadScene");
+
+	// A missing scene file just means nothing has been placed yet. Loading
+	// happens during startup, before there's a job system to build the BVH
+	// with, so that waits for the first Update.
+	SceneFile::Load(path, scene, SceneStore::partitionStatic);
+	return SceneFile::StartSaving(path, scene.partitions[SceneStore::partitionStatic]);
+}
+
+void Application::CloseScene()
+{
+	SceneFile::StopSaving();
+}
+
+void Application::SnapshotScene(std::vector<uint8_t>& data)
+{
+	SceneFile::Write(scene.partitions[SceneStore::partitionStatic], data);
+}
+
+bool Application::LoadSceneSnapshot(const uint8_t* data, size_t size)
+{
+	PROFILE_ZONE("Application::LoadSceneSnapshot");
+	return SceneFile::Load(data, size, scene, SceneStore::partitionStatic);
+}
@@ -1,13 +1,35 @@
-#pragma once
-
-#include "OpenXR_setup.h"
-
-#include <openxr/openxr.h>
-#include <openxr/openxr_platform.h>
-
-namespace Application
-{
-	void Draw(XrCompositionLayerProjectionView& layerView);
-	void Update();
-	void UpdatePredicted();
+#pragma once
+
+#include "OpenXR_setup.h"
+
+#include <openxr/openxr.h>
+#include <openxr/openxr_platform.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Application
+{
+	// Works out what each view can see, with the views culled in parallel.
+	// Call once a frame, after the views are located and before any Draw.
+	void Cull(const XrCompositionLayerProjectionView* layerViews, uint32_t viewCount);
+	void Draw(XrCompositionLayerProjectionView& layerView, uint32_t viewIndex);
+	void Update();
+	void UpdatePredicted();
+
+	// The placed cube a hand at this pose points at, as a SceneStore::Handle,
+	// or nullHandle if there isn't one. Safe to call from the input sampler,
+	// which picks the moment select is pressed rather than a frame later.
+	uint32_t Pick(const XrPosef& pose);
+
+	// Placed cubes are loaded from and saved to a scene file. LoadScene can
+	// run during startup, before the first Update.
+	bool LoadScene(const char* path);
+	void CloseScene();
+
+	// The placed cubes as a scene file, for frame captures to start from.
+	// Replay loads it back instead of a scene file, and never saves it.
+	void SnapshotScene(std::vector<uint8_t>& data);
+	bool LoadSceneSnapshot(const uint8_t* data, size_t size);
 }
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "AsyncLog.h"
+#include "Histogram.h"
+#include "Platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Records are a fixed size so the queue never allocates. Anything longer than
+// this is cut short, which is fine for log lines.
+constexpr uint32_t asyncLogTextSize = 480;
+
+// Must be a power of two. At 512 bytes a record, this is 512KB.
+constexpr uint32_t asyncLogQueueSize = 1024;
+
+struct AsyncLogRecord
+{
+	std::atomic<uint64_t>	sequence;
+	el::Logger*				logger;
+	el::Level				level;
+	uint32_t				length;
+	bool					mirrorToDebugger;
+	char					text[asyncLogTextSize];
+};
+
+// A bounded multiple producer, single consumer queue (Dmitry Vyukov's design).
+// Each record's sequence number says whose turn it is: a producer may fill the
+// record when it matches the enqueue position, and the writer may read it when
+// it's one past the dequeue position. Producers only ever contend on a single
+// compare and swap, and nobody waits on anybody else.
+std::unique_ptr<AsyncLogRecord[]>	asyncLogQueue;
+std::atomic<uint64_t>				asyncLogEnqueuePos = { 0 };
+uint64_t							asyncLogDequeuePos = 0;
+std::atomic<uint64_t>				asyncLogDropped = { 0 };
+uint64_t							asyncLogDroppedReported = 0;
+std::thread							asyncLogWriterThread;
+std::atomic<bool>					asyncLogRunning = { false };
+
+// Looking a logger up by name takes easylogging++'s registry lock, so Printf
+// uses the one we looked up in Start.
+el::Logger*							asyncLogDefaultLogger = nullptr;
+
+AsyncLogRecord* AsyncLogClaim()
+{
+	uint64_t position = asyncLogEnqueuePos.load(std::memory_order_relaxed);
+	while (true)
+	{
+		AsyncLogRecord& record = asyncLogQueue[position & (asyncLogQueueSize - 1)];
+		uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+		int64_t difference = (int64_t)(sequence - position);
+		if (difference == 0)
+		{
+			if (asyncLogEnqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				return &record;
+		}
+		else if (difference < 0)
+		{
+			// The writer hasn't gotten to this record from the last lap yet, so we're full
+			asyncLogDropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else
+		{
+			position = asyncLogEnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void AsyncLogPublish(AsyncLogRecord* record)
+{
+	uint64_t position = record->sequence.load(std::memory_order_relaxed);
+	record->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncLogWrite(el::Logger* logger, el::Level level, const char* text, size_t length)
+{
+	el::base::TypedConfigurations* config = logger->typedConfigurations();
+	if (config->toFile(level))
+	{
+		el::base::type::fstream_t* fs = config->fileStream(level);
+		if (fs != nullptr)
+		{
+			fs->write(text, length);
+			if (logger->isFlushNeeded(level))
+				logger->flush(level, fs);
+		}
+	}
+	if (config->toStandardOutput(level))
+		ELPP_COUT.write(text, length);
+}
+
+// Writes out everything that's been published so far. Only ever called from
+// one thread at a time.
+void AsyncLogDrain()
+{
+	while (true)
+	{
+		AsyncLogRecord& record = asyncLogQueue[asyncLogDequeuePos & (asyncLogQueueSize - 1)];
+		uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+		if (sequence != asyncLogDequeuePos + 1)
+			break;
+
+		AsyncLogWrite(record.logger, record.level, record.text, record.length);
+		if (record.mirrorToDebugger)
+			Platform::DebugOutput(record.text);
+
+		// Hand the record back to the producers for the next lap around
+		record.sequence.store(asyncLogDequeuePos + asyncLogQueueSize, std::memory_order_release);
+		asyncLogDequeuePos++;
+	}
+
+	// Drops are reported from here rather than where they happen, so a full
+	// queue doesn't make itself fuller.
+	uint64_t dropped = asyncLogDropped.load(std::memory_order_relaxed);
+	if (dropped != asyncLogDroppedReported)
+	{
+		char message[128];
+		int length = snprintf(message, sizeof(message), "AsyncLog dropped %llu log records (%llu total)\n",
+			(unsigned long long)(dropped - asyncLogDroppedReported), (unsigned long long)dropped);
+		AsyncLogWrite(asyncLogDefaultLogger, el::Level::Warning, message, (size_t)length);
+		asyncLogDroppedReported = dropped;
+	}
+	ELPP_COUT.flush();
+}
+
+// Replaces easylogging++'s DefaultLogDispatchCallback. easylogging++ still
+// builds the line on the calling thread, but the file and console writes,
+// which are the slow part, happen on the writer thread.
+class AsyncLogDispatchCallback : public el::LogDispatchCallback
+{
+protected:
+	void handle(const el::LogDispatchData* data) override
+	{
+		if (data->dispatchAction() != el::base::DispatchAction::NormalLog)
+			return;
+
+		const el::LogMessage* message = data->logMessage();
+		el::Logger* logger = message->logger();
+		el::base::type::string_t line = logger->logBuilder()->build(message, true);
+
+		// Fatal messages are about to take the process down with them, so they
+		// can't sit in a queue waiting for a thread that might never run again.
+		if (message->level() == el::Level::Fatal)
+		{
+			AsyncLogWrite(logger, message->level(), line.c_str(), line.size());
+			return;
+		}
+		AsyncLog::Push(logger, message->level(), line.c_str(), line.size(), false);
+	}
+};
+
+bool AsyncLog::Start()
+{
+	if (asyncLogRunning)
+		return true;
+
+	asyncLogQueue = std::make_unique<AsyncLogRecord[]>(asyncLogQueueSize);
+	for (uint32_t i = 0; i < asyncLogQueueSize; i++)
+		asyncLogQueue[i].sequence.store(i, std::memory_order_relaxed);
+	asyncLogEnqueuePos = 0;
+	asyncLogDequeuePos = 0;
+	asyncLogDefaultLogger = el::Loggers::getLogger("default", false);
+	if (asyncLogDefaultLogger == nullptr)
+		return false;
+
+	asyncLogRunning = true;
+	asyncLogWriterThread = std::thread([]()
+	{
+		Platform::SetCurrentThreadName("Log Writer");
+		Platform::SetCurrentThreadPriority(ThreadPriority::Low);
+		while (asyncLogRunning)
+		{
+			AsyncLogDrain();
+			Platform::SleepMilliseconds(2);
+		}
+	});
+
+	el::Helpers::installLogDispatchCallback<AsyncLogDispatchCallback>("AsyncLogDispatchCallback");
+	el::Helpers::uninstallLogDispatchCallback<el::base::DefaultLogDispatchCallback>("DefaultLogDispatchCallback");
+	return true;
+}
+
+void AsyncLog::Stop()
+{
+	if (!asyncLogRunning)
+		return;
+
+	// Put the default sink back first, so nothing new lands in the queue
+	// while we're emptying it.
+	el::Helpers::installLogDispatchCallback<el::base::DefaultLogDispatchCallback>("DefaultLogDispatchCallback");
+	el::Helpers::uninstallLogDispatchCallback<AsyncLogDispatchCallback>("AsyncLogDispatchCallback");
+
+	asyncLogRunning = false;
+	asyncLogWriterThread.join();
+	AsyncLogDrain();
+}
+
+bool AsyncLog::IsRunning()
+{
+	return asyncLogRunning;
+}
+
+bool AsyncLog::Printf(el::Level level, bool mirrorToDebugger, const char* format, ...)
+{
+	if (!asyncLogRunning)
+	{
+		el::Logger* logger = el::Loggers::getLogger("default", false);
+		if (logger == nullptr)
+			return false;
+
+		char text[asyncLogTextSize];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(text, sizeof(text), format, args);
+		va_end(args);
+		AsyncLogWrite(logger, level, text, strlen(text));
+		if (mirrorToDebugger)
+			Platform::DebugOutput(text);
+		return true;
+	}
+
+	// Format straight into the record, so there's no copy at all
+	AsyncLogRecord* record = AsyncLogClaim();
+	if (record == nullptr)
+		return false;
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(record->text, asyncLogTextSize, format, args);
+	va_end(args);
+
+	record->logger = asyncLogDefaultLogger;
+	record->level = level;
+	record->length = length < 0 ? 0 : std::min((uint32_t)length, asyncLogTextSize - 1);
+	record->mirrorToDebugger = mirrorToDebugger;
+	AsyncLogPublish(record);
+	return true;
+}
+
+bool AsyncLog::Push(el::Logger* logger, el::Level level, const char* text, size_t length, bool mirrorToDebugger)
+{
+	if (!asyncLogRunning)
+	{
+		AsyncLogWrite(logger, level, text, length);
+		if (mirrorToDebugger)
+			Platform::DebugOutput(text);
+		return true;
+	}
+
+	AsyncLogRecord* record = AsyncLogClaim();
+	if (record == nullptr)
+		return false;
+
+	// Truncated lines still get their line break
+	if (length >= asyncLogTextSize)
+	{
+		length = asyncLogTextSize - 1;
+		memcpy(record->text, text, length);
+		record->text[length - 1] = '\n';
+	}
+	else
+	{
+		memcpy(record->text, text, length);
+	}
+	record->text[length] = '\0';
+
+	record->logger = logger;
+	record->level = level;
+	record->length = (uint32_t)length;
+	record->mirrorToDebugger = mirrorToDebugger;
+	AsyncLogPublish(record);
+	return true;
+}
+
+uint64_t AsyncLog::GetDroppedCount()
+{
+	return asyncLogDropped.load(std::memory_order_relaxed);
+}
+
+// Blocks until the writer has written out everything published so far
+void AsyncLogWaitForWriter()
+{
+	uint64_t position = asyncLogEnqueuePos.load(std::memory_order_relaxed);
+	if (position == 0)
+		return;
+	const AsyncLogRecord& last = asyncLogQueue[(position - 1) & (asyncLogQueueSize - 1)];
+	while (last.sequence.load(std::memory_order_acquire) < position - 1 + asyncLogQueueSize)
+		Platform::SleepMilliseconds(1);
+}
+
+void AsyncLog::RunBenchmark(uint32_t threadCount)
+{
+	const uint32_t rounds = 200;
+	const uint32_t fullQueueCalls = asyncLogQueueSize * 4;
+
+	if (!asyncLogRunning)
+	{
+		LOG(WARNING) << "AsyncLog isn't running, so there's nothing to benchmark";
+		return;
+	}
+
+	// The flood goes out at Trace level, which writes nowhere for the length
+	// of the benchmark so it doesn't bury the console. The writer still takes
+	// every record off the queue, it just has nowhere to put them. Setting up
+	// a logger again frees the settings the writer reads, so it's stopped
+	// while that happens.
+	el::Logger* logger = asyncLogDefaultLogger;
+	bool traceToFile = logger->typedConfigurations()->toFile(el::Level::Trace);
+	bool traceToStandardOutput = logger->typedConfigurations()->toStandardOutput(el::Level::Trace);
+	Stop();
+	logger->configurations()->set(el::Level::Trace, el::ConfigurationType::ToFile, "false");
+	logger->configurations()->set(el::Level::Trace, el::ConfigurationType::ToStandardOutput, "false");
+	logger->reconfigure();
+	Start();
+
+	uint32_t maxThreadCount = std::max(threadCount, 4u);
+	for (uint32_t floodThreads = 1; floodThreads <= maxThreadCount; floodThreads *= 2)
+	{
+		// Each round, every thread pushes its share of one queue's worth of
+		// records at the same moment, then the writer empties the queue. The
+		// last round pushes four queues' worth without waiting, so most of it
+		// finds the queue full and is dropped.
+		uint32_t callsPerRound = asyncLogQueueSize / floodThreads;
+		std::vector<Histogram::Distribution> accepted(floodThreads), dropped(floodThreads);
+		std::atomic<uint32_t> startedRound = { 0 };
+		std::atomic<uint32_t> finishedRounds = { 0 };
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < floodThreads; t++)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (uint32_t round = 1; round <= rounds + 1; round++)
+				{
+					while (startedRound.load(std::memory_order_acquire) < round)
+						std::this_thread::yield();
+
+					uint32_t calls = round <= rounds ? callsPerRound : fullQueueCalls;
+					for (uint32_t i = 0; i < calls; i++)
+					{
+						uint64_t start = Platform::GetTimeNanoseconds();
+						bool wasAccepted = Printf(el::Level::Trace, false, "Benchmark thread %u round %u call %u at %.3fms\n", t, round, i, i * 0.011);
+						int64_t elapsed = (int64_t)(Platform::GetTimeNanoseconds() - start);
+						Histogram::Add(wasAccepted ? accepted[t] : dropped[t], elapsed);
+					}
+					finishedRounds.fetch_add(1, std::memory_order_release);
+				}
+			});
+		}
+
+		for (uint32_t round = 1; round <= rounds + 1; round++)
+		{
+			startedRound.store(round, std::memory_order_release);
+			while (finishedRounds.load(std::memory_order_acquire) < round * floodThreads)
+				std::this_thread::yield();
+			AsyncLogWaitForWriter();
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		Histogram::Distribution acceptedNanoseconds = {}, droppedNanoseconds = {};
+		for (uint32_t t = 0; t < floodThreads; t++)
+		{
+			Histogram::Merge(acceptedNanoseconds, accepted[t]);
+			Histogram::Merge(droppedNanoseconds, dropped[t]);
+		}
+		LOG(INFO) << "AsyncLog::Printf from " << floodThreads << " threads at once:";
+		Histogram::Log(acceptedNanoseconds, "Queued", 1.0, "ns");
+		Histogram::Log(droppedNanoseconds, "Dropped on a full queue", 1.0, "ns");
+	}
+
+	Stop();
+	logger->configurations()->set(el::Level::Trace, el::ConfigurationType::ToFile, traceToFile ? "true" : "false");
+	logger->configurations()->set(el::Level::Trace, el::ConfigurationType::ToStandardOutput, traceToStandardOutput ? "true" : "false");
+	logger->reconfigure();
+	Start();
+
+	LOG(INFO) << "Each call was timed on its own, and reading the clock twice takes " << Histogram::MeasureClockOverhead() << "ns of that";
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "easylogging++.h"
+
+#include <stdint.h>
+
+// An asynchronous sink for easylogging++. Once started, LOG() calls no longer
+// write to the console or log file themselves, they push the finished line
+// into a bounded, lock-free queue and a background thread does the writing.
+//
+// Printf skips easylogging++ entirely, and is meant for places where even
+// building a LOG() line is too much, like the OpenXR debug callback which runs
+// inside whatever xr* call triggered it. It still formats on the calling
+// thread, so a call costs about what vsnprintf does: around half a
+// microsecond for a short line with a float in it (see --log-benchmark).
+//
+// When the queue is full, new records are dropped and counted instead of
+// waiting for room. The writer reports how many were lost.
+namespace AsyncLog
+{
+	bool		Start();
+	void		Stop();
+	bool		IsRunning();
+
+	// Returns false if the record was dropped. mirrorToDebugger also sends the
+	// text to Platform::DebugOutput, from the writer thread.
+	bool		Printf(el::Level level, bool mirrorToDebugger, const char* format, ...);
+	bool		Push(el::Logger* logger, el::Level level, const char* text, size_t length, bool mirrorToDebugger);
+
+	uint64_t	GetDroppedCount();
+
+	// Floods Printf from 1, 2, 4... up to threadCount threads at once, but at
+	// least four so there's contention on any machine, and logs how long the
+	// calls took, both with room in the queue and with it full
+	void		RunBenchmark(uint32_t threadCount);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "BinaryLogFormat.h"
+
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// A logging mode for places where LOG(INFO) << ... is too slow to leave on,
+// like the frame loop. Instead of formatting text, each BLOG call copies its
+// raw arguments into a memory-mapped file, tagged with an ID for its format
+// string. The BinaryLogDecoder tool turns the file back into text later.
+//
+//   BLOG(Info, "Frame %lld predicted for %.3fms", frameIndex, milliseconds);
+//
+// The format string must be a literal, and uses printf syntax. Arguments can
+// be any integer, float, enum, pointer or C string. When the log isn't
+// running, BLOG costs a single atomic load.
+#define BLOG(level, format, ...) \
+	do \
+	{ \
+		if (BinaryLog::IsRunning()) \
+		{ \
+			static const BinaryLog::FormatID blogFormatID = BinaryLog::RegisterFormat(BinaryLogFormat::Level::level, __FILE__, __LINE__, format); \
+			BinaryLog::Write(blogFormatID, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+namespace BinaryLog
+{
+	typedef uint16_t FormatID;
+
+	bool		Start(const char* path, size_t capacity = 64 * 1024 * 1024);
+	void		Stop();
+
+	FormatID	RegisterFormat(BinaryLogFormat::Level level, const char* file, uint32_t line, const char* format);
+	uint64_t	GetDroppedCount();
+
+	// Floods BLOG from 1, 2, 4... up to threadCount threads at once, but at
+	// least four so there's contention on any machine, into a scratch log
+	// that's deleted afterwards, and logs how long the calls took. Does
+	// nothing if the log is already running.
+	void		RunBenchmark(uint32_t threadCount);
+
+	// Hands out space for a record and fills in its header. Returns nullptr if
+	// the log is full. Commit marks the record as finished.
+	uint8_t*	Reserve(FormatID formatID, uint32_t payloadSize);
+	void		Commit(uint8_t* record);
+
+	extern std::atomic<bool> running;
+	inline bool	IsRunning() { return running.load(std::memory_order_relaxed); }
+
+	// Everything below turns arguments into bytes. Integers are widened to 64
+	// bits and floats to doubles, so the decoder doesn't need to know how big
+	// a long was on the machine that wrote the log.
+	inline uint32_t ArgSize(const char* value)
+	{
+		size_t length = value != nullptr ? strlen(value) : 0;
+		return 1 + 2 + (uint32_t)(length > 0xFFFF ? 0xFFFF : length);
+	}
+	inline uint32_t ArgSize(char* value) { return ArgSize((const char*)value); }
+	template <typename T>
+	inline uint32_t ArgSize(T) { return 1 + 8; }
+
+	inline void EncodeBytes(uint8_t*& out, const void* data, size_t size)
+	{
+		memcpy(out, data, size);
+		out += size;
+	}
+
+	inline void EncodeArg(uint8_t*& out, const char* value)
+	{
+		size_t length = value != nullptr ? strlen(value) : 0;
+		uint16_t length16 = (uint16_t)(length > 0xFFFF ? 0xFFFF : length);
+		*out++ = (uint8_t)BinaryLogFormat::ArgType::String;
+		EncodeBytes(out, &length16, sizeof(length16));
+		EncodeBytes(out, value, length16);
+	}
+	inline void EncodeArg(uint8_t*& out, char* value) { EncodeArg(out, (const char*)value); }
+
+	template <typename T>
+	inline void EncodeArg(uint8_t*& out, T value)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+			"BLOG arguments must be numbers, enums, pointers or C strings");
+
+		if constexpr (std::is_floating_point<T>::value)
+		{
+			double encoded = (double)value;
+			*out++ = (uint8_t)BinaryLogFormat::ArgType::Double;
+			EncodeBytes(out, &encoded, sizeof(encoded));
+		}
+		else if constexpr (std::is_pointer<T>::value)
+		{
+			uint64_t encoded = (uint64_t)(uintptr_t)value;
+			*out++ = (uint8_t)BinaryLogFormat::ArgType::Pointer;
+			EncodeBytes(out, &encoded, sizeof(encoded));
+		}
+		else if constexpr (std::is_enum<T>::value || std::is_signed<T>::value)
+		{
+			int64_t encoded = (int64_t)value;
+			*out++ = (uint8_t)BinaryLogFormat::ArgType::Int64;
+			EncodeBytes(out, &encoded, sizeof(encoded));
+		}
+		else
+		{
+			uint64_t encoded = (uint64_t)value;
+			*out++ = (uint8_t)BinaryLogFormat::ArgType::UInt64;
+			EncodeBytes(out, &encoded, sizeof(encoded));
+		}
+	}
+
+	template <typename... Args>
+	inline void Write(FormatID formatID, Args... args)
+	{
+		uint32_t payloadSize = 0;
+		((payloadSize += ArgSize(args)), ...);
+
+		uint8_t* record = Reserve(formatID, payloadSize);
+		if (record == nullptr)
+			return;
+
+		uint8_t* out = record + sizeof(BinaryLogFormat::RecordHeader);
+		(EncodeArg(out, args), ...);
+		(void)out;
+		Commit(record);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+// The on-disk layout of a binary log. This is shared by BinaryLog, which
+// writes it, and the BinaryLogDecoder tool, which turns it back into text,
+// so it only depends on stdint.h.
+//
+// A file is a FileHeader followed by records, each starting with a
+// RecordHeader. Format records describe a log statement (its format string,
+// file and line) and are written once, the first time that statement runs.
+// Message records just carry the format's ID and the raw argument values,
+// each prefixed with an ArgType byte.
+namespace BinaryLogFormat
+{
+	const char		magic[8] = { 'X', 'R', 'B', 'L', 'O', 'G', '0', '1' };
+	const uint32_t	version = 1;
+
+	// Records start on 8 byte boundaries
+	const uint32_t	recordAlignment = 8;
+
+	// Threads are numbered from 1 in the order they first log. Once the IDs
+	// run out, every later thread shares this one.
+	const uint8_t	sharedThreadID = 255;
+
+	struct FileHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	headerSize;
+		uint64_t	startTime;		// Nanoseconds, on the same clock as record times
+		uint64_t	capacity;		// Bytes of record space following the header
+		uint64_t	used;			// Bytes handed out so far, can run past capacity when full
+		uint64_t	dropped;		// Messages that didn't fit
+	};
+
+	enum class RecordKind : uint8_t
+	{
+		Pending = 0,	// Space was reserved, but the record was never finished
+		Message = 1,
+		Format = 2,
+	};
+
+	enum class Level : uint8_t
+	{
+		Debug,
+		Info,
+		Warning,
+		Error,
+	};
+
+	// size covers the header and payload, and is written before anything
+	// else, so a reader can always skip a record. kind is written last.
+	struct RecordHeader
+	{
+		uint32_t	size;
+		uint16_t	formatID;
+		uint8_t		kind;
+		uint8_t		threadID;
+		uint64_t	time;
+	};
+
+	// Format payload: Level (uint8), line (uint32), then the file name and the
+	// format string, each as a uint16 length followed by the characters.
+	//
+	// Message payload: for each argument, an ArgType followed by its value.
+	// Strings are a uint16 length followed by the characters.
+	enum class ArgType : uint8_t
+	{
+		Int64 = 'i',
+		UInt64 = 'u',
+		Double = 'd',
+		String = 's',
+		Pointer = 'p',
+	};
+}
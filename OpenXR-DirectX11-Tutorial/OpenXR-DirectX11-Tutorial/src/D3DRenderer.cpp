@@ -1,322 +1,746 @@
-#pragma comment(lib,"D3D11.lib")
-#pragma comment(lib,"D3dcompiler.lib")
-#pragma comment(lib,"Dxgi.lib")
-
-#include "D3DRenderer.h"
-#include "Application.h"
-#include "easylogging++.h"
-
-ID3D11VertexShader*		vertexShader;
-ID3D11PixelShader*		pixelShader;
-ID3D11InputLayout*		shaderLayout;
-ID3D11Buffer*			constantsBuffer;
-ID3D11Buffer*			vertexBuffer;
-ID3D11Buffer*			indexBuffer;
-
-ID3D11Device*			d3dDevice = nullptr;
-ID3D11DeviceContext*	d3dContext = nullptr;
-int64_t					d3dSwapchainFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
-
-constexpr char xrHLSLShaderCode[] = R"_(
-cbuffer TransformBuffer : register(b0) 
-{
-	float4x4 world;
-	float4x4 viewproj;
-};
-struct vsIn 
-{
-	float4 pos  : SV_POSITION;
-	float3 norm : NORMAL;
-};
-struct psIn 
-{
-	float4 pos   : SV_POSITION;
-	float3 color : COLOR0;
-};
-
-psIn vs(vsIn input) 
-{
-	psIn output;
-	output.pos = mul(float4(input.pos.xyz, 1), world);
-	output.pos = mul(output.pos, viewproj);
-
-	float3 normal = normalize(mul(float4(input.norm, 0), world).xyz);
-
-	output.color = saturate(dot(normal, float3(0,1,0))).xxx;
-	return output;
-}
-
-float4 ps(psIn input) : SV_TARGET 
-{
-	return float4(input.color, 1);
-})_";
-
-// vertices for a 1x1x1 cube
-float cubeVertices[] = 
-{
-	-1,-1,-1, -1,-1,-1, // Bottom vertices
-	 1,-1,-1,  1,-1,-1,
-	 1, 1,-1,  1, 1,-1,
-	-1, 1,-1, -1, 1,-1,
-	-1,-1, 1, -1,-1, 1, // Top vertices
-	 1,-1, 1,  1,-1, 1,
-	 1, 1, 1,  1, 1, 1,
-	-1, 1, 1, -1, 1, 1, 
-};
-
-uint16_t cuveIndices[] = 
-{
-	1,2,0, 2,3,0, 4,6,5, 7,6,4,
-	6,2,1, 5,6,1, 3,7,4, 0,3,4,
-	4,5,1, 0,4,1, 2,7,3, 2,6,7, 
-};
-
-
-bool D3DRenderer::Init(LUID& adapterLUID) 
-{
-	d3dDevice = nullptr;
-	d3dContext = nullptr;
-
-	IDXGIAdapter1* adapter = GetAdapter(adapterLUID);
-	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0 };
-
-	if (adapter == nullptr)
-		return false;
-
-	if (FAILED(D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, 0, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION, &d3dDevice, nullptr, &d3dContext)))
-		return false;
-
-	adapter->Release();
-	return true;
-}
-
-void D3DRenderer::SetupResources()
-{
-	// Compile our shader code, and turn it into a shader resource!
-	ID3DBlob* vertexShaderBlob = CompileShader(xrHLSLShaderCode, "vs", "vs_5_0");
-	ID3DBlob* pixelShaderBlob = CompileShader(xrHLSLShaderCode, "ps", "ps_5_0");
-
-	d3dDevice->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), nullptr, &vertexShader);
-	d3dDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, &pixelShader);
-
-	// Describe how our mesh is laid out in memory
-	D3D11_INPUT_ELEMENT_DESC vertexInputElementDescription[] = {
-		{"SV_POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}, };
-	d3dDevice->CreateInputLayout(vertexInputElementDescription, (UINT)_countof(vertexInputElementDescription), vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &shaderLayout);
-
-	// Create GPU resources for our mesh's vertices and indices! Constant buffers are for passing transform
-	// matrices into the shaders, so make a buffer for them too!
-	D3D11_SUBRESOURCE_DATA vertexBufferData = { cubeVertices };
-	D3D11_SUBRESOURCE_DATA indexBufferData = { cuveIndices };
-	CD3D11_BUFFER_DESC     vertexBufferDescription(sizeof(cubeVertices), D3D11_BIND_VERTEX_BUFFER);
-	CD3D11_BUFFER_DESC     indexBufferDescription(sizeof(cuveIndices), D3D11_BIND_INDEX_BUFFER);
-	CD3D11_BUFFER_DESC     constantsBufferDescription(sizeof(TransformBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	d3dDevice->CreateBuffer(&vertexBufferDescription, &vertexBufferData, &vertexBuffer);
-	d3dDevice->CreateBuffer(&indexBufferDescription, &indexBufferData, &indexBuffer);
-	d3dDevice->CreateBuffer(&constantsBufferDescription, nullptr, &constantsBuffer);
-
-}
-
-void D3DRenderer::Shutdown() 
-{
-	if (d3dContext) 
-	{ 
-		d3dContext->Release(); 
-		d3dContext = nullptr; 
-	}
-	if (d3dDevice) 
-	{ 
-		d3dDevice->Release();  
-		d3dDevice = nullptr; 
-	}
-}
-
-SwapchainSurfacedata D3DRenderer::MakeSurfaceData(XrBaseInStructure& swapchainImage) 
-{
-	SwapchainSurfacedata result = {};
-	HRESULT d3dResult = S_FALSE;
-
-	// OpenXR has created a swapchain for us. use that to internally track the swapchain.
-	XrSwapchainImageD3D11KHR& d3dSwapchainImage = (XrSwapchainImageD3D11KHR&)swapchainImage;
-	D3D11_TEXTURE2D_DESC      colorDescription;
-	d3dSwapchainImage.texture->GetDesc(&colorDescription);
-
-	// Create a view resource for the swapchain image target that we can use to set up rendering.
-	D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDescription = {};
-	renderTargetViewDescription.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	// NOTE: Why not use color_desc.Format? Check the notes over near the xrCreateSwapchain call!
-	// Basically, the color_desc.Format of the OpenXR created swapchain is TYPELESS, but in order to
-	// create a View for the texture, we need a concrete variant of the texture format like UNORM.
-	renderTargetViewDescription.Format = (DXGI_FORMAT)d3dSwapchainFormat;
-	d3dDevice->CreateRenderTargetView(d3dSwapchainImage.texture, &renderTargetViewDescription, &result.targetView);
-
-	// Create a depth buffer that matches 
-	ID3D11Texture2D* depthTexture;
-	D3D11_TEXTURE2D_DESC depthTextureDescription = {};
-	depthTextureDescription.SampleDesc.Count = 1;
-	depthTextureDescription.MipLevels = 1;
-	depthTextureDescription.Width = colorDescription.Width;
-	depthTextureDescription.Height = colorDescription.Height;
-	depthTextureDescription.ArraySize = colorDescription.ArraySize;
-	depthTextureDescription.Format = DXGI_FORMAT_R32_TYPELESS;
-	depthTextureDescription.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
-	d3dResult = d3dDevice->CreateTexture2D(&depthTextureDescription, nullptr, &depthTexture);
-
-	if (depthTexture == NULL)
-	{
-		LOG(ERROR) << "D3D 11 Failed to create the depth Texture";
-		return result;
-	}
-
-	// And create a view resource for the depth buffer, so we can set that up for rendering to as well!
-	D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilDescription = {};
-	depthStencilDescription.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	depthStencilDescription.Format = DXGI_FORMAT_D32_FLOAT;
-	d3dDevice->CreateDepthStencilView(depthTexture, &depthStencilDescription, &result.depthView);
-
-	// We don't need direct access to the ID3D11Texture2D object anymore, we only need the view
-	depthTexture->Release();
-
-	return result;
-}
-
-void D3DRenderer::SwapchainDestroy(Swapchain& swapchain)
-{
-	for (uint32_t i = 0; i < swapchain.surfaceData.size(); i++)
-	{
-		swapchain.surfaceData[i].depthView->Release();
-		swapchain.surfaceData[i].targetView->Release();
-	}
-}
-
-ID3DBlob* D3DRenderer::CompileShader(const char* hlslSource, const char* entrypoint, const char* target)
-{
-	DWORD flags = D3DCOMPILE_PACK_MATRIX_COLUMN_MAJOR | D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_WARNINGS_ARE_ERRORS;
-#ifdef _DEBUG
-	flags |= D3DCOMPILE_SKIP_OPTIMIZATION | D3DCOMPILE_DEBUG;
-#else
-	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
-#endif
-
-	ID3DBlob* compiled, * errors;
-	if (FAILED(D3DCompile(hlslSource, strlen(hlslSource), nullptr, nullptr, nullptr, entrypoint, target, flags, 0, &compiled, &errors)))
-		printf("Error: D3DCompile failed %s", (char*)errors->GetBufferPointer());
-
-	if (errors) errors->Release();
-
-	return compiled;
-}
-
-void D3DRenderer::DrawCubes(XrCompositionLayerProjectionView& view, std::vector<XrPosef>& poses)
-{
-	// Set up the projection and view matrices for OpenXR
-	DirectX::XMMATRIX projectionMatrix = GetXRProjection(view.fov, 0.05f, 100.0f);
-	DirectX::XMMATRIX viewMatrix = XMMatrixInverse(nullptr, 
-		XMMatrixAffineTransformation(
-			DirectX::g_XMOne,
-			DirectX::g_XMZero,
-			DirectX::XMLoadFloat4((DirectX::XMFLOAT4*)&view.pose.orientation),
-			DirectX::XMLoadFloat3((DirectX::XMFLOAT3*)&view.pose.position)));
-
-	// For the D3D Context, set up the shader resources that will be used
-	d3dContext->VSSetConstantBuffers(0, 1, &constantsBuffer);
-	d3dContext->VSSetShader(vertexShader, nullptr, 0);
-	d3dContext->PSSetShader(pixelShader, nullptr, 0);
-
-	// Prepare the vertex buffers for rendering
-	UINT strides[] = { sizeof(float) * 6 };
-	UINT offsets[] = { 0 };
-
-	d3dContext->IASetVertexBuffers(0, 1, &vertexBuffer, strides, offsets);
-	d3dContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
-	d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	d3dContext->IASetInputLayout(shaderLayout);
-
-	// Create the view x projection matrix and store it into the transform buffer.
-	TransformBuffer transformBuffer{};
-	XMStoreFloat4x4(&transformBuffer.viewproj, XMMatrixTranspose(viewMatrix * projectionMatrix));
-
-	// And for the cubes
-	// - create the model matrix,
-	// - update the transform buffer with the model matrix
-	for (size_t i = 0; i < poses.size(); i++)
-	{
-		// Create a translate, rotate, scale matrix for the cube's world location
-		DirectX::XMMATRIX modelMatrix = XMMatrixAffineTransformation(
-			DirectX::g_XMOne * 0.05f,
-			DirectX::g_XMZero,
-			DirectX::XMLoadFloat4((DirectX::XMFLOAT4*)&poses[i].orientation),
-			DirectX::XMLoadFloat3((DirectX::XMFLOAT3*)&poses[i].position));
-
-		// We're push the world transform for the object into the transform buffer.
-		// Push that transform buffer to the shader and then draw the primitives.
-		XMStoreFloat4x4(&transformBuffer.world, XMMatrixTranspose(modelMatrix));
-		d3dContext->UpdateSubresource(constantsBuffer, 0, nullptr, &transformBuffer, 0, 0);
-		d3dContext->DrawIndexed(_countof(cuveIndices), 0, 0);
-	}
-}
-
-void D3DRenderer::RenderLayer(XrCompositionLayerProjectionView& view, SwapchainSurfacedata& surface) 
-{
-	// Set up where on the render target we want to draw, the view has a 
-	XrRect2Di& rect = view.subImage.imageRect;
-	D3D11_VIEWPORT viewport = CD3D11_VIEWPORT((float)rect.offset.x, (float)rect.offset.y, (float)rect.extent.width, (float)rect.extent.height);
-	d3dContext->RSSetViewports(1, &viewport);
-
-	// Wipe our swapchain color and depth target clean, and then set them up for rendering!
-	float clear[] = { 0, 0, 0, 1 };
-	d3dContext->ClearRenderTargetView(surface.targetView, clear);
-	d3dContext->ClearDepthStencilView(surface.depthView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-	d3dContext->OMSetRenderTargets(1, &surface.targetView, surface.depthView);
-
-	// And now that we're set up, pass on the rest of our rendering to the application
-	Application::Draw(view);
-}
-
-IDXGIAdapter1* D3DRenderer::GetAdapter(LUID& adapterLUID) 
-{
-	// find the appropriate DXGI adapter give a specific adapter LUID
-	IDXGIAdapter1* foundAdapter = nullptr;
-	IDXGIAdapter1* currentAdapter = nullptr;
-	IDXGIFactory1* dxgiFactory;
-	DXGI_ADAPTER_DESC1 adapterDescription;
-
-	CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)(&dxgiFactory));
-
-	int curr = 0;
-	while (dxgiFactory->EnumAdapters1(curr++, &currentAdapter) == S_OK) 
-	{
-		currentAdapter->GetDesc1(&adapterDescription);
-
-		if (memcmp(&adapterDescription.AdapterLuid, &adapterLUID, sizeof(&adapterLUID)) == 0) 
-		{
-			foundAdapter = currentAdapter;
-			break;
-		}
-		currentAdapter->Release();
-		currentAdapter = nullptr;
-	}
-	dxgiFactory->Release();
-	return foundAdapter;
-}
-
-ID3D11Device* D3DRenderer::GetDevice()
-{
-	return d3dDevice;
-}
-
-int64_t D3DRenderer::GetSwapchainFormat()
-{
-	return d3dSwapchainFormat;
-}
-
-DirectX::XMMATRIX D3DRenderer::GetXRProjection(XrFovf fov, float clip_near, float clip_far) 
-{
-	const float left = clip_near * tanf(fov.angleLeft);
-	const float right = clip_near * tanf(fov.angleRight);
-	const float down = clip_near * tanf(fov.angleDown);
-	const float up = clip_near * tanf(fov.angleUp);
-
-	return DirectX:: XMMatrixPerspectiveOffCenterRH(left, right, down, up, clip_near, clip_far);
-}
+#include "D3DRenderer.h"
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+#pragma comment(lib,"D3D11.lib")
+#pragma comment(lib,"D3dcompiler.lib")
+#pragma comment(lib,"Dxgi.lib")
+
+#include "Application.h"
+#include "FrameTelemetry.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "StartupTrace.h"
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <string.h>
+
+ID3D11PixelShader*		pixelShader;
+ID3D11InputLayout*		instancedShaderLayout = nullptr;
+ID3D11Buffer*			constantsBuffer;
+ID3D11Buffer*			vertexBuffer;
+ID3D11Buffer*			indexBuffer;
+ID3DBlob*				pixelShaderBlob = nullptr;
+ID3D11VertexShader*		instancedVertexShader = nullptr;
+ID3DBlob*				instancedVertexShaderBlob = nullptr;
+
+ID3D11Device*			d3dDevice = nullptr;
+ID3D11DeviceContext*	d3dContext = nullptr;
+int64_t					d3dSwapchainFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+// What the instanced shader reads per cube: the top three rows of its
+// InstanceTransform, since the last row is always 0, 0, 0, 1.
+struct GPUInstance
+{
+	float rows[3][4];
+};
+
+// A scene partition's transforms on the GPU. generation is the partition's
+// generation when it was last uploaded.
+struct InstanceBuffer
+{
+	ID3D11Buffer*				buffer = nullptr;
+	ID3D11ShaderResourceView*	view = nullptr;
+	uint32_t					capacity = 0;
+	uint32_t					count = 0;
+	uint64_t					generation = 0;
+};
+
+// Changed instances are written to a staging buffer and copied over on the
+// GPU. Mapping a staging buffer waits for any copy still reading from it, so
+// there's a ring of them, enough for a few frames of two uploads each.
+struct InstanceStaging
+{
+	ID3D11Buffer*	buffer = nullptr;
+	uint32_t		capacity = 0;		// In instances
+};
+
+constexpr uint32_t instanceStagingCount = 8;
+constexpr uint32_t instanceMinCapacity = 64;
+constexpr uint32_t instancePackGrain = 4096;		// Instances per job when packing
+
+InstanceBuffer				instanceBuffers[SceneStore::partitionCount];
+InstanceStaging				instanceStaging[instanceStagingCount];
+uint32_t					instanceStagingNext = 0;
+std::vector<uint32_t>		instanceUploads;
+std::vector<InstanceTransform> instanceTransforms;
+
+// Which of a partition's instances to draw, in the order the caller wants to
+// draw runs of them in. It's read as per instance vertex data, so a run is
+// drawn by starting at its first entry. version is the one the caller gave
+// when it was last uploaded.
+struct DrawOrder
+{
+	ID3D11Buffer*	buffer = nullptr;
+	uint32_t		capacity = 0;
+	uint32_t		count = 0;
+	uint64_t		version = 0;
+};
+
+DrawOrder					drawOrders[SceneStore::partitionCount];
+
+// DrawTransforms gets new transforms every call, so they're written over a
+// small buffer of their own each time and drawn in the order they came in,
+// with a draw order that just counts up. A hand's joints fit in one go.
+constexpr uint32_t			transientCapacity = 64;
+ID3D11Buffer*				transientInstances = nullptr;
+ID3D11ShaderResourceView*	transientInstancesView = nullptr;
+ID3D11Buffer*				transientDrawOrder = nullptr;
+
+FrameTelemetry::CounterID	instanceBytesCounter = -1;
+FrameTelemetry::CounterID	visibleBytesCounter = -1;
+
+constexpr char xrHLSLShaderCode[] = R"_(
+cbuffer TransformBuffer : register(b0) 
+{
+	float4x4 viewproj;
+};
+struct vsIn 
+{
+	float4 pos  : SV_POSITION;
+	float3 norm : NORMAL;
+};
+struct psIn 
+{
+	float4 pos   : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+// Every cube is drawn instanced: its transform is already on the GPU, and
+// the draw order says which one each instance is
+struct Instance
+{
+	float4 rows[3];
+};
+StructuredBuffer<Instance> instances : register(t0);
+
+psIn vsInstanced(vsIn input, uint index : INSTANCE)
+{
+	Instance instance = instances[index];
+	float4 pos = float4(input.pos.xyz, 1);
+
+	psIn output;
+	output.pos = float4(dot(instance.rows[0], pos), dot(instance.rows[1], pos), dot(instance.rows[2], pos), 1);
+	output.pos = mul(output.pos, viewproj);
+
+	float3 normal = normalize(float3(dot(instance.rows[0].xyz, input.norm), dot(instance.rows[1].xyz, input.norm), dot(instance.rows[2].xyz, input.norm)));
+
+	output.color = saturate(dot(normal, float3(0,1,0))).xxx;
+	return output;
+}
+
+float4 ps(psIn input) : SV_TARGET 
+{
+	return float4(input.color, 1);
+})_";
+
+// vertices for a 1x1x1 cube
+float cubeVertices[] = 
+{
+	-1,-1,-1, -1,-1,-1, // Bottom vertices
+	 1,-1,-1,  1,-1,-1,
+	 1, 1,-1,  1, 1,-1,
+	-1, 1,-1, -1, 1,-1,
+	-1,-1, 1, -1,-1, 1, // Top vertices
+	 1,-1, 1,  1,-1, 1,
+	 1, 1, 1,  1, 1, 1,
+	-1, 1, 1, -1, 1, 1, 
+};
+
+uint16_t cuveIndices[] = 
+{
+	1,2,0, 2,3,0, 4,6,5, 7,6,4,
+	6,2,1, 5,6,1, 3,7,4, 0,3,4,
+	4,5,1, 0,4,1, 2,7,3, 2,6,7, 
+};
+
+
+bool D3DRenderer::Init(LUID& adapterLUID) 
+{
+	StartupTrace::Scope trace("D3DRenderer::Init");
+
+	d3dDevice = nullptr;
+	d3dContext = nullptr;
+
+	IDXGIAdapter1* adapter = GetAdapter(adapterLUID);
+	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0 };
+
+	if (adapter == nullptr)
+		return false;
+
+	if (FAILED(D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, 0, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION, &d3dDevice, nullptr, &d3dContext)))
+		return false;
+
+	adapter->Release();
+	return true;
+}
+
+bool D3DRenderer::InitWithoutRuntime()
+{
+	StartupTrace::Scope trace("D3DRenderer::InitWithoutRuntime");
+
+	// With no runtime to tell us which adapter the headset is on, just take
+	// the default one.
+	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0 };
+	return SUCCEEDED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, 0, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION, &d3dDevice, nullptr, &d3dContext));
+}
+
+void D3DRenderer::CompileShaders()
+{
+	// Compile our shader code! This doesn't need the device at all, so it can
+	// happen while OpenXR is still getting started.
+	pixelShaderBlob = CompileShader(xrHLSLShaderCode, "ps", "ps_5_0");
+	instancedVertexShaderBlob = CompileShader(xrHLSLShaderCode, "vsInstanced", "vs_5_0");
+}
+
+bool D3DRenderer::CreateShaders()
+{
+	if (pixelShaderBlob == nullptr || instancedVertexShaderBlob == nullptr)
+		return false;
+
+	// Turn the compiled shaders into shader resources!
+	d3dDevice->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), nullptr, &pixelShader);
+	d3dDevice->CreateVertexShader(instancedVertexShaderBlob->GetBufferPointer(), instancedVertexShaderBlob->GetBufferSize(), nullptr, &instancedVertexShader);
+
+	// Describe how our mesh is laid out in memory, with an entry of the draw
+	// order per instance alongside it
+	D3D11_INPUT_ELEMENT_DESC instancedInputElementDescription[] = {
+		{"SV_POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"INSTANCE",    0, DXGI_FORMAT_R32_UINT,        1, 0,                            D3D11_INPUT_PER_INSTANCE_DATA, 1}, };
+	d3dDevice->CreateInputLayout(instancedInputElementDescription, (UINT)_countof(instancedInputElementDescription), instancedVertexShaderBlob->GetBufferPointer(), instancedVertexShaderBlob->GetBufferSize(), &instancedShaderLayout);
+
+	// We're done with the compiled bytecode now that the shaders have been made
+	pixelShaderBlob->Release();
+	instancedVertexShaderBlob->Release();
+	pixelShaderBlob = nullptr;
+	instancedVertexShaderBlob = nullptr;
+	return pixelShader != nullptr && instancedVertexShader != nullptr && instancedShaderLayout != nullptr;
+}
+
+bool D3DRenderer::CreateMeshBuffers()
+{
+	// Create GPU resources for our mesh's vertices and indices! Constant buffers are for passing transform
+	// matrices into the shaders, so make a buffer for them too!
+	D3D11_SUBRESOURCE_DATA vertexBufferData = { cubeVertices };
+	D3D11_SUBRESOURCE_DATA indexBufferData = { cuveIndices };
+	CD3D11_BUFFER_DESC     vertexBufferDescription(sizeof(cubeVertices), D3D11_BIND_VERTEX_BUFFER);
+	CD3D11_BUFFER_DESC     indexBufferDescription(sizeof(cuveIndices), D3D11_BIND_INDEX_BUFFER);
+	CD3D11_BUFFER_DESC     constantsBufferDescription(sizeof(TransformBuffer), D3D11_BIND_CONSTANT_BUFFER);
+	d3dDevice->CreateBuffer(&vertexBufferDescription, &vertexBufferData, &vertexBuffer);
+	d3dDevice->CreateBuffer(&indexBufferDescription, &indexBufferData, &indexBuffer);
+	d3dDevice->CreateBuffer(&constantsBufferDescription, nullptr, &constantsBuffer);
+
+	// And the buffers DrawTransforms writes its transforms into
+	CD3D11_BUFFER_DESC transientDescription(transientCapacity * sizeof(GPUInstance), D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, sizeof(GPUInstance));
+	d3dDevice->CreateBuffer(&transientDescription, nullptr, &transientInstances);
+	if (transientInstances != nullptr)
+	{
+		CD3D11_SHADER_RESOURCE_VIEW_DESC viewDescription(transientInstances, DXGI_FORMAT_UNKNOWN, 0, transientCapacity);
+		d3dDevice->CreateShaderResourceView(transientInstances, &viewDescription, &transientInstancesView);
+	}
+	uint32_t countingOrder[transientCapacity];
+	for (uint32_t i = 0; i < transientCapacity; i++)
+		countingOrder[i] = i;
+	D3D11_SUBRESOURCE_DATA countingOrderData = { countingOrder };
+	CD3D11_BUFFER_DESC countingOrderDescription(sizeof(countingOrder), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+	d3dDevice->CreateBuffer(&countingOrderDescription, &countingOrderData, &transientDrawOrder);
+
+	instanceBytesCounter = FrameTelemetry::RegisterCounter("Instance bytes uploaded");
+	visibleBytesCounter = FrameTelemetry::RegisterCounter("Visible list bytes uploaded");
+	return vertexBuffer != nullptr && indexBuffer != nullptr && constantsBuffer != nullptr && transientInstancesView != nullptr && transientDrawOrder != nullptr;
+}
+
+void D3DRenderer::Shutdown() 
+{
+	for (InstanceBuffer& instances : instanceBuffers)
+	{
+		if (instances.view) instances.view->Release();
+		if (instances.buffer) instances.buffer->Release();
+		instances = {};
+	}
+	for (InstanceStaging& staging : instanceStaging)
+	{
+		if (staging.buffer) staging.buffer->Release();
+		staging = {};
+	}
+	for (DrawOrder& order : drawOrders)
+	{
+		if (order.buffer) order.buffer->Release();
+		order = {};
+	}
+	if (transientInstancesView) transientInstancesView->Release();
+	if (transientInstances) transientInstances->Release();
+	if (transientDrawOrder) transientDrawOrder->Release();
+	transientInstancesView = nullptr;
+	transientInstances = nullptr;
+	transientDrawOrder = nullptr;
+
+	if (d3dContext) 
+	{ 
+		d3dContext->Release(); 
+		d3dContext = nullptr; 
+	}
+	if (d3dDevice) 
+	{ 
+		d3dDevice->Release();  
+		d3dDevice = nullptr; 
+	}
+}
+
+SwapchainSurfacedata D3DRenderer::MakeSurfaceData(XrBaseInStructure& swapchainImage) 
+{
+	StartupTrace::Scope trace("D3DRenderer::MakeSurfaceData");
+
+	SwapchainSurfacedata result = {};
+	HRESULT d3dResult = S_FALSE;
+
+	// OpenXR has created a swapchain for us. use that to internally track the swapchain.
+	XrSwapchainImageD3D11KHR& d3dSwapchainImage = (XrSwapchainImageD3D11KHR&)swapchainImage;
+	D3D11_TEXTURE2D_DESC      colorDescription;
+	d3dSwapchainImage.texture->GetDesc(&colorDescription);
+
+	// Create a view resource for the swapchain image target that we can use to set up rendering.
+	D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDescription = {};
+	renderTargetViewDescription.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+	// NOTE: Why not use color_desc.Format? Check the notes over near the xrCreateSwapchain call!
+	// Basically, the color_desc.Format of the OpenXR created swapchain is TYPELESS, but in order to
+	// create a View for the texture, we need a concrete variant of the texture format like UNORM.
+	renderTargetViewDescription.Format = (DXGI_FORMAT)d3dSwapchainFormat;
+	d3dDevice->CreateRenderTargetView(d3dSwapchainImage.texture, &renderTargetViewDescription, &result.targetView);
+
+	// Create a depth buffer that matches 
+	ID3D11Texture2D* depthTexture;
+	D3D11_TEXTURE2D_DESC depthTextureDescription = {};
+	depthTextureDescription.SampleDesc.Count = 1;
+	depthTextureDescription.MipLevels = 1;
+	depthTextureDescription.Width = colorDescription.Width;
+	depthTextureDescription.Height = colorDescription.Height;
+	depthTextureDescription.ArraySize = colorDescription.ArraySize;
+	depthTextureDescription.Format = DXGI_FORMAT_R32_TYPELESS;
+	depthTextureDescription.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
+	d3dResult = d3dDevice->CreateTexture2D(&depthTextureDescription, nullptr, &depthTexture);
+
+	if (depthTexture == NULL)
+	{
+		LOG(ERROR) << "D3D 11 Failed to create the depth Texture";
+		return result;
+	}
+
+	// And create a view resource for the depth buffer, so we can set that up for rendering to as well!
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilDescription = {};
+	depthStencilDescription.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	depthStencilDescription.Format = DXGI_FORMAT_D32_FLOAT;
+	d3dDevice->CreateDepthStencilView(depthTexture, &depthStencilDescription, &result.depthView);
+
+	// We don't need direct access to the ID3D11Texture2D object anymore, we only need the view
+	depthTexture->Release();
+
+	return result;
+}
+
+void D3DRenderer::SwapchainDestroy(Swapchain& swapchain)
+{
+	for (uint32_t i = 0; i < swapchain.surfaceData.size(); i++)
+	{
+		if (swapchain.surfaceData[i].depthView) swapchain.surfaceData[i].depthView->Release();
+		if (swapchain.surfaceData[i].targetView) swapchain.surfaceData[i].targetView->Release();
+	}
+}
+
+SwapchainSurfacedata D3DRenderer::MakeOffscreenSurface(int32_t width, int32_t height)
+{
+	// Make a texture that looks like one from an OpenXR swapchain, and let
+	// MakeSurfaceData create the views for it, same as it would for a real one.
+	D3D11_TEXTURE2D_DESC colorDescription = {};
+	colorDescription.Width = width;
+	colorDescription.Height = height;
+	colorDescription.MipLevels = 1;
+	colorDescription.ArraySize = 1;
+	colorDescription.Format = (DXGI_FORMAT)d3dSwapchainFormat;
+	colorDescription.SampleDesc.Count = 1;
+	colorDescription.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+	XrSwapchainImageD3D11KHR image = { XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR };
+	if (FAILED(d3dDevice->CreateTexture2D(&colorDescription, nullptr, &image.texture)))
+	{
+		LOG(ERROR) << "D3D 11 Failed to create an offscreen render target";
+		return {};
+	}
+
+	SwapchainSurfacedata result = MakeSurfaceData((XrBaseInStructure&)image);
+
+	// The render target view holds its own reference to the texture
+	image.texture->Release();
+	return result;
+}
+
+void D3DRenderer::OffscreenSurfaceDestroy(SwapchainSurfacedata& surface)
+{
+	if (surface.depthView) surface.depthView->Release();
+	if (surface.targetView) surface.targetView->Release();
+	surface = {};
+}
+
+void D3DRenderer::Flush()
+{
+	// Without a swapchain to present, nothing else pushes our commands to the GPU
+	d3dContext->Flush();
+}
+
+ID3DBlob* D3DRenderer::CompileShader(const char* hlslSource, const char* entrypoint, const char* target)
+{
+	StartupTrace::Scope trace(std::string("CompileShader ") + entrypoint);
+
+	DWORD flags = D3DCOMPILE_PACK_MATRIX_COLUMN_MAJOR | D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_WARNINGS_ARE_ERRORS;
+#ifdef _DEBUG
+	flags |= D3DCOMPILE_SKIP_OPTIMIZATION | D3DCOMPILE_DEBUG;
+#else
+	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	ID3DBlob* compiled = nullptr, * errors = nullptr;
+	if (FAILED(D3DCompile(hlslSource, strlen(hlslSource), nullptr, nullptr, nullptr, entrypoint, target, flags, 0, &compiled, &errors)))
+		LOG(ERROR) << "D3DCompile failed " << (errors ? (char*)errors->GetBufferPointer() : "");
+
+	if (errors) errors->Release();
+
+	return compiled;
+}
+
+// Everything DrawTransforms and DrawInstances have in common: the shaders,
+// the cube mesh, and the view x projection matrix for this eye. Which
+// instances to draw is up to them.
+void RendererBeginCubes(XrCompositionLayerProjectionView& view)
+{
+	// Set up the projection and view matrices for OpenXR
+	DirectX::XMMATRIX projectionMatrix = D3DRenderer::GetXRProjection(view.fov, 0.05f, 100.0f);
+	DirectX::XMMATRIX viewMatrix = XMMatrixInverse(nullptr, 
+		XMMatrixAffineTransformation(
+			DirectX::g_XMOne,
+			DirectX::g_XMZero,
+			DirectX::XMLoadFloat4((DirectX::XMFLOAT4*)&view.pose.orientation),
+			DirectX::XMLoadFloat3((DirectX::XMFLOAT3*)&view.pose.position)));
+
+	// For the D3D Context, set up the shader resources that will be used
+	d3dContext->VSSetConstantBuffers(0, 1, &constantsBuffer);
+	d3dContext->VSSetShader(instancedVertexShader, nullptr, 0);
+	d3dContext->PSSetShader(pixelShader, nullptr, 0);
+
+	// Prepare the vertex buffers for rendering
+	UINT strides[] = { sizeof(float) * 6 };
+	UINT offsets[] = { 0 };
+
+	d3dContext->IASetVertexBuffers(0, 1, &vertexBuffer, strides, offsets);
+	d3dContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	d3dContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	d3dContext->IASetInputLayout(instancedShaderLayout);
+
+	// Create the view x projection matrix and store it into the transform buffer.
+	TransformBuffer transformBuffer;
+	XMStoreFloat4x4(&transformBuffer.viewproj, XMMatrixTranspose(viewMatrix * projectionMatrix));
+	d3dContext->UpdateSubresource(constantsBuffer, 0, nullptr, &transformBuffer, 0, 0);
+}
+
+void D3DRenderer::DrawTransforms(XrCompositionLayerProjectionView& view, const InstanceTransform* transforms, size_t count)
+{
+	PROFILE_ZONE("D3DRenderer::DrawTransforms");
+
+	if (count == 0 || transientInstancesView == nullptr)
+		return;
+
+	RendererBeginCubes(view);
+	UINT stride = sizeof(uint32_t);
+	UINT offset = 0;
+	d3dContext->IASetVertexBuffers(1, 1, &transientDrawOrder, &stride, &offset);
+	d3dContext->VSSetShaderResources(0, 1, &transientInstancesView);
+
+	// One draw for a whole hand. Discarding hands us fresh memory each time,
+	// so this doesn't wait on the GPU to finish with the last lot.
+	for (size_t first = 0; first < count; first += transientCapacity)
+	{
+		uint32_t batch = (uint32_t)std::min(count - first, (size_t)transientCapacity);
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(d3dContext->Map(transientInstances, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		GPUInstance* packed = (GPUInstance*)mapped.pData;
+		for (uint32_t i = 0; i < batch; i++)
+			memcpy(packed[i].rows, transforms[first + i].m, sizeof(packed[i].rows));
+		d3dContext->Unmap(transientInstances, 0);
+		d3dContext->DrawIndexedInstanced(_countof(cuveIndices), batch, 0, 0, 0);
+	}
+}
+
+// Makes room for at least count instances, doubling so a growing scene only
+// reallocates now and then. What's already there is copied across on the GPU.
+bool RendererGrowInstances(InstanceBuffer& instances, uint32_t count)
+{
+	if (count <= instances.capacity)
+		return true;
+
+	uint32_t capacity = std::max(instances.capacity * 2, instanceMinCapacity);
+	while (capacity < count)
+		capacity *= 2;
+
+	ID3D11Buffer* buffer = nullptr;
+	CD3D11_BUFFER_DESC description(capacity * sizeof(GPUInstance), D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT, 0, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, sizeof(GPUInstance));
+	if (FAILED(d3dDevice->CreateBuffer(&description, nullptr, &buffer)))
+	{
+		LOG(ERROR) << "D3D 11 Failed to create an instance buffer for " << capacity << " instances";
+		return false;
+	}
+
+	ID3D11ShaderResourceView* view = nullptr;
+	CD3D11_SHADER_RESOURCE_VIEW_DESC viewDescription(buffer, DXGI_FORMAT_UNKNOWN, 0, capacity);
+	d3dDevice->CreateShaderResourceView(buffer, &viewDescription, &view);
+
+	if (instances.buffer)
+	{
+		if (instances.count > 0)
+		{
+			D3D11_BOX box = { 0, 0, 0, instances.count * (UINT)sizeof(GPUInstance), 1, 1 };
+			d3dContext->CopySubresourceRegion(buffer, 0, 0, 0, 0, instances.buffer, 0, &box);
+		}
+		instances.view->Release();
+		instances.buffer->Release();
+	}
+	instances.buffer = buffer;
+	instances.view = view;
+	instances.capacity = capacity;
+	return true;
+}
+
+// The next staging buffer in the ring, grown if it can't hold count instances
+InstanceStaging* RendererNextStaging(uint32_t count)
+{
+	InstanceStaging& staging = instanceStaging[instanceStagingNext];
+	instanceStagingNext = (instanceStagingNext + 1) % instanceStagingCount;
+	if (count <= staging.capacity)
+		return &staging;
+
+	uint32_t capacity = std::max(staging.capacity * 2, instanceMinCapacity);
+	while (capacity < count)
+		capacity *= 2;
+
+	if (staging.buffer)
+		staging.buffer->Release();
+	staging = {};
+	CD3D11_BUFFER_DESC description(capacity * sizeof(GPUInstance), 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_WRITE);
+	if (FAILED(d3dDevice->CreateBuffer(&description, nullptr, &staging.buffer)))
+	{
+		LOG(ERROR) << "D3D 11 Failed to create an instance staging buffer for " << capacity << " instances";
+		return nullptr;
+	}
+	staging.capacity = capacity;
+	return &staging;
+}
+
+void D3DRenderer::UpdateInstances(SceneStore::Partition partition, const SceneStore::Columns& columns)
+{
+	InstanceBuffer& instances = instanceBuffers[partition];
+	if (instances.buffer != nullptr && instances.generation == columns.generation)
+		return;
+
+	PROFILE_ZONE("D3DRenderer::UpdateInstances");
+	if (!RendererGrowInstances(instances, columns.count))
+		return;
+
+	// Only the cubes that changed since last time. If the dirty list has been
+	// cleared since then it might not have them all, so look at every cube.
+	instanceUploads.clear();
+	if (instances.generation < columns.dirtySince)
+	{
+		for (uint32_t i = 0; i < columns.count; i++)
+		{
+			if (columns.changed[i] > instances.generation)
+				instanceUploads.push_back(i);
+		}
+	}
+	else
+	{
+		for (uint32_t index : columns.dirty)
+		{
+			if (index < columns.count && columns.changed[index] > instances.generation)
+				instanceUploads.push_back(index);
+		}
+		std::sort(instanceUploads.begin(), instanceUploads.end());
+	}
+	instances.count = columns.count;
+	instances.generation = columns.generation;
+
+	uint32_t uploadCount = (uint32_t)instanceUploads.size();
+	if (uploadCount == 0)
+		return;
+
+	InstanceStaging* staging = RendererNextStaging(uploadCount);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (staging == nullptr || FAILED(d3dContext->Map(staging->buffer, 0, D3D11_MAP_WRITE, 0, &mapped)))
+	{
+		instances.generation = 0;
+		return;
+	}
+
+	// Pack the changed instances together in the staging buffer. Loading a
+	// scene uploads every cube at once, so that's split across the job system.
+	instanceTransforms.resize(uploadCount);
+	GPUInstance* packed = (GPUInstance*)mapped.pData;
+	JobSystem::ParallelFor(uploadCount, instancePackGrain, [&columns, packed](uint32_t begin, uint32_t end)
+	{
+		SceneStore::BuildTransforms(columns, instanceUploads.data() + begin, end - begin, instanceTransforms.data() + begin);
+		for (uint32_t i = begin; i < end; i++)
+			memcpy(packed[i].rows, instanceTransforms[i].m, sizeof(packed[i].rows));
+	});
+	d3dContext->Unmap(staging->buffer, 0);
+
+	// And copy them into place, one copy per run of neighbouring instances.
+	// New cubes are always on the end, so appending is a single copy.
+	for (uint32_t first = 0; first < uploadCount; )
+	{
+		uint32_t last = first;
+		while (last + 1 < uploadCount && instanceUploads[last + 1] == instanceUploads[last] + 1)
+			last++;
+
+		D3D11_BOX box = { first * (UINT)sizeof(GPUInstance), 0, 0, (last + 1) * (UINT)sizeof(GPUInstance), 1, 1 };
+		d3dContext->CopySubresourceRegion(instances.buffer, 0, instanceUploads[first] * (UINT)sizeof(GPUInstance), 0, 0, staging->buffer, 0, &box);
+		first = last + 1;
+	}
+
+	FrameTelemetry::Add(instanceBytesCounter, (int64_t)uploadCount * sizeof(GPUInstance));
+	PROFILE_COUNTER("Instances uploaded", uploadCount);
+}
+
+void D3DRenderer::SetDrawOrder(SceneStore::Partition partition, const uint32_t* indices, uint32_t count, uint64_t version)
+{
+	DrawOrder& order = drawOrders[partition];
+	if (order.buffer != nullptr && order.version == version)
+		return;
+
+	PROFILE_ZONE("D3DRenderer::SetDrawOrder");
+	order.count = 0;
+	order.version = version;
+	if (count == 0)
+		return;
+
+	// The whole order is rewritten, so there's nothing to keep when it grows
+	if (count > order.capacity)
+	{
+		uint32_t capacity = std::max(order.capacity * 2, instanceMinCapacity);
+		while (capacity < count)
+			capacity *= 2;
+
+		if (order.buffer) order.buffer->Release();
+		order.buffer = nullptr;
+		order.capacity = 0;
+
+		CD3D11_BUFFER_DESC description(capacity * sizeof(uint32_t), D3D11_BIND_VERTEX_BUFFER);
+		if (FAILED(d3dDevice->CreateBuffer(&description, nullptr, &order.buffer)))
+		{
+			LOG(ERROR) << "D3D 11 Failed to create a draw order for " << capacity << " instances";
+			return;
+		}
+		order.capacity = capacity;
+	}
+
+	D3D11_BOX box = { 0, 0, 0, count * (UINT)sizeof(uint32_t), 1, 1 };
+	d3dContext->UpdateSubresource(order.buffer, 0, &box, indices, 0, 0);
+	order.count = count;
+	FrameTelemetry::Add(visibleBytesCounter, (int64_t)count * sizeof(uint32_t));
+}
+
+void D3DRenderer::DrawInstances(XrCompositionLayerProjectionView& view, SceneStore::Partition partition, const SceneBVH::Range* ranges, uint32_t rangeCount)
+{
+	PROFILE_ZONE("D3DRenderer::DrawInstances");
+
+	const InstanceBuffer& instances = instanceBuffers[partition];
+	const DrawOrder& order = drawOrders[partition];
+	if (rangeCount == 0 || instances.view == nullptr || order.count == 0)
+		return;
+
+	RendererBeginCubes(view);
+
+	UINT stride = sizeof(uint32_t);
+	UINT offset = 0;
+	d3dContext->IASetVertexBuffers(1, 1, &order.buffer, &stride, &offset);
+	d3dContext->VSSetShaderResources(0, 1, &instances.view);
+
+	// A draw per run, each starting at its own place in the draw order
+	uint32_t drawn = 0;
+	for (uint32_t i = 0; i < rangeCount; i++)
+	{
+		const SceneBVH::Range& range = ranges[i];
+		if (range.first >= order.count)
+			break;
+		uint32_t count = std::min(range.count, order.count - range.first);
+		d3dContext->DrawIndexedInstanced(_countof(cuveIndices), count, 0, 0, range.first);
+		drawn += count;
+	}
+	PROFILE_COUNTER("Instances drawn", drawn);
+}
+
+void D3DRenderer::RenderLayer(XrCompositionLayerProjectionView& view, uint32_t viewIndex, SwapchainSurfacedata& surface) 
+{
+	PROFILE_ZONE("D3DRenderer::RenderLayer");
+
+	// Set up where on the render target we want to draw, the view has a 
+	XrRect2Di& rect = view.subImage.imageRect;
+	D3D11_VIEWPORT viewport = CD3D11_VIEWPORT((float)rect.offset.x, (float)rect.offset.y, (float)rect.extent.width, (float)rect.extent.height);
+	d3dContext->RSSetViewports(1, &viewport);
+
+	// Wipe our swapchain color and depth target clean, and then set them up for rendering!
+	float clear[] = { 0, 0, 0, 1 };
+	d3dContext->ClearRenderTargetView(surface.targetView, clear);
+	d3dContext->ClearDepthStencilView(surface.depthView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	d3dContext->OMSetRenderTargets(1, &surface.targetView, surface.depthView);
+
+	// And now that we're set up, pass on the rest of our rendering to the application
+	Application::Draw(view, viewIndex);
+}
+
+IDXGIAdapter1* D3DRenderer::GetAdapter(LUID& adapterLUID) 
+{
+	// find the appropriate DXGI adapter give a specific adapter LUID
+	IDXGIAdapter1* foundAdapter = nullptr;
+	IDXGIAdapter1* currentAdapter = nullptr;
+	IDXGIFactory1* dxgiFactory;
+	DXGI_ADAPTER_DESC1 adapterDescription;
+
+	CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)(&dxgiFactory));
+
+	int curr = 0;
+	while (dxgiFactory->EnumAdapters1(curr++, &currentAdapter) == S_OK) 
+	{
+		currentAdapter->GetDesc1(&adapterDescription);
+
+		if (memcmp(&adapterDescription.AdapterLuid, &adapterLUID, sizeof(&adapterLUID)) == 0) 
+		{
+			foundAdapter = currentAdapter;
+			break;
+		}
+		currentAdapter->Release();
+		currentAdapter = nullptr;
+	}
+	dxgiFactory->Release();
+	return foundAdapter;
+}
+
+ID3D11Device* D3DRenderer::GetDevice()
+{
+	return d3dDevice;
+}
+
+int64_t D3DRenderer::GetSwapchainFormat()
+{
+	return d3dSwapchainFormat;
+}
+
+DirectX::XMMATRIX D3DRenderer::GetXRProjection(XrFovf fov, float clip_near, float clip_far) 
+{
+	const float left = clip_near * tanf(fov.angleLeft);
+	const float right = clip_near * tanf(fov.angleRight);
+	const float down = clip_near * tanf(fov.angleDown);
+	const float up = clip_near * tanf(fov.angleUp);
+
+	return DirectX:: XMMatrixPerspectiveOffCenterRH(left, right, down, up, clip_near, clip_far);
+}
+
+#endif
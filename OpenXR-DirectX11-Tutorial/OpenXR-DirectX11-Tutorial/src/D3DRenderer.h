@@ -1,24 +1,50 @@
-#pragma once
-
-#include "TutorialStructs.h"
-#include <vector>
-
-namespace D3DRenderer
-{
-
-	bool					Init(LUID& adapter_luid);
-	void					SetupResources();
-	void					Shutdown();
-
-	SwapchainSurfacedata	MakeSurfaceData(XrBaseInStructure& swapchainImage);
-	void					SwapchainDestroy(Swapchain& swapchain);
-	ID3DBlob*				CompileShader(const char* hlsl, const char* entrypoint, const char* target);
-
-	void					DrawCubes(XrCompositionLayerProjectionView& view, std::vector<XrPosef>& poses);
-	void					RenderLayer(XrCompositionLayerProjectionView& layerView, SwapchainSurfacedata& surface);
-
-	IDXGIAdapter1*			GetAdapter(LUID& adapter_luid);
-	ID3D11Device*			GetDevice();
- 	int64_t					GetSwapchainFormat();
-	DirectX::XMMATRIX		GetXRProjection(XrFovf fov, float clip_near, float clip_far);
-}
\ No newline at end of file
+#pragma once
+
+#include "TutorialStructs.h"
+#include "SceneBVH.h"
+#include "SceneStore.h"
+#include <vector>
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+namespace D3DRenderer
+{
+
+	bool					Init(LUID& adapter_luid);
+	bool					InitWithoutRuntime();
+	void					CompileShaders();
+	bool					CreateShaders();
+	bool					CreateMeshBuffers();
+	void					Shutdown();
+
+	SwapchainSurfacedata	MakeSurfaceData(XrBaseInStructure& swapchainImage);
+	void					SwapchainDestroy(Swapchain& swapchain);
+
+	// Render targets that aren't owned by an OpenXR swapchain, for replaying
+	// frame captures without a runtime.
+	SwapchainSurfacedata	MakeOffscreenSurface(int32_t width, int32_t height);
+	void					OffscreenSurfaceDestroy(SwapchainSurfacedata& surface);
+	void					Flush();
+	ID3DBlob*				CompileShader(const char* hlsl, const char* entrypoint, const char* target);
+
+	// The cube mesh with ready-made world transforms, such as hand joints.
+	// They're uploaded fresh each call and drawn instanced, a draw per 64.
+	void					DrawTransforms(XrCompositionLayerProjectionView& view, const InstanceTransform* transforms, size_t count);
+
+	// Each scene partition has its own instance buffer on the GPU, which
+	// keeps its transforms from frame to frame. UpdateInstances only uploads
+	// the cubes that changed since it was last called, and nothing at all if
+	// the partition hasn't changed, so it's cheap to call for every view.
+	// SetDrawOrder says which instances to draw, in what order, and is just
+	// as cheap when version hasn't changed. DrawInstances then draws runs of
+	// the draw order, a call per run, with nothing uploaded at all.
+	void					UpdateInstances(SceneStore::Partition partition, const SceneStore::Columns& columns);
+	void					SetDrawOrder(SceneStore::Partition partition, const uint32_t* indices, uint32_t count, uint64_t version);
+	void					DrawInstances(XrCompositionLayerProjectionView& view, SceneStore::Partition partition, const SceneBVH::Range* ranges, uint32_t rangeCount);
+	void					RenderLayer(XrCompositionLayerProjectionView& layerView, uint32_t viewIndex, SwapchainSurfacedata& surface);
+
+	IDXGIAdapter1*			GetAdapter(LUID& adapter_luid);
+	ID3D11Device*			GetDevice();
+ 	int64_t					GetSwapchainFormat();
+	DirectX::XMMATRIX		GetXRProjection(XrFovf fov, float clip_near, float clip_far);
+}
+#endif
\ No newline at end of file
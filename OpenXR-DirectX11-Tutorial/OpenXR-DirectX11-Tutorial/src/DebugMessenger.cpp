@@ -0,0 +1,319 @@
+#include "DebugMessenger.h"
+#include "AsyncLog.h"
+#include "FrameTelemetry.h"
+
+#include "easylogging++.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+// Identical messages from the same ID are only logged again once this much
+// time has passed, and the rate limit is counted over the same window.
+constexpr uint64_t debugMessengerWindowNs = 1000000000ull;
+
+// Stats live in a fixed table, found by probing on from the ID's hash, so the
+// callback never allocates. Runtimes only use a handful of IDs, anything past
+// the table's size is counted together in the last entry.
+constexpr uint32_t debugMessengerMaxIDs = 256;
+constexpr size_t debugMessengerMaxIDLength = 64;
+
+struct DebugMessageStats
+{
+	uint64_t	idHash;				// 0 while the entry is unused
+	char		id[debugMessengerMaxIDLength];
+	uint64_t	total;
+	uint64_t	suppressed;			// Since the last one we logged
+	uint64_t	totalSuppressed;
+	uint64_t	windowStart;
+	uint32_t	windowCount;
+	uint64_t	lastMessageHash;
+};
+
+PFN_xrCreateDebugUtilsMessengerEXT	xrCreateDebugUtilsMessengerEXT = nullptr;
+PFN_xrDestroyDebugUtilsMessengerEXT	xrDestroyDebugUtilsMessengerEXT = nullptr;
+
+XrInstance							debugMessengerInstance = XR_NULL_HANDLE;
+XrDebugUtilsMessengerEXT			debugMessenger = XR_NULL_HANDLE;
+XrDebugUtilsMessageSeverityFlagsEXT	debugMessengerSubscribedSeverities = 0;
+XrDebugUtilsMessageTypeFlagsEXT		debugMessengerSubscribedTypes = 0;
+
+// The callback can run on whichever thread made the xr* call, so the settings
+// it reads are atomics, and the stats table has a lock.
+std::atomic<XrDebugUtilsMessageSeverityFlagsEXT>	debugMessengerSeverities = { 0 };
+std::atomic<XrDebugUtilsMessageTypeFlagsEXT>		debugMessengerTypes = { 0 };
+std::atomic<uint32_t>								debugMessengerMaxPerSecond = { 0 };
+bool												debugMessengerConfigured = false;
+
+std::mutex											debugMessengerStatsLock;
+DebugMessageStats									debugMessengerStats[debugMessengerMaxIDs + 1];
+uint32_t											debugMessengerStatsUsed = 0;
+FrameTelemetry::CounterID							debugMessengerPerformanceCounter = -1;
+
+// FNV-1a, good enough to tell message IDs and texts apart
+uint64_t DebugMessengerHash(const char* text)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (; text != nullptr && *text != '\0'; text++)
+		hash = (hash ^ (uint8_t)*text) * 1099511628211ull;
+	return hash;
+}
+
+// Must be called with the stats lock held
+DebugMessageStats& DebugMessengerFindStats(uint64_t idHash, const char* id, uint64_t now)
+{
+	// 0 marks unused entries, so that one hash gets moved out of the way
+	if (idHash == 0)
+		idHash = 1;
+
+	for (uint32_t probe = 0; probe < debugMessengerMaxIDs; probe++)
+	{
+		DebugMessageStats& stats = debugMessengerStats[(idHash + probe) % debugMessengerMaxIDs];
+		if (stats.idHash == idHash)
+			return stats;
+		if (stats.idHash == 0)
+		{
+			stats = {};
+			stats.idHash = idHash;
+			Platform::CopyString(stats.id, id);
+			stats.windowStart = now;
+			debugMessengerStatsUsed++;
+			return stats;
+		}
+	}
+
+	DebugMessageStats& overflow = debugMessengerStats[debugMessengerMaxIDs];
+	if (overflow.idHash == 0)
+	{
+		overflow.idHash = 1;
+		Platform::CopyString(overflow.id, "(other IDs)");
+		overflow.windowStart = now;
+	}
+	return overflow;
+}
+
+el::Level DebugMessengerLevel(XrDebugUtilsMessageSeverityFlagsEXT severity)
+{
+	if (severity & XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)   return el::Level::Error;
+	if (severity & XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return el::Level::Warning;
+	if (severity & XR_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)    return el::Level::Info;
+	return el::Level::Debug;
+}
+
+XrBool32 XRAPI_CALL DebugMessengerCallback(XrDebugUtilsMessageSeverityFlagsEXT severity, XrDebugUtilsMessageTypeFlagsEXT types, const XrDebugUtilsMessengerCallbackDataEXT* msg, void* /*user_data*/)
+{
+	// We may be subscribed to more than we want right now, if Configure
+	// narrowed things down since the messenger was created.
+	if (!(severity & debugMessengerSeverities.load(std::memory_order_relaxed)) ||
+		!(types & debugMessengerTypes.load(std::memory_order_relaxed)))
+		return XR_FALSE;
+
+	// Performance warnings tend to show up every frame, so rather than a log
+	// line each time, count them alongside the rest of our per-frame numbers.
+	// Errors still get logged no matter what type they are.
+	bool performanceOnly = (types & ~XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) == 0;
+	if (performanceOnly && !(severity & XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT))
+		FrameTelemetry::Add(debugMessengerPerformanceCounter);
+
+	const char* id = msg->messageId != nullptr ? msg->messageId : (msg->functionName != nullptr ? msg->functionName : "");
+	uint64_t idHash = DebugMessengerHash(id);
+	uint64_t messageHash = DebugMessengerHash(msg->message);
+	uint64_t now = Platform::GetTimeNanoseconds();
+	uint32_t maxPerSecond = debugMessengerMaxPerSecond.load(std::memory_order_relaxed);
+
+	uint64_t suppressed = 0;
+	{
+		std::lock_guard<std::mutex> lock(debugMessengerStatsLock);
+		DebugMessageStats& stats = DebugMessengerFindStats(idHash, id, now);
+		stats.total++;
+
+		if (performanceOnly && !(severity & XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT))
+			return XR_FALSE;
+
+		if (now - stats.windowStart >= debugMessengerWindowNs)
+		{
+			stats.windowStart = now;
+			stats.windowCount = 0;
+			stats.lastMessageHash = 0;
+		}
+
+		// Drop exact repeats within the window, and anything over the limit
+		bool duplicate = stats.windowCount > 0 && messageHash == stats.lastMessageHash;
+		bool overLimit = maxPerSecond != 0 && stats.windowCount >= maxPerSecond;
+		if (duplicate || overLimit)
+		{
+			stats.suppressed++;
+			stats.totalSuppressed++;
+			return XR_FALSE;
+		}
+
+		stats.windowCount++;
+		stats.lastMessageHash = messageHash;
+		suppressed = stats.suppressed;
+		stats.suppressed = 0;
+	}
+
+	if (suppressed > 0)
+		AsyncLog::Printf(DebugMessengerLevel(severity), true, "%s: %s (%llu similar messages suppressed)\n",
+			msg->functionName, msg->message, (unsigned long long)suppressed);
+	else
+		AsyncLog::Printf(DebugMessengerLevel(severity), true, "%s: %s\n", msg->functionName, msg->message);
+
+	// Returning XR_TRUE here will force the calling function to fail
+	return XR_FALSE;
+}
+
+DebugMessenger::Settings DebugMessenger::DefaultSettings()
+{
+	// Verbose and info messages can be really handy while developing, but
+	// some runtimes produce a lot of them, so they're opt-in.
+	Settings settings = {};
+	settings.severities =
+		XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+		XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	settings.types =
+		XR_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+		XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+		XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT |
+		XR_DEBUG_UTILS_MESSAGE_TYPE_CONFORMANCE_BIT_EXT;
+	settings.maxPerSecond = 5;
+	return settings;
+}
+
+struct DebugMessengerFlagName
+{
+	const char*	name;
+	uint64_t	flag;
+};
+
+const DebugMessengerFlagName debugMessengerSeverityNames[] = {
+	{ "verbose", XR_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT },
+	{ "info",    XR_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT },
+	{ "warning", XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT },
+	{ "error",   XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT },
+};
+
+const DebugMessengerFlagName debugMessengerTypeNames[] = {
+	{ "general",     XR_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT },
+	{ "validation",  XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT },
+	{ "performance", XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT },
+	{ "conformance", XR_DEBUG_UTILS_MESSAGE_TYPE_CONFORMANCE_BIT_EXT },
+};
+
+// Turns a list like "warning,error" into flags
+uint64_t DebugMessengerParseFlags(const char* list, const DebugMessengerFlagName* names, size_t nameCount)
+{
+	uint64_t flags = 0;
+	while (*list != '\0')
+	{
+		const char* end = strchr(list, ',');
+		size_t length = end != nullptr ? (size_t)(end - list) : strlen(list);
+
+		bool found = false;
+		for (size_t i = 0; i < nameCount; i++)
+		{
+			if (strlen(names[i].name) == length && strncmp(names[i].name, list, length) == 0)
+			{
+				flags |= names[i].flag;
+				found = true;
+			}
+		}
+		if (!found)
+			LOG(WARNING) << "Unknown debug messenger option: " << std::string(list, length);
+
+		list += length;
+		if (*list == ',')
+			list++;
+	}
+	return flags;
+}
+
+void DebugMessenger::ParseArguments(int argc, char** argv, Settings& settings)
+{
+	for (int32_t i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		if (strncmp(arg, "--xr-debug-severity=", 20) == 0)
+			settings.severities = DebugMessengerParseFlags(arg + 20, debugMessengerSeverityNames, _countof(debugMessengerSeverityNames));
+		else if (strncmp(arg, "--xr-debug-type=", 16) == 0)
+			settings.types = DebugMessengerParseFlags(arg + 16, debugMessengerTypeNames, _countof(debugMessengerTypeNames));
+		else if (strncmp(arg, "--xr-debug-rate=", 16) == 0)
+			settings.maxPerSecond = (uint32_t)strtoul(arg + 16, nullptr, 10);
+	}
+}
+
+bool DebugMessengerCreateHandle()
+{
+	if (xrCreateDebugUtilsMessengerEXT == nullptr || debugMessengerSeverities == 0 || debugMessengerTypes == 0)
+		return false;
+
+	// Here's some extra information about the message types and severities:
+	// https://www.khronos.org/registry/OpenXR/specs/1.0/html/xrspec.html#debug-message-categorization
+	XrDebugUtilsMessengerCreateInfoEXT createInfo = { XR_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT };
+	createInfo.messageSeverities = debugMessengerSeverities;
+	createInfo.messageTypes = debugMessengerTypes;
+	createInfo.userCallback = DebugMessengerCallback;
+	if (XR_FAILED(xrCreateDebugUtilsMessengerEXT(debugMessengerInstance, &createInfo, &debugMessenger)))
+	{
+		debugMessenger = XR_NULL_HANDLE;
+		return false;
+	}
+	debugMessengerSubscribedSeverities = createInfo.messageSeverities;
+	debugMessengerSubscribedTypes = createInfo.messageTypes;
+	return true;
+}
+
+void DebugMessenger::Configure(const Settings& settings)
+{
+	debugMessengerSeverities = settings.severities;
+	debugMessengerTypes = settings.types;
+	debugMessengerMaxPerSecond = settings.maxPerSecond;
+	debugMessengerConfigured = true;
+	debugMessengerPerformanceCounter = FrameTelemetry::RegisterCounter("OpenXR performance messages");
+
+	// Narrowing things down is handled in the callback, but the runtime won't
+	// send us anything we didn't ask for when the messenger was created.
+	if (debugMessenger != XR_NULL_HANDLE &&
+		((settings.severities & ~debugMessengerSubscribedSeverities) != 0 ||
+		 (settings.types & ~debugMessengerSubscribedTypes) != 0))
+	{
+		xrDestroyDebugUtilsMessengerEXT(debugMessenger);
+		debugMessenger = XR_NULL_HANDLE;
+		DebugMessengerCreateHandle();
+	}
+}
+
+bool DebugMessenger::Create(XrInstance instance)
+{
+	if (!debugMessengerConfigured)
+		Configure(DefaultSettings());
+	debugMessengerInstance = instance;
+	xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT", (PFN_xrVoidFunction*)(&xrCreateDebugUtilsMessengerEXT));
+	xrGetInstanceProcAddr(instance, "xrDestroyDebugUtilsMessengerEXT", (PFN_xrVoidFunction*)(&xrDestroyDebugUtilsMessengerEXT));
+	return DebugMessengerCreateHandle();
+}
+
+void DebugMessenger::Destroy()
+{
+	if (debugMessenger != XR_NULL_HANDLE)
+		xrDestroyDebugUtilsMessengerEXT(debugMessenger);
+	debugMessenger = XR_NULL_HANDLE;
+	debugMessengerInstance = XR_NULL_HANDLE;
+}
+
+void DebugMessenger::LogSummary()
+{
+	std::lock_guard<std::mutex> lock(debugMessengerStatsLock);
+	if (debugMessengerStatsUsed == 0)
+		return;
+
+	LOG(INFO) << "OpenXR debug messages by ID:";
+	for (const DebugMessageStats& stats : debugMessengerStats)
+	{
+		if (stats.idHash == 0)
+			continue;
+		LOG(INFO) << "  " << stats.id << ": " << stats.total << " messages, " << stats.totalSuppressed << " suppressed";
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "TutorialStructs.h"
+
+// Wraps the XR_EXT_debug_utils messenger. Which severities and types we
+// subscribe to is configurable, messages are logged at a level matching their
+// severity, and each message ID is rate limited so a chatty runtime can't
+// flood the log. Performance messages are counted in FrameTelemetry instead of
+// being logged, since they tend to fire every frame.
+namespace DebugMessenger
+{
+	struct Settings
+	{
+		XrDebugUtilsMessageSeverityFlagsEXT	severities;
+		XrDebugUtilsMessageTypeFlagsEXT		types;
+		uint32_t							maxPerSecond;	// Per message ID, 0 for no limit
+	};
+
+	Settings	DefaultSettings();
+
+	// Reads --xr-debug-severity=, --xr-debug-type= and --xr-debug-rate= from
+	// the command line. Severities and types are comma separated lists, like
+	// --xr-debug-severity=warning,error or --xr-debug-type=validation,performance
+	void		ParseArguments(int argc, char** argv, Settings& settings);
+
+	// Can be called at any time. If the messenger already exists and now needs
+	// messages it isn't subscribed to, it's recreated.
+	void		Configure(const Settings& settings);
+
+	bool		Create(XrInstance instance);
+	void		Destroy();
+
+	// Logs how many messages each ID produced and how many were suppressed
+	void		LogSummary();
+}
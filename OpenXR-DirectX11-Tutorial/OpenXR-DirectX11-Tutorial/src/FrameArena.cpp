@@ -0,0 +1,105 @@
+#include "FrameArena.h"
+#include "FrameTelemetry.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <vector>
+
+uint8_t*				frameArenaData = nullptr;
+size_t					frameArenaCapacity = 0;
+std::atomic<size_t>		frameArenaUsed = { 0 };
+size_t					frameArenaHighWater = 0;
+
+// What didn't fit, freed at the next Reset
+std::mutex				frameArenaOverflowLock;
+std::vector<void*>		frameArenaOverflow;
+size_t					frameArenaOverflowBytes = 0;
+
+FrameTelemetry::CounterID frameArenaBytesCounter = -1;
+FrameTelemetry::CounterID frameArenaOverflowCounter = -1;
+
+bool FrameArena::Init(size_t capacity)
+{
+	Shutdown();
+	frameArenaData = (uint8_t*)malloc(capacity);
+	if (frameArenaData == nullptr)
+	{
+		LOG(ERROR) << "Couldn't allocate a " << capacity << " byte frame arena";
+		return false;
+	}
+	frameArenaCapacity = capacity;
+	frameArenaBytesCounter = FrameTelemetry::RegisterCounter("Frame arena bytes");
+	frameArenaOverflowCounter = FrameTelemetry::RegisterCounter("Frame arena overflow bytes");
+	return true;
+}
+
+void FrameArena::Shutdown()
+{
+	Reset();
+	free(frameArenaData);
+	frameArenaData = nullptr;
+	frameArenaCapacity = 0;
+}
+
+void FrameArena::Reset()
+{
+	size_t used = frameArenaUsed.exchange(0, std::memory_order_relaxed);
+	size_t frameBytes = std::min(used, frameArenaCapacity) + frameArenaOverflowBytes;
+	frameArenaHighWater = std::max(frameArenaHighWater, frameBytes);
+	FrameTelemetry::Add(frameArenaBytesCounter, (int64_t)frameBytes);
+	if (frameArenaOverflow.empty())
+		return;
+
+	// Something didn't fit, so make room for the whole frame next time, with
+	// some to spare
+	FrameTelemetry::Add(frameArenaOverflowCounter, (int64_t)frameArenaOverflowBytes);
+	for (void* block : frameArenaOverflow)
+		free(block);
+	frameArenaOverflow.clear();
+	frameArenaOverflowBytes = 0;
+
+	size_t capacity = std::max(frameArenaCapacity, defaultCapacity);
+	while (capacity < frameArenaHighWater * 2)
+		capacity *= 2;
+	uint8_t* data = (uint8_t*)malloc(capacity);
+	if (data != nullptr)
+	{
+		free(frameArenaData);
+		frameArenaData = data;
+		frameArenaCapacity = capacity;
+	}
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	// Reserve enough for the worst case alignment, so claiming space is a
+	// single add no matter how many threads are allocating
+	size_t reserved = size + alignment - 1;
+	size_t offset = frameArenaUsed.fetch_add(reserved, std::memory_order_relaxed);
+	if (offset + reserved <= frameArenaCapacity)
+	{
+		uintptr_t address = (uintptr_t)(frameArenaData + offset);
+		return (void*)((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	std::lock_guard<std::mutex> lock(frameArenaOverflowLock);
+	uint8_t* block = (uint8_t*)malloc(std::max<size_t>(reserved, 1));
+	if (block == nullptr)
+	{
+		LOG(ERROR) << "Frame arena couldn't allocate " << size << " bytes";
+		abort();
+	}
+	frameArenaOverflow.push_back(block);
+	frameArenaOverflowBytes += reserved;
+	uintptr_t address = (uintptr_t)block;
+	return (void*)((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+size_t FrameArena::GetHighWater()
+{
+	return frameArenaHighWater;
+}
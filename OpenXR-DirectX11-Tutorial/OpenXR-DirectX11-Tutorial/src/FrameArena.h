@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Scratch memory for data that only lives for one frame. Allocating is just
+// bumping an offset, and nothing is freed on its own: Reset, which
+// RenderFrame calls right before xrBeginFrame, throws away everything from
+// the frame before at once. Anything allocated here must not be kept past
+// the next Reset.
+//
+// If a frame needs more than the arena holds, the rest comes from the heap,
+// and the next Reset grows the arena to fit, so it settles at whatever the
+// busiest frame needs. Allocate can be called from job threads too.
+namespace FrameArena
+{
+	const size_t	defaultCapacity = 1 << 20;
+
+	bool		Init(size_t capacity = defaultCapacity);
+	void		Shutdown();
+	void		Reset();
+
+	// Never returns null, size can be zero
+	void*		Allocate(size_t size, size_t alignment = 16);
+
+	// Most bytes allocated in any one frame so far
+	size_t		GetHighWater();
+
+	// Nothing's destroyed at Reset, so only types that don't need it
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Frame arena memory is never destroyed");
+		return (T*)Allocate(sizeof(T) * count, alignof(T));
+	}
+}
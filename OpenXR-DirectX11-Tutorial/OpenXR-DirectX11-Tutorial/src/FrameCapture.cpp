@@ -0,0 +1,257 @@
+#include "FrameCapture.h"
+#include "PoseStream.h"
+
+#include "easylogging++.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <fstream>
+
+using namespace FrameCapture;
+
+const char		captureMagic[8] = { 'X', 'R', 'C', 'A', 'P', 'T', '0', '1' };
+const uint32_t	captureVersion = 4;
+
+std::ofstream	captureFile;
+bool			captureRecording = false;
+CapturedFrame	captureCurrentFrame = {};
+uint64_t		captureFrameCount = 0;
+
+// Views 0 and 1, then the left and right hands. A keyframe a second at 90Hz.
+const uint32_t		capturePoseCount = 4;
+const uint32_t		capturePoseKeyframeInterval = 90;
+PoseStream::Writer	capturePoseWriter;
+
+MappedFile				replayFile = {};
+const CaptureHeader*	replayHeader = nullptr;
+const CapturedFrame*	replayFrames = nullptr;
+uint64_t				replayFrameCount = 0;
+
+uint64_t CaptureAlign(uint64_t offset)
+{
+	return (offset + 15) & ~(uint64_t)15;
+}
+
+// The Record* calls have work to do if either kind of recording is running
+bool CaptureActive()
+{
+	return captureRecording || PoseStream::IsOpen(capturePoseWriter);
+}
+
+void CaptureCopyInput(const InputState& input, CapturedInput& captured)
+{
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		captured.handPose[i] = input.handPose[i];
+		captured.renderHand[i] = input.renderHand[i];
+		captured.handSelect[i] = input.handSelect[i];
+		captured.handPicked[i] = input.handPicked[i];
+		captured.handPickedCube[i] = input.handPickedCube[i];
+	}
+}
+
+bool FrameCapture::StartRecording(const char* path, XrExtent2Di viewExtent, const uint8_t* scene, size_t sceneSize)
+{
+	captureFile.open(path, std::ios::binary | std::ios::trunc);
+	if (!captureFile.is_open())
+	{
+		LOG(WARNING) << "Unable to create the frame capture " << path;
+		return false;
+	}
+
+	// The frame count gets patched in when we stop. If we never get there,
+	// replay works it out from the file size instead.
+	CaptureHeader header = {};
+	memcpy(header.magic, captureMagic, sizeof(captureMagic));
+	header.version = captureVersion;
+	header.frameSize = sizeof(CapturedFrame);
+	header.viewExtent = viewExtent;
+
+	// The scene starts on a 16 byte boundary, so its columns are still
+	// aligned the way SceneFile lays them out
+	const char padding[16] = {};
+	header.sceneOffset = CaptureAlign(sizeof(header));
+	header.sceneSize = sceneSize;
+	header.framesOffset = CaptureAlign(header.sceneOffset + sceneSize);
+	captureFile.write((const char*)&header, sizeof(header));
+	captureFile.write(padding, header.sceneOffset - sizeof(header));
+	captureFile.write((const char*)scene, sceneSize);
+	captureFile.write(padding, header.framesOffset - header.sceneOffset - sceneSize);
+
+	captureCurrentFrame = {};
+	captureFrameCount = 0;
+	captureRecording = true;
+	LOG(INFO) << "Recording frames to " << path;
+	return true;
+}
+
+void FrameCapture::StopRecording()
+{
+	if (!captureRecording)
+		return;
+	captureRecording = false;
+
+	captureFile.seekp(offsetof(CaptureHeader, frameCount));
+	captureFile.write((const char*)&captureFrameCount, sizeof(captureFrameCount));
+	captureFile.close();
+	LOG(INFO) << "Recorded " << captureFrameCount << " frames";
+}
+
+bool FrameCapture::IsRecording()
+{
+	return captureRecording;
+}
+
+bool FrameCapture::StartPoseRecording(const char* path)
+{
+	if (!PoseStream::OpenWriter(path, capturePoseCount, capturePoseKeyframeInterval, capturePoseWriter))
+		return false;
+	if (!captureRecording)
+		captureCurrentFrame = {};
+	LOG(INFO) << "Recording poses to " << path;
+	return true;
+}
+
+void FrameCapture::StopPoseRecording()
+{
+	PoseStream::CloseWriter(capturePoseWriter);
+}
+
+void FrameCapture::RecordFrameState(const XrFrameState& frameState)
+{
+	if (!CaptureActive())
+		return;
+	captureCurrentFrame.predictedDisplayTime = frameState.predictedDisplayTime;
+	captureCurrentFrame.predictedDisplayPeriod = frameState.predictedDisplayPeriod;
+	captureCurrentFrame.shouldRender = frameState.shouldRender;
+}
+
+void FrameCapture::RecordActionInput(const InputState& input)
+{
+	if (!CaptureActive())
+		return;
+	CaptureCopyInput(input, captureCurrentFrame.actionInput);
+}
+
+void FrameCapture::RecordPredictedInput(const InputState& input)
+{
+	if (!CaptureActive())
+		return;
+	CaptureCopyInput(input, captureCurrentFrame.predictedInput);
+}
+
+void FrameCapture::RecordViews(const XrView* views, uint32_t viewCount)
+{
+	if (!CaptureActive())
+		return;
+	captureCurrentFrame.viewCount = viewCount < maxViews ? viewCount : maxViews;
+	for (uint32_t i = 0; i < captureCurrentFrame.viewCount; i++)
+	{
+		captureCurrentFrame.viewPose[i] = views[i].pose;
+		captureCurrentFrame.viewFov[i] = views[i].fov;
+	}
+}
+
+void FrameCapture::RecordHandJoints(uint32_t hand, const XrHandJointLocationEXT* joints, bool isActive)
+{
+	// Pose streams don't have room for joints, so only full captures take them
+	if (!captureRecording)
+		return;
+	CapturedHand& captured = captureCurrentFrame.hands[hand];
+	captured.isActive = isActive;
+	memcpy(captured.joints, joints, sizeof(captured.joints));
+}
+
+void FrameCapture::RecordEndFrame(XrSessionState sessionState)
+{
+	if (!CaptureActive())
+		return;
+
+	if (PoseStream::IsOpen(capturePoseWriter))
+	{
+		XrPosef poses[capturePoseCount] = {};
+		uint32_t validMask = 0;
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			poses[i] = captureCurrentFrame.viewPose[i];
+			poses[2 + i] = captureCurrentFrame.predictedInput.handPose[i];
+			if (i < captureCurrentFrame.viewCount)
+				validMask |= 1u << i;
+			if (captureCurrentFrame.predictedInput.renderHand[i])
+				validMask |= 1u << (2 + i);
+		}
+		PoseStream::WriteSample(capturePoseWriter, captureCurrentFrame.predictedDisplayTime, poses, validMask);
+	}
+
+	if (captureRecording)
+	{
+		captureCurrentFrame.frameIndex = captureFrameCount++;
+		captureCurrentFrame.sessionState = sessionState;
+		captureFile.write((const char*)&captureCurrentFrame, sizeof(captureCurrentFrame));
+	}
+
+	// Frames where nothing was located (the session wasn't visible) shouldn't
+	// inherit the views from the last frame that was.
+	captureCurrentFrame.viewCount = 0;
+}
+
+bool FrameCapture::OpenReplay(const char* path)
+{
+	if (!Platform::OpenMappedFile(path, false, replayFile))
+	{
+		LOG(ERROR) << "Unable to open the frame capture " << path;
+		return false;
+	}
+
+	replayHeader = (const CaptureHeader*)replayFile.data;
+	if (replayFile.size < sizeof(CaptureHeader) ||
+		memcmp(replayHeader->magic, captureMagic, sizeof(captureMagic)) != 0 ||
+		replayHeader->version != captureVersion ||
+		replayHeader->frameSize != sizeof(CapturedFrame) ||
+		replayHeader->framesOffset > replayFile.size ||
+		replayHeader->sceneOffset > replayHeader->framesOffset ||
+		replayHeader->sceneSize > replayHeader->framesOffset - replayHeader->sceneOffset)
+	{
+		LOG(ERROR) << path << " isn't a frame capture, or is from a different version";
+		CloseReplay();
+		return false;
+	}
+
+	// If the recording was cut short, the header never got its frame count
+	replayFrames = (const CapturedFrame*)(replayFile.data + replayHeader->framesOffset);
+	replayFrameCount = (replayFile.size - replayHeader->framesOffset) / sizeof(CapturedFrame);
+	if (replayHeader->frameCount != 0 && replayHeader->frameCount < replayFrameCount)
+		replayFrameCount = replayHeader->frameCount;
+
+	LOG(INFO) << "Replaying " << replayFrameCount << " frames from " << path;
+	return true;
+}
+
+void FrameCapture::CloseReplay()
+{
+	Platform::CloseMappedFile(replayFile);
+	replayHeader = nullptr;
+	replayFrames = nullptr;
+	replayFrameCount = 0;
+}
+
+uint64_t FrameCapture::GetReplayFrameCount()
+{
+	return replayFrameCount;
+}
+
+XrExtent2Di FrameCapture::GetReplayViewExtent()
+{
+	return replayHeader != nullptr ? replayHeader->viewExtent : XrExtent2Di{};
+}
+
+const uint8_t* FrameCapture::GetReplayScene(size_t& size)
+{
+	size = replayHeader != nullptr ? (size_t)replayHeader->sceneSize : 0;
+	return replayHeader != nullptr ? replayFile.data + replayHeader->sceneOffset : nullptr;
+}
+
+const CapturedFrame& FrameCapture::GetReplayFrame(uint64_t index)
+{
+	return replayFrames[index];
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "TutorialStructs.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Records everything the app consumes from OpenXR each frame, so the exact
+// same frames can be played back later with no runtime at all. A capture from
+// someone's headset can be replayed on a desktop, or on a headless Linux box,
+// as fast as the app can go, which makes performance problems reproducible
+// and regressions easy to bisect.
+//
+// A capture file is a CaptureHeader, then the placed cubes as they were when
+// recording started (in SceneFile's format), then one CapturedFrame per
+// frame. Frames are fixed size, so replay can map the file and index straight
+// into them.
+//
+// For soak tests, where a full capture would get huge, the head and hand
+// poses alone can be recorded as a PoseStream instead.
+namespace FrameCapture
+{
+	const uint32_t maxViews = 4;
+
+	// The parts of InputState the application reads. The rest are handles,
+	// which are meaningless without the session they came from.
+	struct CapturedInput
+	{
+		XrPosef		handPose[2];
+		XrBool32	renderHand[2];
+		XrBool32	handSelect[2];
+		XrBool32	handPicked[2];		// The input sampler's pick, from when select was pressed
+		uint32_t	handPickedCube[2];
+	};
+
+	// A hand's joints, as the runtime gave them to HandTracking
+	struct CapturedHand
+	{
+		XrBool32				isActive;
+		uint32_t				padding;
+		XrHandJointLocationEXT	joints[XR_HAND_JOINT_COUNT_EXT];
+	};
+
+	struct CapturedFrame
+	{
+		uint64_t		frameIndex;
+		XrTime			predictedDisplayTime;
+		XrDuration		predictedDisplayPeriod;
+		XrSessionState	sessionState;
+		XrBool32		shouldRender;
+
+		CapturedInput	actionInput;		// After PollActions, what Application::Update sees
+		CapturedInput	predictedInput;		// After PollPredicted, what UpdatePredicted sees
+
+		uint32_t		viewCount;
+		uint32_t		padding;
+		XrPosef			viewPose[maxViews];
+		XrFovf			viewFov[maxViews];
+
+		CapturedHand	hands[2];			// Located with the predicted input
+	};
+
+	struct CaptureHeader
+	{
+		char			magic[8];
+		uint32_t		version;
+		uint32_t		frameSize;		// sizeof(CapturedFrame) when it was written
+		XrExtent2Di		viewExtent;		// Size of each view's render target
+		uint64_t		frameCount;		// Filled in when recording stops
+		uint64_t		sceneOffset;	// The scene snapshot, from the start of the file
+		uint64_t		sceneSize;
+		uint64_t		framesOffset;
+	};
+
+	// Recording. The Record* calls are made from the frame loop, and do nothing
+	// unless a recording is in progress.
+	// scene is the placed cubes as a scene file, see Application::SnapshotScene
+	bool	StartRecording(const char* path, XrExtent2Di viewExtent, const uint8_t* scene, size_t sceneSize);
+	void	StopRecording();
+	bool	IsRecording();
+
+	// Records the first two views and both hands each frame, to a pose stream
+	bool	StartPoseRecording(const char* path);
+	void	StopPoseRecording();
+
+	void	RecordFrameState(const XrFrameState& frameState);
+	void	RecordActionInput(const InputState& input);
+	void	RecordPredictedInput(const InputState& input);
+	void	RecordViews(const XrView* views, uint32_t viewCount);
+	void	RecordHandJoints(uint32_t hand, const XrHandJointLocationEXT* joints, bool isActive);
+	void	RecordEndFrame(XrSessionState sessionState);
+
+	// Playback
+	bool					OpenReplay(const char* path);
+	void					CloseReplay();
+	uint64_t				GetReplayFrameCount();
+	XrExtent2Di				GetReplayViewExtent();
+	// The scene snapshot, good until CloseReplay
+	const uint8_t*			GetReplayScene(size_t& size);
+	const CapturedFrame&	GetReplayFrame(uint64_t index);
+}
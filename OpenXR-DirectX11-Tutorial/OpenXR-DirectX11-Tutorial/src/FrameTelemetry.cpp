@@ -0,0 +1,153 @@
+#include "FrameTelemetry.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+// A fixed table, so counters never move and Add never needs a lock
+constexpr int32_t frameTelemetryMaxCounters = 64;
+constexpr int32_t frameTelemetryMaxHistograms = 16;
+
+struct FrameTelemetryCounter
+{
+	const char*				name;
+	std::atomic<int64_t>	current;	// Accumulates until the end of the frame
+	int64_t					lastFrame;
+	int64_t					total;
+	int64_t					peak;
+	uint64_t				framesSeen;
+};
+
+std::mutex					frameTelemetryRegisterLock;
+FrameTelemetryCounter		frameTelemetryCounters[frameTelemetryMaxCounters];
+std::atomic<int32_t>		frameTelemetryCounterCount = { 0 };
+uint64_t					frameTelemetryFrameCount = 0;
+
+struct FrameTelemetryHistogram
+{
+	const char*				name;
+	double					scale;
+	const char*				unit;
+	Histogram::Distribution	distribution;
+};
+
+FrameTelemetryHistogram		frameTelemetryHistograms[frameTelemetryMaxHistograms];
+std::atomic<int32_t>		frameTelemetryHistogramCount = { 0 };
+
+FrameTelemetry::CounterID FrameTelemetry::RegisterCounter(const char* name)
+{
+	std::lock_guard<std::mutex> lock(frameTelemetryRegisterLock);
+	int32_t count = frameTelemetryCounterCount.load(std::memory_order_relaxed);
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (strcmp(frameTelemetryCounters[i].name, name) == 0)
+			return i;
+	}
+
+	if (count == frameTelemetryMaxCounters)
+	{
+		LOG(WARNING) << "Out of frame telemetry counters, can't add " << name;
+		return -1;
+	}
+
+	frameTelemetryCounters[count].name = name;
+	frameTelemetryCounterCount.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void FrameTelemetry::Add(CounterID counter, int64_t value)
+{
+	if (counter < 0)
+		return;
+	frameTelemetryCounters[counter].current.fetch_add(value, std::memory_order_relaxed);
+}
+
+void FrameTelemetry::EndFrame()
+{
+	int32_t count = frameTelemetryCounterCount.load(std::memory_order_acquire);
+	for (int32_t i = 0; i < count; i++)
+	{
+		FrameTelemetryCounter& counter = frameTelemetryCounters[i];
+		int64_t value = counter.current.exchange(0, std::memory_order_relaxed);
+		counter.lastFrame = value;
+		counter.total += value;
+		if (value > counter.peak)
+			counter.peak = value;
+		if (value != 0)
+			counter.framesSeen++;
+		PROFILE_COUNTER(counter.name, value);
+	}
+	frameTelemetryFrameCount++;
+}
+
+FrameTelemetry::HistogramID FrameTelemetry::RegisterHistogram(const char* name, double scale, const char* unit)
+{
+	std::lock_guard<std::mutex> lock(frameTelemetryRegisterLock);
+	int32_t count = frameTelemetryHistogramCount.load(std::memory_order_relaxed);
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (strcmp(frameTelemetryHistograms[i].name, name) == 0)
+			return i;
+	}
+
+	if (count == frameTelemetryMaxHistograms)
+	{
+		LOG(WARNING) << "Out of frame telemetry histograms, can't add " << name;
+		return -1;
+	}
+
+	frameTelemetryHistograms[count].name = name;
+	frameTelemetryHistograms[count].scale = scale;
+	frameTelemetryHistograms[count].unit = unit;
+	frameTelemetryHistogramCount.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void FrameTelemetry::Record(HistogramID histogram, int64_t value)
+{
+	if (histogram < 0)
+		return;
+	Histogram::Add(frameTelemetryHistograms[histogram].distribution, value);
+}
+
+const Histogram::Distribution& FrameTelemetry::GetDistribution(HistogramID histogram)
+{
+	return frameTelemetryHistograms[histogram].distribution;
+}
+
+int64_t FrameTelemetry::GetLastFrame(CounterID counter)
+{
+	return counter < 0 ? 0 : frameTelemetryCounters[counter].lastFrame;
+}
+
+int64_t FrameTelemetry::GetTotal(CounterID counter)
+{
+	return counter < 0 ? 0 : frameTelemetryCounters[counter].total;
+}
+
+uint64_t FrameTelemetry::GetFrameCount()
+{
+	return frameTelemetryFrameCount;
+}
+
+void FrameTelemetry::LogSummary()
+{
+	int32_t count = frameTelemetryCounterCount.load(std::memory_order_acquire);
+	LOG(INFO) << "Frame telemetry over " << frameTelemetryFrameCount << " frames:";
+	for (int32_t i = 0; i < count; i++)
+	{
+		const FrameTelemetryCounter& counter = frameTelemetryCounters[i];
+		LOG(INFO) << "  " << counter.name << ": total " << counter.total << ", peak " << counter.peak
+			<< " in one frame, seen in " << counter.framesSeen << " frames";
+	}
+
+	int32_t histogramCount = frameTelemetryHistogramCount.load(std::memory_order_acquire);
+	for (int32_t i = 0; i < histogramCount; i++)
+	{
+		const FrameTelemetryHistogram& histogram = frameTelemetryHistograms[i];
+		Histogram::Log(histogram.distribution, histogram.name, histogram.scale, histogram.unit);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Histogram.h"
+
+#include <stdint.h>
+
+// Per-frame counters for things we want to keep an eye on without writing a
+// log line each time they happen. Counters can be bumped from any thread
+// without a lock. EndFrame is called once per frame by the frame loop, which
+// closes out the frame's values and folds them into the running totals.
+namespace FrameTelemetry
+{
+	typedef int32_t CounterID;
+	typedef int32_t HistogramID;
+
+	// The name must be a string literal, only the pointer is kept. Registering
+	// the same name twice returns the same counter.
+	CounterID	RegisterCounter(const char* name);
+	void		Add(CounterID counter, int64_t value = 1);
+
+	void		EndFrame();
+
+	// Distributions of values that don't add up per frame, like errors or
+	// latencies. Values are divided by scale when they're logged. A histogram
+	// isn't atomic, so each one should only be recorded from one thread.
+	HistogramID	RegisterHistogram(const char* name, double scale, const char* unit);
+	void		Record(HistogramID histogram, int64_t value);
+	const Histogram::Distribution&	GetDistribution(HistogramID histogram);
+
+	int64_t		GetLastFrame(CounterID counter);
+	int64_t		GetTotal(CounterID counter);
+	uint64_t	GetFrameCount();
+
+	// Writes each counter's total, peak and how many frames it was seen in,
+	// and each histogram's percentiles
+	void		LogSummary();
+}
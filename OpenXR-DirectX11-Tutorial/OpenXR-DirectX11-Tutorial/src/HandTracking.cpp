@@ -0,0 +1,402 @@
+#include "HandTracking.h"
+#include "FrameCapture.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAND_TRACKING_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+using namespace HandTracking;
+
+PFN_xrCreateHandTrackerEXT		xrCreateHandTrackerEXT = nullptr;
+PFN_xrDestroyHandTrackerEXT		xrDestroyHandTrackerEXT = nullptr;
+PFN_xrLocateHandJointsEXT		xrLocateHandJointsEXT = nullptr;
+
+bool					handTrackingSupported = false;
+XrHandTrackerEXT		handTrackers[2] = { XR_NULL_HANDLE, XR_NULL_HANDLE };
+
+// Filled in place every frame, nothing here allocates after startup
+XrHandJointLocationEXT	handJointLocations[2][jointCount];
+Joints					handJoints[2] = {};
+InstanceTransform		handTransforms[2][paddedJointCount] = {};
+
+bool HandTracking::Init(XrInstance instance, XrSystemId systemId)
+{
+	handTrackingSupported = false;
+	xrGetInstanceProcAddr(instance, "xrCreateHandTrackerEXT", (PFN_xrVoidFunction*)(&xrCreateHandTrackerEXT));
+	xrGetInstanceProcAddr(instance, "xrDestroyHandTrackerEXT", (PFN_xrVoidFunction*)(&xrDestroyHandTrackerEXT));
+	xrGetInstanceProcAddr(instance, "xrLocateHandJointsEXT", (PFN_xrVoidFunction*)(&xrLocateHandJointsEXT));
+	if (xrCreateHandTrackerEXT == nullptr || xrDestroyHandTrackerEXT == nullptr || xrLocateHandJointsEXT == nullptr)
+		return false;
+
+	// The extension being there only means the runtime knows about hand
+	// tracking, the headset still has to be able to do it.
+	XrSystemHandTrackingPropertiesEXT handTrackingProperties = { XR_TYPE_SYSTEM_HAND_TRACKING_PROPERTIES_EXT };
+	XrSystemProperties systemProperties = { XR_TYPE_SYSTEM_PROPERTIES };
+	systemProperties.next = &handTrackingProperties;
+	if (XR_FAILED(xrGetSystemProperties(instance, systemId, &systemProperties)))
+		return false;
+
+	handTrackingSupported = handTrackingProperties.supportsHandTracking == XR_TRUE;
+	LOG(INFO) << "Hand tracking " << (handTrackingSupported ? "is" : "isn't") << " supported by this system";
+	return handTrackingSupported;
+}
+
+bool HandTracking::CreateTrackers(XrSession session)
+{
+	if (!handTrackingSupported)
+		return false;
+
+	const XrHandEXT hands[2] = { XR_HAND_LEFT_EXT, XR_HAND_RIGHT_EXT };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		XrHandTrackerCreateInfoEXT createInfo = { XR_TYPE_HAND_TRACKER_CREATE_INFO_EXT };
+		createInfo.hand = hands[i];
+		createInfo.handJointSet = XR_HAND_JOINT_SET_DEFAULT_EXT;
+		if (XR_FAILED(xrCreateHandTrackerEXT(session, &createInfo, &handTrackers[i])))
+		{
+			LOG(WARNING) << "Couldn't create a hand tracker, carrying on without hands";
+			Shutdown();
+			return false;
+		}
+	}
+	return true;
+}
+
+void HandTracking::Shutdown()
+{
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (handTrackers[i] != XR_NULL_HANDLE)
+			xrDestroyHandTrackerEXT(handTrackers[i]);
+		handTrackers[i] = XR_NULL_HANDLE;
+		handJoints[i].isActive = false;
+		handJoints[i].validMask = 0;
+	}
+}
+
+bool HandTracking::IsAvailable()
+{
+	return handTrackers[0] != XR_NULL_HANDLE;
+}
+
+void HandTracking::Locate(XrSpace baseSpace, XrTime time)
+{
+	if (!IsAvailable())
+		return;
+	PROFILE_ZONE("HandTracking::Locate");
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		XrHandJointsLocateInfoEXT locateInfo = { XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT };
+		locateInfo.baseSpace = baseSpace;
+		locateInfo.time = time;
+
+		XrHandJointLocationsEXT locations = { XR_TYPE_HAND_JOINT_LOCATIONS_EXT };
+		locations.jointCount = jointCount;
+		locations.jointLocations = handJointLocations[i];
+
+		bool located = XR_SUCCEEDED(xrLocateHandJointsEXT(handTrackers[i], &locateInfo, &locations));
+		StoreJoints(handJointLocations[i], located && locations.isActive, handJoints[i]);
+		if (handJoints[i].isActive)
+			BuildTransforms(handJoints[i], handTransforms[i]);
+	}
+}
+
+const Joints& HandTracking::GetJoints(uint32_t hand)
+{
+	return handJoints[hand];
+}
+
+const InstanceTransform* HandTracking::GetTransforms(uint32_t hand)
+{
+	return handTransforms[hand];
+}
+
+const XrHandJointLocationEXT* HandTracking::GetLocations(uint32_t hand)
+{
+	return handJointLocations[hand];
+}
+
+void HandTracking::SetJoints(uint32_t hand, const XrHandJointLocationEXT* locations, bool isActive)
+{
+	memcpy(handJointLocations[hand], locations, sizeof(handJointLocations[hand]));
+	StoreJoints(handJointLocations[hand], isActive, handJoints[hand]);
+	if (handJoints[hand].isActive)
+		BuildTransforms(handJoints[hand], handTransforms[hand]);
+}
+
+void HandTracking::StoreJoints(const XrHandJointLocationEXT* locations, bool isActive, Joints& joints)
+{
+	const XrSpaceLocationFlags validFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+
+	joints.isActive = isActive;
+	joints.validMask = 0;
+	if (!isActive)
+		return;
+
+	for (uint32_t j = 0; j < jointCount; j++)
+	{
+		const XrHandJointLocationEXT& location = locations[j];
+		joints.positionX[j] = location.pose.position.x;
+		joints.positionY[j] = location.pose.position.y;
+		joints.positionZ[j] = location.pose.position.z;
+		joints.orientationX[j] = location.pose.orientation.x;
+		joints.orientationY[j] = location.pose.orientation.y;
+		joints.orientationZ[j] = location.pose.orientation.z;
+		joints.orientationW[j] = location.pose.orientation.w;
+		joints.radius[j] = location.radius;
+		if ((location.locationFlags & validFlags) == validFlags)
+			joints.validMask |= 1u << j;
+	}
+
+	// The padding is an identity pose that's never valid, so it can go through
+	// the same math as everything else
+	for (uint32_t j = jointCount; j < paddedJointCount; j++)
+	{
+		joints.positionX[j] = joints.positionY[j] = joints.positionZ[j] = 0;
+		joints.orientationX[j] = joints.orientationY[j] = joints.orientationZ[j] = 0;
+		joints.orientationW[j] = 1;
+		joints.radius[j] = 0;
+	}
+}
+
+// Each transform is [radius * R | position] over [0 0 0 1], where R is the
+// rotation matrix of the joint's orientation.
+void HandTracking::BuildTransformsScalar(const Joints& joints, InstanceTransform* transforms)
+{
+	for (uint32_t j = 0; j < paddedJointCount; j++)
+	{
+		float x = joints.orientationX[j], y = joints.orientationY[j], z = joints.orientationZ[j], w = joints.orientationW[j];
+		float s = (joints.validMask & (1u << j)) ? joints.radius[j] : 0.0f;
+		float (&m)[4][4] = transforms[j].m;
+
+		m[0][0] = s * (1 - 2 * (y * y + z * z)); m[0][1] = s * 2 * (x * y - w * z);     m[0][2] = s * 2 * (x * z + w * y);     m[0][3] = joints.positionX[j];
+		m[1][0] = s * 2 * (x * y + w * z);     m[1][1] = s * (1 - 2 * (x * x + z * z)); m[1][2] = s * 2 * (y * z - w * x);     m[1][3] = joints.positionY[j];
+		m[2][0] = s * 2 * (x * z - w * y);     m[2][1] = s * 2 * (y * z + w * x);     m[2][2] = s * (1 - 2 * (x * x + y * y)); m[2][3] = joints.positionZ[j];
+		m[3][0] = 0;                           m[3][1] = 0;                           m[3][2] = 0;                           m[3][3] = 1;
+	}
+}
+
+#if defined(HAND_TRACKING_SSE)
+// The same math four joints at a time. Each register holds one matrix element
+// for four joints, and a transpose turns four of them into four matrix rows.
+void HandTracking::BuildTransforms(const Joints& joints, InstanceTransform* transforms)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 lastRow = _mm_set_ps(1, 0, 0, 0);
+	const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+
+	for (uint32_t j = 0; j < paddedJointCount; j += 4)
+	{
+		__m128 x = _mm_load_ps(&joints.orientationX[j]);
+		__m128 y = _mm_load_ps(&joints.orientationY[j]);
+		__m128 z = _mm_load_ps(&joints.orientationZ[j]);
+		__m128 w = _mm_load_ps(&joints.orientationW[j]);
+
+		// Radius where the joint is valid, zero where it isn't
+		__m128i bits = _mm_and_si128(_mm_set1_epi32((int32_t)(joints.validMask >> j)), laneBits);
+		__m128  valid = _mm_castsi128_ps(_mm_cmpeq_epi32(bits, laneBits));
+		__m128  s = _mm_and_ps(_mm_load_ps(&joints.radius[j]), valid);
+		__m128  s2 = _mm_mul_ps(s, two);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 r0 = _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+		__m128 r1 = _mm_mul_ps(s2, _mm_sub_ps(xy, wz));
+		__m128 r2 = _mm_mul_ps(s2, _mm_add_ps(xz, wy));
+		__m128 r3 = _mm_load_ps(&joints.positionX[j]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(transforms[j + 0].m[0], r0);
+		_mm_storeu_ps(transforms[j + 1].m[0], r1);
+		_mm_storeu_ps(transforms[j + 2].m[0], r2);
+		_mm_storeu_ps(transforms[j + 3].m[0], r3);
+
+		r0 = _mm_mul_ps(s2, _mm_add_ps(xy, wz));
+		r1 = _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+		r2 = _mm_mul_ps(s2, _mm_sub_ps(yz, wx));
+		r3 = _mm_load_ps(&joints.positionY[j]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(transforms[j + 0].m[1], r0);
+		_mm_storeu_ps(transforms[j + 1].m[1], r1);
+		_mm_storeu_ps(transforms[j + 2].m[1], r2);
+		_mm_storeu_ps(transforms[j + 3].m[1], r3);
+
+		r0 = _mm_mul_ps(s2, _mm_sub_ps(xz, wy));
+		r1 = _mm_mul_ps(s2, _mm_add_ps(yz, wx));
+		r2 = _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+		r3 = _mm_load_ps(&joints.positionZ[j]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(transforms[j + 0].m[2], r0);
+		_mm_storeu_ps(transforms[j + 1].m[2], r1);
+		_mm_storeu_ps(transforms[j + 2].m[2], r2);
+		_mm_storeu_ps(transforms[j + 3].m[2], r3);
+
+		_mm_storeu_ps(transforms[j + 0].m[3], lastRow);
+		_mm_storeu_ps(transforms[j + 1].m[3], lastRow);
+		_mm_storeu_ps(transforms[j + 2].m[3], lastRow);
+		_mm_storeu_ps(transforms[j + 3].m[3], lastRow);
+	}
+}
+#else
+void HandTracking::BuildTransforms(const Joints& joints, InstanceTransform* transforms)
+{
+	BuildTransformsScalar(joints, transforms);
+}
+#endif
+
+// A minute of a hand opening and closing, for when there's no capture to
+// take joints from. Each finger is a chain of joints that curls a little
+// more at each knuckle, and the fingertips now and then go untracked.
+void HandTrackingGenerateFrames(std::vector<FrameCapture::CapturedHand>& frames)
+{
+	const uint32_t frameCount = 90 * 60;
+	const XrSpaceLocationFlags tracked = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT
+		| XR_SPACE_LOCATION_POSITION_TRACKED_BIT | XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT;
+
+	frames.resize(frameCount * 2);
+	for (uint32_t f = 0; f < frameCount; f++)
+	{
+		float t = f / 90.0f;
+		for (uint32_t hand = 0; hand < 2; hand++)
+		{
+			FrameCapture::CapturedHand& captured = frames[f * 2 + hand];
+			float side = hand == 0 ? -1.0f : 1.0f;
+			float curl = 0.5f + 0.5f * sinf(2.0f * t + hand);
+			XrVector3f wrist = { side * 0.2f + 0.05f * sinf(0.7f * t), 1.2f + 0.05f * sinf(0.9f * t), -0.3f };
+			captured.isActive = sinf(0.3f * t + hand) > -0.9f;
+			for (uint32_t j = 0; j < jointCount; j++)
+			{
+				// Palm and wrist first, then five fingers of four or five joints
+				uint32_t finger = j < 2 ? 0 : (j - 2) / 5;
+				uint32_t knuckle = j < 2 ? 0 : (j - 2) % 5;
+				float bend = curl * 0.4f * knuckle;
+				XrHandJointLocationEXT& joint = captured.joints[j];
+				joint.pose.orientation = { sinf(bend * 0.5f), 0.0f, 0.0f, cosf(bend * 0.5f) };
+				joint.pose.position = {
+					wrist.x + side * (finger * 0.02f - 0.04f),
+					wrist.y - sinf(bend) * 0.02f * knuckle,
+					wrist.z - cosf(bend) * 0.025f * knuckle };
+				joint.radius = 0.01f - 0.001f * knuckle;
+				joint.locationFlags = knuckle == 4 && sinf(5.0f * t + finger) > 0.95f ? 0 : tracked;
+			}
+		}
+	}
+}
+
+void HandTracking::RunBenchmark(const char* capturePath)
+{
+	const uint32_t minFrames = 200000;
+	const uint64_t targetNanoseconds = 20000;
+
+	// Every frame of the capture, whether the hands were tracked or not, since
+	// the live frame loop stores both hands every frame either way
+	std::vector<FrameCapture::CapturedHand> frames;
+	const char* source = "generated joints";
+	bool anyActive = false;
+	if (capturePath != nullptr && FrameCapture::OpenReplay(capturePath))
+	{
+		for (uint64_t i = 0; i < FrameCapture::GetReplayFrameCount(); i++)
+		{
+			const FrameCapture::CapturedFrame& frame = FrameCapture::GetReplayFrame(i);
+			for (uint32_t hand = 0; hand < 2; hand++)
+			{
+				frames.push_back(frame.hands[hand]);
+				anyActive = anyActive || frame.hands[hand].isActive;
+			}
+		}
+		FrameCapture::CloseReplay();
+		source = capturePath;
+	}
+	if (!anyActive)
+	{
+		if (capturePath != nullptr)
+			LOG(WARNING) << "No tracked hands in " << capturePath << ", using generated joints instead";
+		frames.clear();
+		HandTrackingGenerateFrames(frames);
+		source = "generated joints";
+	}
+
+	uint32_t frameCount = (uint32_t)frames.size() / 2;
+	uint32_t activeHands = 0;
+	for (const FrameCapture::CapturedHand& captured : frames)
+		activeHands += captured.isActive != 0;
+
+	// Both paths, over the frames as many times as it takes to reach
+	// minFrames. Each frame is timed on its own, and the target is held
+	// against the slowest frame in a thousand rather than the very slowest,
+	// which is mostly down to the thread being switched out.
+	Joints joints[2];
+	alignas(16) InstanceTransform transforms[2][2][paddedJointCount];
+	std::vector<uint64_t> frameNanoseconds[2];
+	frameNanoseconds[0].reserve(minFrames + frameCount);
+	frameNanoseconds[1].reserve(minFrames + frameCount);
+	uint32_t framesRun = 0;
+	float maxDifference = 0.0f;
+	for (uint32_t pass = 0; framesRun < minFrames; pass++)
+	{
+		for (uint32_t f = 0; f < frameCount; f++, framesRun++)
+		{
+			for (uint32_t path = 0; path < 2; path++)
+			{
+				uint64_t start = Platform::GetTimeNanoseconds();
+				for (uint32_t hand = 0; hand < 2; hand++)
+				{
+					const FrameCapture::CapturedHand& captured = frames[f * 2 + hand];
+					StoreJoints(captured.joints, captured.isActive != 0, joints[hand]);
+					if (!joints[hand].isActive)
+						continue;
+					if (path == 0)
+						BuildTransforms(joints[hand], transforms[path][hand]);
+					else
+						BuildTransformsScalar(joints[hand], transforms[path][hand]);
+				}
+				frameNanoseconds[path].push_back(Platform::GetTimeNanoseconds() - start);
+			}
+
+			// Only the first pass needs checking, the rest are the same frames
+			if (pass > 0)
+				continue;
+			for (uint32_t hand = 0; hand < 2; hand++)
+			{
+				if (!joints[hand].isActive)
+					continue;
+				const float* a = &transforms[0][hand][0].m[0][0];
+				const float* b = &transforms[1][hand][0].m[0][0];
+				for (uint32_t i = 0; i < jointCount * 16; i++)
+					maxDifference = std::max(maxDifference, fabsf(a[i] - b[i]));
+			}
+		}
+	}
+
+	const char* names[2] = { "BuildTransforms", "BuildTransformsScalar" };
+	for (uint32_t path = 0; path < 2; path++)
+	{
+		std::vector<uint64_t>& samples = frameNanoseconds[path];
+		uint64_t total = 0;
+		for (uint64_t sample : samples)
+			total += sample;
+		std::sort(samples.begin(), samples.end());
+		double mean = (double)total / samples.size();
+		uint64_t median = samples[samples.size() / 2];
+		uint64_t slowest = samples[samples.size() - 1 - samples.size() / 1000];
+		LOG(INFO) << "Hand joints from " << source << ", StoreJoints and " << names[path] << " for both hands: " << mean / 1000.0
+			<< "us a frame on average, " << median / 1000.0 << "us median, " << slowest / 1000.0 << "us at the 99.9th percentile, "
+			<< samples.back() / 1000.0 << "us at worst, against " << targetNanoseconds / 1000 << "us ("
+			<< (slowest <= targetNanoseconds ? "within" : "OVER") << " target)";
+	}
+	LOG(INFO) << "Hand joints: " << frameCount << " frames, " << activeHands << " of " << frameCount * 2 << " hands tracked, "
+		<< framesRun << " frames run, the two paths differ by at most " << maxDifference;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "TutorialStructs.h"
+
+// Articulated hands through XR_EXT_hand_tracking: 26 joints per hand, from
+// the wrist to each fingertip. When the runtime or the headset can't track
+// hands, everything here quietly does nothing.
+//
+// Joints are stored by field rather than by joint (all the x positions, then
+// all the y positions, and so on), padded out to a multiple of four, so
+// BuildTransforms can turn four joints into four instance transforms at a
+// time with SSE.
+namespace HandTracking
+{
+	const uint32_t jointCount = XR_HAND_JOINT_COUNT_EXT;
+	const uint32_t paddedJointCount = (jointCount + 3) & ~3u;
+
+	struct Joints
+	{
+		alignas(16) float	positionX[paddedJointCount];
+		alignas(16) float	positionY[paddedJointCount];
+		alignas(16) float	positionZ[paddedJointCount];
+		alignas(16) float	orientationX[paddedJointCount];
+		alignas(16) float	orientationY[paddedJointCount];
+		alignas(16) float	orientationZ[paddedJointCount];
+		alignas(16) float	orientationW[paddedJointCount];
+		alignas(16) float	radius[paddedJointCount];
+		uint32_t			validMask;		// Bit per joint, position and orientation both valid
+		bool				isActive;
+	};
+
+	// Init loads the extension functions and checks the system can track
+	// hands. CreateTrackers needs the session.
+	bool		Init(XrInstance instance, XrSystemId systemId);
+	bool		CreateTrackers(XrSession session);
+	void		Shutdown();
+	bool		IsAvailable();
+
+	// Locates both hands' joints, and builds their transforms
+	void		Locate(XrSpace baseSpace, XrTime time);
+
+	const Joints&				GetJoints(uint32_t hand);
+	const InstanceTransform*	GetTransforms(uint32_t hand);
+
+	// The joints as the runtime last gave them, which frame captures record.
+	// SetJoints stands in for Locate when replaying a capture.
+	const XrHandJointLocationEXT*	GetLocations(uint32_t hand);
+	void						SetJoints(uint32_t hand, const XrHandJointLocationEXT* locations, bool isActive);
+
+	// A cube per joint, sized by the joint's radius. Joints that weren't
+	// located get a zero scale. transforms needs room for paddedJointCount.
+	void		BuildTransforms(const Joints& joints, InstanceTransform* transforms);
+	void		BuildTransformsScalar(const Joints& joints, InstanceTransform* transforms);
+
+	// Fills the joint columns from the runtime's layout
+	void		StoreJoints(const XrHandJointLocationEXT* locations, bool isActive, Joints& joints);
+
+	// Times StoreJoints and BuildTransforms for both hands a frame, with SSE
+	// and without, against the 20us a frame they have. The joints come from
+	// the frame capture at capturePath, or are generated if that's null or
+	// the capture has no hands in it. Logs the results.
+	void		RunBenchmark(const char* capturePath);
+}
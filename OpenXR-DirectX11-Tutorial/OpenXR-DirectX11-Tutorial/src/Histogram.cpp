@@ -0,0 +1,117 @@
+#include "Histogram.h"
+#include "Platform.h"
+
+#include "easylogging++.h"
+
+#include <string.h>
+
+using namespace Histogram;
+
+uint32_t HistogramBucket(int64_t value)
+{
+	if (value < (int64_t)linearBuckets)
+		return value < 0 ? 0 : (uint32_t)value;
+
+	// The top bit picks the power of two, and the next few bits below it pick
+	// the bucket inside that
+	uint32_t exponent = 63;
+	while ((value >> exponent) == 0)
+		exponent--;
+	uint32_t subBucket = (uint32_t)(value >> (exponent - subBucketBits)) & ((1 << subBucketBits) - 1);
+	return linearBuckets + (exponent - (subBucketBits + 1)) * (1 << subBucketBits) + subBucket;
+}
+
+int64_t HistogramBucketStart(uint32_t bucket)
+{
+	if (bucket < linearBuckets)
+		return bucket;
+	uint32_t exponent = (bucket - linearBuckets) / (1 << subBucketBits) + subBucketBits + 1;
+	uint32_t subBucket = (bucket - linearBuckets) % (1 << subBucketBits);
+	return ((int64_t)1 << exponent) + ((int64_t)subBucket << (exponent - subBucketBits));
+}
+
+void Histogram::Add(Distribution& distribution, int64_t value)
+{
+	if (value < 0)
+		value = 0;
+	distribution.buckets[HistogramBucket(value)]++;
+	if (distribution.count == 0 || value < distribution.min)
+		distribution.min = value;
+	if (distribution.count == 0 || value > distribution.max)
+		distribution.max = value;
+	distribution.count++;
+	distribution.total += value;
+}
+
+void Histogram::Reset(Distribution& distribution)
+{
+	memset(&distribution, 0, sizeof(distribution));
+}
+
+void Histogram::Merge(Distribution& into, const Distribution& from)
+{
+	if (from.count == 0)
+		return;
+	for (uint32_t i = 0; i < bucketCount; i++)
+		into.buckets[i] += from.buckets[i];
+	if (into.count == 0 || from.min < into.min)
+		into.min = from.min;
+	if (into.count == 0 || from.max > into.max)
+		into.max = from.max;
+	into.count += from.count;
+	into.total += from.total;
+}
+
+int64_t Histogram::GetPercentile(const Distribution& distribution, double fraction)
+{
+	if (distribution.count == 0)
+		return 0;
+
+	uint64_t target = (uint64_t)(fraction * distribution.count);
+	if (target >= distribution.count)
+		target = distribution.count - 1;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < bucketCount; i++)
+	{
+		seen += distribution.buckets[i];
+		if (seen > target)
+		{
+			// The middle of the bucket, but never outside what was actually seen
+			int64_t value = HistogramBucketStart(i);
+			if (i + 1 < bucketCount)
+				value += (HistogramBucketStart(i + 1) - value) / 2;
+			return value < distribution.min ? distribution.min : value > distribution.max ? distribution.max : value;
+		}
+	}
+	return distribution.max;
+}
+
+void Histogram::Log(const Distribution& distribution, const char* name, double scale, const char* unit)
+{
+	if (distribution.count == 0)
+	{
+		LOG(INFO) << "  " << name << ": no samples";
+		return;
+	}
+
+	LOG(INFO) << "  " << name << ": " << distribution.count << " samples, mean "
+		<< distribution.total / (double)distribution.count / scale << unit
+		<< ", min " << distribution.min / scale << unit
+		<< ", p50 " << GetPercentile(distribution, 0.50) / scale << unit
+		<< ", p90 " << GetPercentile(distribution, 0.90) / scale << unit
+		<< ", p99 " << GetPercentile(distribution, 0.99) / scale << unit
+		<< ", p99.9 " << GetPercentile(distribution, 0.999) / scale << unit
+		<< ", max " << distribution.max / scale << unit;
+}
+
+int64_t Histogram::MeasureClockOverhead()
+{
+	Distribution overhead = {};
+	for (uint32_t i = 0; i < 100000; i++)
+	{
+		uint64_t start = Platform::GetTimeNanoseconds();
+		Add(overhead, (int64_t)(Platform::GetTimeNanoseconds() - start));
+	}
+	return GetPercentile(overhead, 0.5);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// A fixed size histogram for things like latencies, where we care about the
+// tail as much as the average. Values below 16 get a bucket each, and above
+// that every power of two is split into 8 buckets, so any value lands in a
+// bucket within 12.5% of it. Adding a value is a couple of instructions and
+// never allocates.
+namespace Histogram
+{
+	const uint32_t subBucketBits = 3;
+	const uint32_t linearBuckets = 2 << subBucketBits;
+	const uint32_t bucketCount = linearBuckets + (63 - (subBucketBits + 1)) * (1 << subBucketBits);
+
+	// Zero initialized is empty
+	struct Distribution
+	{
+		uint64_t	buckets[bucketCount];
+		uint64_t	count;
+		int64_t		total;
+		int64_t		min;
+		int64_t		max;
+	};
+
+	// Negative values count as zero
+	void		Add(Distribution& distribution, int64_t value);
+	void		Reset(Distribution& distribution);
+	// Adds everything in from to into, such as one distribution per thread
+	void		Merge(Distribution& into, const Distribution& from);
+
+	// The middle of the bucket the fraction falls in, e.g. 0.99 for the 99th
+	// percentile
+	int64_t		GetPercentile(const Distribution& distribution, double fraction);
+
+	// One line: count, mean, min, median, 90th, 99th, 99.9th and max. Values
+	// are divided by scale first, so nanoseconds can be shown as milliseconds.
+	void		Log(const Distribution& distribution, const char* name, double scale, const char* unit);
+
+	// The median time it takes to read Platform::GetTimeNanoseconds twice in a
+	// row. Benchmarks that time every call on its own log it alongside their
+	// results, since it's part of every sample.
+	int64_t		MeasureClockOverhead();
+}
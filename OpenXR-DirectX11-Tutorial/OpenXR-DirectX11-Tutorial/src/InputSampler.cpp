@@ -0,0 +1,142 @@
+#include "InputSampler.h"
+#include "OpenXR.h"
+#include "FrameTelemetry.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Must be a power of two. Select events are rare, so this only fills up if
+// the frame loop stops draining it.
+constexpr uint32_t inputSamplerQueueSize = 256;
+
+// A single producer, single consumer ring. The sampler owns the write
+// position and the frame loop owns the read position, so each side only ever
+// stores to its own.
+InputSampler::SelectEvent	inputSamplerQueue[inputSamplerQueueSize];
+std::atomic<uint64_t>		inputSamplerWritePos = { 0 };
+std::atomic<uint64_t>		inputSamplerReadPos = { 0 };
+std::atomic<uint64_t>		inputSamplerDropped = { 0 };
+
+std::thread					inputSamplerThread;
+std::atomic<bool>			inputSamplerRunning = { false };
+std::atomic<bool>			inputSamplerFocused = { false };
+uint32_t					inputSamplerRate = 0;
+FrameTelemetry::CounterID	inputSamplerSampleCounter = -1;
+
+// Latency stats, only touched by the frame loop
+uint64_t					inputSamplerConsumed = 0;
+uint64_t					inputSamplerQueueTotal = 0;
+uint64_t					inputSamplerQueueMax = 0;
+int64_t						inputSamplerAgeTotal = 0;
+int64_t						inputSamplerAgeMax = 0;
+
+bool InputSampler::Start(uint32_t rateHz)
+{
+	if (inputSamplerRunning || rateHz == 0)
+		return false;
+
+	inputSamplerRate = rateHz;
+	inputSamplerSampleCounter = FrameTelemetry::RegisterCounter("Input samples");
+	inputSamplerRunning = true;
+	inputSamplerThread = std::thread([]()
+	{
+		Platform::SetCurrentThreadName("Input Sampler");
+		Platform::SetCurrentThreadPriority(ThreadPriority::High);
+		PROFILE_THREAD_NAME("Input Sampler");
+
+		// Ticks are on a fixed schedule, rather than a fixed sleep after each
+		// sample, so the rate doesn't drift with how long sampling takes. If we
+		// fall behind we skip ahead instead of sampling in a burst.
+		uint64_t period = 1000000000ull / inputSamplerRate;
+		uint64_t nextTick = Platform::GetTimeNanoseconds();
+		while (inputSamplerRunning)
+		{
+			if (inputSamplerFocused.load(std::memory_order_relaxed))
+			{
+				OpenXR::SampleInput();
+				FrameTelemetry::Add(inputSamplerSampleCounter);
+			}
+
+			nextTick += period;
+			uint64_t now = Platform::GetTimeNanoseconds();
+			if (nextTick < now)
+				nextTick = now;
+			Platform::SleepUntilNanoseconds(nextTick);
+		}
+	});
+
+	LOG(INFO) << "Sampling input at " << rateHz << "Hz";
+	return true;
+}
+
+void InputSampler::Stop()
+{
+	if (!inputSamplerRunning)
+		return;
+	inputSamplerRunning = false;
+	inputSamplerThread.join();
+}
+
+bool InputSampler::IsRunning()
+{
+	return inputSamplerRunning.load(std::memory_order_relaxed);
+}
+
+void InputSampler::SetFocused(bool focused)
+{
+	inputSamplerFocused = focused;
+}
+
+void InputSampler::PublishEvent(const SelectEvent& event)
+{
+	uint64_t writePos = inputSamplerWritePos.load(std::memory_order_relaxed);
+	if (writePos - inputSamplerReadPos.load(std::memory_order_acquire) >= inputSamplerQueueSize)
+	{
+		inputSamplerDropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	inputSamplerQueue[writePos & (inputSamplerQueueSize - 1)] = event;
+	inputSamplerWritePos.store(writePos + 1, std::memory_order_release);
+}
+
+bool InputSampler::TakeEvent(SelectEvent& event)
+{
+	uint64_t readPos = inputSamplerReadPos.load(std::memory_order_relaxed);
+	if (readPos == inputSamplerWritePos.load(std::memory_order_acquire))
+		return false;
+	event = inputSamplerQueue[readPos & (inputSamplerQueueSize - 1)];
+	inputSamplerReadPos.store(readPos + 1, std::memory_order_release);
+	return true;
+}
+
+void InputSampler::RecordConsumed(const SelectEvent& event, XrTime consumedAt)
+{
+	uint64_t queued = Platform::GetTimeNanoseconds() - event.sampledAt;
+	int64_t age = consumedAt - event.time;
+
+	inputSamplerConsumed++;
+	inputSamplerQueueTotal += queued;
+	inputSamplerQueueMax = std::max(inputSamplerQueueMax, queued);
+	inputSamplerAgeTotal += age;
+	inputSamplerAgeMax = std::max(inputSamplerAgeMax, age);
+}
+
+void InputSampler::LogSummary()
+{
+	if (inputSamplerRate == 0)
+		return;
+
+	LOG(INFO) << "Input sampler at " << inputSamplerRate << "Hz, " << FrameTelemetry::GetTotal(inputSamplerSampleCounter) << " samples, "
+		<< inputSamplerConsumed << " select events, " << inputSamplerDropped.load() << " dropped";
+	if (inputSamplerConsumed == 0)
+		return;
+	LOG(INFO) << "  Sampler to frame loop: " << inputSamplerQueueTotal / inputSamplerConsumed / 1000000.0 << "ms average, "
+		<< inputSamplerQueueMax / 1000000.0 << "ms max";
+	LOG(INFO) << "  Press to frame loop: " << inputSamplerAgeTotal / (int64_t)inputSamplerConsumed / 1000000.0 << "ms average, "
+		<< inputSamplerAgeMax / 1000000.0 << "ms max";
+}
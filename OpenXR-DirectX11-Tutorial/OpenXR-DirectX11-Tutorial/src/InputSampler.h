@@ -0,0 +1,45 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+
+// Samples input on its own thread, at a higher rate than the frame loop.
+// Without it, input is read once a frame in PollActions, so a quick tap or a
+// fast flick of the hand gets rounded to the frame rate.
+//
+// Each tick the thread calls OpenXR::SampleInput, which syncs actions, polls
+// and publishes the ActionStateTable, pushes the hand poses into the pose
+// history, and publishes select events here. PollActions then drains the
+// events and acquires the table instead of syncing actions itself.
+// The queue between them is single producer, single consumer and lock free.
+namespace InputSampler
+{
+	struct SelectEvent
+	{
+		uint32_t	hand;
+		XrTime		time;			// When the runtime says the button changed
+		XrPosef		pose;			// The hand, at that time
+		uint32_t	picked;			// What the hand pointed at then, from Application::Pick
+		uint64_t	sampledAt;		// Platform time the sampler picked it up
+	};
+
+	bool		Start(uint32_t rateHz);
+	void		Stop();
+	bool		IsRunning();
+
+	// Actions only sync while the session is focused. PollEvents keeps this
+	// up to date, since the session state isn't safe to read from here.
+	void		SetFocused(bool focused);
+
+	// Sampler thread side
+	void		PublishEvent(const SelectEvent& event);
+
+	// Frame loop side. TakeEvent returns false once the queue is empty.
+	bool		TakeEvent(SelectEvent& event);
+
+	// How long events sat between the sampler and the frame loop, and how old
+	// they were (from the runtime's timestamp) when the frame loop got them.
+	void		RecordConsumed(const SelectEvent& event, XrTime consumedAt);
+	void		LogSummary();
+}
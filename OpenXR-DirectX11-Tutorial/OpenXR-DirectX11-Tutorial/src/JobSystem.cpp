@@ -0,0 +1,430 @@
+#include "JobSystem.h"
+#include "AllocationTracker.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+// Each thread's queue is a Chase-Lev deque. The owner pushes and pops at the
+// bottom without any locking, and only has to compare and swap when it's
+// down to the last job. Thieves take from the top, and race each other and
+// the owner with a compare and swap on top.
+struct JobQueue
+{
+	alignas(64) std::atomic<int64_t>	top;
+	alignas(64) std::atomic<int64_t>	bottom;
+	std::atomic<JobSystem::Job*>		jobs[JobSystem::jobsPerThread];
+	uint32_t							nextJob;		// Next slot in this thread's ring
+};
+
+const uint64_t jobCountOne = 1ull << 32;
+const uint32_t jobQueueMask = JobSystem::jobsPerThread - 1;
+static_assert((JobSystem::jobsPerThread & jobQueueMask) == 0, "jobsPerThread must be a power of two");
+
+// How many times an idle thread looks for work before it goes to sleep. Jobs
+// arrive in bursts during the frame, and waking a thread costs far more than
+// spinning for a little while.
+const uint32_t jobSpinCount = 64;
+const uint32_t jobYieldCount = 256;
+
+JobQueue jobQueues[JobSystem::maxThreads];
+JobSystem::Job jobPool[JobSystem::maxThreads * JobSystem::jobsPerThread];
+std::vector<std::thread> jobThreads;
+uint32_t jobThreadCount = 1;
+std::atomic<bool> jobRunning = { false };
+
+std::mutex jobSleepLock;
+std::condition_variable jobWake;
+std::atomic<uint32_t> jobSleepers = { 0 };
+
+// Which queue belongs to the calling thread, or -1 if it isn't in the pool
+thread_local int32_t jobThreadIndex = -1;
+
+void JobPause()
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+bool JobPush(JobQueue& queue, JobSystem::Job* job)
+{
+	int64_t bottom = queue.bottom.load(std::memory_order_relaxed);
+	int64_t top = queue.top.load(std::memory_order_acquire);
+	if (bottom - top >= (int64_t)JobSystem::jobsPerThread)
+		return false;
+
+	queue.jobs[bottom & jobQueueMask].store(job, std::memory_order_relaxed);
+	queue.bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+JobSystem::Job* JobPop(JobQueue& queue)
+{
+	int64_t bottom = queue.bottom.load(std::memory_order_relaxed) - 1;
+	queue.bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = queue.top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		queue.bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	// The last job could be getting stolen at the same time
+	JobSystem::Job* job = queue.jobs[bottom & jobQueueMask].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		if (!queue.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		queue.bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSteal(JobQueue& queue)
+{
+	int64_t top = queue.top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = queue.bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return nullptr;
+
+	JobSystem::Job* job = queue.jobs[top & jobQueueMask].load(std::memory_order_relaxed);
+	if (!queue.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+// Our own newest job first, then the oldest job of each of the other threads,
+// starting with the next one along so thieves spread out
+JobSystem::Job* JobFind(int32_t threadIndex)
+{
+	JobSystem::Job* job = JobPop(jobQueues[threadIndex]);
+	for (uint32_t i = 1; job == nullptr && i < jobThreadCount; i++)
+		job = JobSteal(jobQueues[(threadIndex + i) % jobThreadCount]);
+	return job;
+}
+
+bool JobAnyQueued()
+{
+	for (uint32_t i = 0; i < jobThreadCount; i++)
+	{
+		if (jobQueues[i].top.load(std::memory_order_relaxed) < jobQueues[i].bottom.load(std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+void JobWakeSleepers()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (jobSleepers.load(std::memory_order_relaxed) > 0)
+	{
+		// Taking the lock means a thread that's about to sleep has either
+		// seen the new job already, or is waiting and gets the notify
+		{ std::lock_guard<std::mutex> lock(jobSleepLock); }
+		jobWake.notify_one();
+	}
+}
+
+void JobExecute(JobSystem::Job* job);
+
+// Queues a job that's ready to go on this thread's queue, or runs it now if
+// the queue is full
+void JobSchedule(JobSystem::Job* job)
+{
+	if (JobPush(jobQueues[jobThreadIndex], job))
+		JobWakeSleepers();
+	else
+		JobExecute(job);
+}
+
+// Counts a job off, and if it was the last one, zeroes the count and takes
+// the continuations in the same step
+void JobFinish(JobSystem::Counter& counter)
+{
+	uint64_t state = counter.state.load(std::memory_order_relaxed);
+	uint64_t finished;
+	do
+	{
+		finished = state - jobCountOne;
+		if ((finished >> 32) == 0)
+			finished = 0;
+	} while (!counter.state.compare_exchange_weak(state, finished, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	if (finished != 0)
+		return;
+
+	uint32_t next = (uint32_t)state;
+	while (next != 0)
+	{
+		JobSystem::Job* continuation = &jobPool[next - 1];
+		next = continuation->next;
+		JobSchedule(continuation);
+	}
+}
+
+void JobExecute(JobSystem::Job* job)
+{
+	// The slot is free as soon as the function has run, the counter is all
+	// that's left to deal with
+	JobSystem::Counter* counter = job->counter;
+	job->function.load(std::memory_order_relaxed)(job);
+	job->function.store(nullptr, std::memory_order_release);
+	if (counter != nullptr)
+		JobFinish(*counter);
+}
+
+void JobWorker(int32_t threadIndex)
+{
+	jobThreadIndex = threadIndex;
+	Platform::SetCurrentThreadName("Job Worker");
+	PROFILE_THREAD_NAME("Job Worker");
+	AllocationTracker::TrackCurrentThread();
+
+	uint32_t idle = 0;
+	while (jobRunning.load(std::memory_order_relaxed))
+	{
+		JobSystem::Job* job = JobFind(threadIndex);
+		if (job != nullptr)
+		{
+			JobExecute(job);
+			idle = 0;
+			continue;
+		}
+
+		idle++;
+		if (idle < jobSpinCount)
+		{
+			JobPause();
+		}
+		else if (idle < jobYieldCount)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			// Check once more after saying we're asleep, so a job pushed in
+			// between can't be missed. The timeout is only a backstop.
+			std::unique_lock<std::mutex> lock(jobSleepLock);
+			jobSleepers.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!JobAnyQueued() && jobRunning.load(std::memory_order_relaxed))
+				jobWake.wait_for(lock, std::chrono::milliseconds(2));
+			jobSleepers.fetch_sub(1, std::memory_order_relaxed);
+			idle = jobSpinCount;
+		}
+	}
+	jobThreadIndex = -1;
+}
+
+bool JobSystem::Start(uint32_t threadCount)
+{
+	if (jobRunning.load())
+		return false;
+
+	jobThreadCount = std::min(std::max(threadCount, 1u), maxThreads);
+	for (uint32_t i = 0; i < jobThreadCount; i++)
+	{
+		jobQueues[i].top.store(0);
+		jobQueues[i].bottom.store(0);
+		jobQueues[i].nextJob = 0;
+	}
+
+	jobThreadIndex = 0;
+	jobRunning.store(true);
+	for (uint32_t i = 1; i < jobThreadCount; i++)
+		jobThreads.emplace_back(JobWorker, (int32_t)i);
+	return true;
+}
+
+void JobSystem::Stop()
+{
+	if (!jobRunning.load())
+		return;
+
+	// Anything still queued on this thread gets run, the workers just stop
+	while (Job* job = JobPop(jobQueues[0]))
+		JobExecute(job);
+
+	jobRunning.store(false);
+	{
+		std::lock_guard<std::mutex> lock(jobSleepLock);
+		jobWake.notify_all();
+	}
+	for (std::thread& thread : jobThreads)
+		thread.join();
+	jobThreads.clear();
+	jobThreadCount = 1;
+	jobThreadIndex = -1;
+}
+
+uint32_t JobSystem::GetThreadCount()
+{
+	return jobThreadCount;
+}
+
+bool JobSystem::IsWorkerThread()
+{
+	return jobThreadIndex >= 0;
+}
+
+JobSystem::Job* JobSystem::Allocate()
+{
+	if (jobThreadIndex < 0)
+		return nullptr;
+
+	// Slots are handed out in order, so if this one is still busy, the
+	// thread has a whole ring of jobs in flight
+	JobQueue& queue = jobQueues[jobThreadIndex];
+	Job* job = &jobPool[jobThreadIndex * jobsPerThread + (queue.nextJob & jobQueueMask)];
+	if (job->function.load(std::memory_order_acquire) != nullptr)
+		return nullptr;
+	queue.nextJob++;
+
+	job->counter = nullptr;
+	job->next = 0;
+	return job;
+}
+
+void JobSystem::Submit(Job* job, Counter* counter)
+{
+	job->counter = counter;
+	if (counter != nullptr)
+		counter->state.fetch_add(jobCountOne, std::memory_order_relaxed);
+	JobSchedule(job);
+}
+
+void JobSystem::SubmitAfter(Counter& dependency, Job* job, Counter* counter)
+{
+	job->counter = counter;
+	if (counter != nullptr)
+		counter->state.fetch_add(jobCountOne, std::memory_order_relaxed);
+
+	// Push it on the dependency's list, unless that's already finished
+	uint32_t index = (uint32_t)(job - jobPool) + 1;
+	uint64_t state = dependency.state.load(std::memory_order_acquire);
+	do
+	{
+		if ((state >> 32) == 0)
+		{
+			JobSchedule(job);
+			return;
+		}
+		job->next = (uint32_t)state;
+	} while (!dependency.state.compare_exchange_weak(state, (state & ~0xFFFFFFFFull) | index, std::memory_order_acq_rel, std::memory_order_acquire));
+}
+
+bool JobSystem::IsDone(const Counter& counter)
+{
+	return (counter.state.load(std::memory_order_acquire) >> 32) == 0;
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	// Threads outside the pool can't help, they can only wait
+	if (jobThreadIndex < 0)
+	{
+		while (!IsDone(counter))
+			std::this_thread::yield();
+		return;
+	}
+
+	PROFILE_ZONE("JobSystem::Wait");
+	uint32_t idle = 0;
+	while (!IsDone(counter))
+	{
+		Job* job = JobFind(jobThreadIndex);
+		if (job != nullptr)
+		{
+			JobExecute(job);
+			idle = 0;
+		}
+		else if (++idle < jobSpinCount)
+		{
+			JobPause();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+// Something like the math in building transforms, with nothing shared
+// between elements
+void JobBenchmarkWork(float* values, uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		float x = values[i];
+		for (uint32_t j = 0; j < 4; j++)
+			x = sqrtf(x * x + 1.0f) * 0.5f + sinf(x) * 0.25f;
+		values[i] = x;
+	}
+}
+
+void JobSystem::RunBenchmark(uint32_t maxThreadCount)
+{
+	const uint32_t elementCount = 1 << 20;
+	const uint32_t grain = 4096;
+	const uint32_t emptyJobBatch = 256;
+	const uint32_t emptyJobBatches = 400;
+	const uint32_t repeats = 5;
+
+	std::vector<float> values(elementCount);
+	maxThreadCount = std::min(std::max(maxThreadCount, 1u), maxThreads);
+	double singleThreadMilliseconds = 0.0;
+	for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+	{
+		Start(threadCount);
+
+		// Best of a few runs, the first one also warms the threads up
+		double parallelMilliseconds = 1e30;
+		for (uint32_t r = 0; r < repeats; r++)
+		{
+			for (uint32_t i = 0; i < elementCount; i++)
+				values[i] = (float)i * 0.001f;
+
+			uint64_t start = Platform::GetTimeNanoseconds();
+			float* data = values.data();
+			ParallelFor(elementCount, grain, [data](uint32_t begin, uint32_t end) { JobBenchmarkWork(data, begin, end); });
+			parallelMilliseconds = std::min(parallelMilliseconds, (Platform::GetTimeNanoseconds() - start) / 1000000.0);
+		}
+		if (threadCount == 1)
+			singleThreadMilliseconds = parallelMilliseconds;
+
+		// Jobs that do nothing, so all that's measured is handing them out,
+		// running them and waiting for them
+		uint64_t start = Platform::GetTimeNanoseconds();
+		for (uint32_t b = 0; b < emptyJobBatches; b++)
+		{
+			Counter counter;
+			for (uint32_t i = 0; i < emptyJobBatch; i++)
+				Run([]() {}, &counter);
+			Wait(counter);
+		}
+		double nanosecondsPerJob = (double)(Platform::GetTimeNanoseconds() - start) / (emptyJobBatch * emptyJobBatches);
+
+		Stop();
+
+		LOG(INFO) << "Job system with " << threadCount << " threads: " << parallelMilliseconds << "ms for "
+			<< elementCount << " elements (" << singleThreadMilliseconds / parallelMilliseconds << "x), "
+			<< nanosecondsPerJob << "ns per empty job";
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Splits the work of a frame across every core. Each thread in the pool,
+// including the one that called Start, has its own queue of jobs. A thread
+// runs the newest job on its own queue, so the work it just split up is
+// still in cache, and when its queue is empty it steals the oldest job off
+// someone else's, which tends to be the biggest piece left.
+//
+// Jobs are small lambdas that get copied into a fixed size slot, so handing
+// out work never allocates. Each thread has a ring of slots, and if all of
+// them are still waiting to run, the job just runs straight away instead.
+// The same happens on threads that aren't in the pool, or before Start, so
+// callers never need to check.
+//
+// A Counter tracks a group of jobs. Wait blocks until they've all finished,
+// running other jobs in the meantime, and RunAfter queues a job to start once
+// they have. Counters must stay alive until their jobs have finished.
+namespace JobSystem
+{
+	const uint32_t	maxThreads = 16;
+	const uint32_t	jobsPerThread = 1024;
+	const uint32_t	jobPayloadSize = 40;
+
+	struct Job;
+	typedef void (*JobFunction)(Job*);
+
+	// The number of unfinished jobs in the top half, and in the bottom half
+	// the jobs to start once that reaches zero, as an index into the pool
+	// plus one. Keeping both in one value means the last job to finish picks
+	// up the continuations and zeroes the count in a single step, and never
+	// touches the counter again, so a Wait can return and free it right away.
+	struct Counter
+	{
+		std::atomic<uint64_t>	state = { 0 };
+	};
+
+	struct alignas(64) Job
+	{
+		std::atomic<JobFunction>	function;		// Null once the slot is free again
+		Counter*					counter;
+		uint32_t					next;			// Next continuation on the same counter
+		alignas(8) unsigned char	payload[jobPayloadSize];
+	};
+
+	// threadCount includes the calling thread, which becomes part of the pool
+	// and runs jobs whenever it waits on them
+	bool		Start(uint32_t threadCount);
+	void		Stop();
+	uint32_t	GetThreadCount();
+	bool		IsWorkerThread();
+
+	// Returns null if the calling thread isn't in the pool, or its ring of
+	// slots is full
+	Job*		Allocate();
+	void		Submit(Job* job, Counter* counter);
+	void		SubmitAfter(Counter& dependency, Job* job, Counter* counter);
+
+	bool		IsDone(const Counter& counter);
+	void		Wait(Counter& counter);
+
+	// Runs scaling and scheduling overhead measurements with every thread
+	// count from 1 to maxThreadCount, and logs the results
+	void		RunBenchmark(uint32_t maxThreadCount);
+
+	template<typename Function>
+	void JobInvoke(Job* job)
+	{
+		Function* function = (Function*)job->payload;
+		(*function)();
+		function->~Function();
+	}
+
+	template<typename Function>
+	Job* MakeJob(Function&& work)
+	{
+		typedef typename std::decay<Function>::type Stored;
+		static_assert(sizeof(Stored) <= jobPayloadSize, "Job captures too much, capture a pointer to it instead");
+		static_assert(alignof(Stored) <= 8, "Job captures need at most 8 byte alignment");
+
+		Job* job = Allocate();
+		if (job == nullptr)
+			return nullptr;
+		new (job->payload) Stored(std::forward<Function>(work));
+		job->function.store(&JobInvoke<Stored>, std::memory_order_relaxed);
+		return job;
+	}
+
+	template<typename Function>
+	void Run(Function&& work, Counter* counter = nullptr)
+	{
+		Job* job = MakeJob(std::forward<Function>(work));
+		if (job == nullptr)
+		{
+			work();
+			return;
+		}
+		Submit(job, counter);
+	}
+
+	template<typename Function>
+	void RunAfter(Counter& dependency, Function&& work, Counter* counter = nullptr)
+	{
+		Job* job = MakeJob(std::forward<Function>(work));
+		if (job == nullptr)
+		{
+			Wait(dependency);
+			work();
+			return;
+		}
+		SubmitAfter(dependency, job, counter);
+	}
+
+	// Calls body(begin, end) over ranges that cover [0, count), in parallel,
+	// and returns once they're all done. Ranges are at least grain long, so
+	// set it to roughly how much work is worth a job.
+	template<typename Function>
+	void ParallelFor(uint32_t count, uint32_t grain, const Function& body)
+	{
+		// A few ranges per thread, so threads that finish early have
+		// something left to steal
+		uint32_t threadCount = GetThreadCount();
+		uint32_t rangeSize = (count + threadCount * 4 - 1) / (threadCount * 4);
+		if (rangeSize < grain)
+			rangeSize = grain;
+		if (threadCount <= 1 || rangeSize >= count || !IsWorkerThread())
+		{
+			if (count > 0)
+				body(0u, count);
+			return;
+		}
+
+		// The first range is kept for this thread, it would only be popped
+		// straight back off the queue otherwise
+		Counter counter;
+		for (uint32_t begin = rangeSize; begin < count; begin += rangeSize)
+		{
+			uint32_t end = count - begin > rangeSize ? begin + rangeSize : count;
+			const Function* bodyPointer = &body;
+			Run([bodyPointer, begin, end]() { (*bodyPointer)(begin, end); }, &counter);
+		}
+		body(0u, rangeSize);
+		Wait(counter);
+	}
+}
@@ -0,0 +1,83 @@
+#include "LatencyTracker.h"
+
+#include "easylogging++.h"
+
+#include <string.h>
+
+// A frame sees a few events and a few pose samples at most. If frames stop
+// being rendered for a long while, the oldest ones are dropped.
+constexpr uint32_t			latencyMaxPending = 64;
+
+XrTime						latencyPendingEvents[latencyMaxPending];
+uint32_t					latencyPendingEventCount = 0;
+XrTime						latencyPendingSamples[latencyMaxPending];
+uint32_t					latencyPendingSampleCount = 0;
+uint64_t					latencyDropped = 0;
+uint64_t					latencyFrames = 0;
+
+Histogram::Distribution		latencyEventToDisplay = {};
+Histogram::Distribution		latencySampleToDisplay = {};
+
+void LatencyPush(XrTime* pending, uint32_t& count, XrTime time)
+{
+	if (count == latencyMaxPending)
+	{
+		memmove(pending, pending + 1, sizeof(XrTime) * (latencyMaxPending - 1));
+		count--;
+		latencyDropped++;
+	}
+	pending[count++] = time;
+}
+
+void LatencyTracker::RecordEvent(XrTime eventTime)
+{
+	LatencyPush(latencyPendingEvents, latencyPendingEventCount, eventTime);
+}
+
+void LatencyTracker::RecordSample(XrTime sampledAt)
+{
+	LatencyPush(latencyPendingSamples, latencyPendingSampleCount, sampledAt);
+}
+
+void LatencyTracker::FrameEnded(XrTime displayTime, bool rendered)
+{
+	if (!rendered)
+		return;
+
+	for (uint32_t i = 0; i < latencyPendingEventCount; i++)
+		Histogram::Add(latencyEventToDisplay, displayTime - latencyPendingEvents[i]);
+	for (uint32_t i = 0; i < latencyPendingSampleCount; i++)
+		Histogram::Add(latencySampleToDisplay, displayTime - latencyPendingSamples[i]);
+	latencyPendingEventCount = 0;
+	latencyPendingSampleCount = 0;
+	latencyFrames++;
+}
+
+void LatencyTracker::EndSession()
+{
+	if (latencyFrames == 0)
+		return;
+
+	LOG(INFO) << "Motion to photon latency over " << latencyFrames << " rendered frames:";
+	Histogram::Log(latencyEventToDisplay, "Event to display", 1000000.0, "ms");
+	Histogram::Log(latencySampleToDisplay, "Sample to display", 1000000.0, "ms");
+	if (latencyDropped > 0)
+		LOG(INFO) << "  " << latencyDropped << " dropped while nothing was being rendered";
+
+	Histogram::Reset(latencyEventToDisplay);
+	Histogram::Reset(latencySampleToDisplay);
+	latencyPendingEventCount = 0;
+	latencyPendingSampleCount = 0;
+	latencyDropped = 0;
+	latencyFrames = 0;
+}
+
+const Histogram::Distribution& LatencyTracker::GetEventToDisplay()
+{
+	return latencyEventToDisplay;
+}
+
+const Histogram::Distribution& LatencyTracker::GetSampleToDisplay()
+{
+	return latencySampleToDisplay;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Histogram.h"
+
+#include "openxr/openxr.h"
+
+// Estimates motion-to-photon latency: how long it takes from something
+// happening to it being on the display. Input events and pose samples are
+// recorded as the frame loop uses them, then tied to the display time of the
+// next frame that gets rendered, which is the first one that can show them.
+//
+//   Event to display:  the runtime's timestamp for a button press, to the
+//                      display time of the frame that first reacts to it.
+//   Sample to display: when we located a pose we render with, to the display
+//                      time of that frame. This is how far ahead the runtime
+//                      had to predict.
+//
+// All of it lives on the frame loop thread. Both distributions cover the
+// current session, and EndSession logs them and starts over.
+namespace LatencyTracker
+{
+	void		RecordEvent(XrTime eventTime);
+	void		RecordSample(XrTime sampledAt);
+
+	// After xrEndFrame. Frames the runtime told us not to render don't display
+	// anything, so what's pending carries over to the next one that is.
+	void		FrameEnded(XrTime displayTime, bool rendered);
+
+	void		EndSession();
+
+	const Histogram::Distribution&	GetEventToDisplay();
+	const Histogram::Distribution&	GetSampleToDisplay();
+}
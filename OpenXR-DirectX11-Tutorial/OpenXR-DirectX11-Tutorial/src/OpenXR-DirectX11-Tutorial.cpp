@@ -1,46 +1,460 @@
-
-
-#include "D3DRenderer.h"
-#include "OpenXR.h"
-#include "Application.h"
-
-#include <thread>
-
-#include "easylogging++.h"
-INITIALIZE_EASYLOGGINGPP\
-
-int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) 
-{
-	if (!OpenXR::Init("OpenXR with DirectX 11", D3DRenderer::GetSwapchainFormat())) 
-	{
-		D3DRenderer::Shutdown();
-		LOG(ERROR) << "OpenXR initialization failed";
-		return -11;
-	}
-
-	OpenXR::MakeActions();
-	D3DRenderer::SetupResources();
-
-	bool quit = false;
-	while (!quit) 
-	{
-		OpenXR::PollEvents(quit);
-
-		if (OpenXR::IsRunning()) 
-		{
-			OpenXR::PollActions();
-			Application::Update();
-			OpenXR::RenderFrame();
-
-			auto sessionState = OpenXR::GetSessionState();
-			if (!OpenXR::IsValidSessionState())
-			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(250));
-			}
-		}
-	}
-
-	OpenXR::Shutdown();
-	D3DRenderer::Shutdown();
-	return 0;
-}
+#include "D3DRenderer.h"
+#include "OpenXR.h"
+#include "ActionManifest.h"
+#include "AllocationTracker.h"
+#include "Application.h"
+#include "AsyncLog.h"
+#include "BinaryLog.h"
+#include "DebugMessenger.h"
+#include "FrameArena.h"
+#include "FrameCapture.h"
+#include "FrameTelemetry.h"
+#include "HandTracking.h"
+#include "InputSampler.h"
+#include "JobSystem.h"
+#include "LatencyTracker.h"
+#include "Picking.h"
+#include "Platform.h"
+#include "PoseStream.h"
+#include "PredictionAnalyzer.h"
+#include "Profiler.h"
+#include "SceneBVH.h"
+#include "SceneFile.h"
+#include "StartupGraph.h"
+#include "StartupTrace.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "easylogging++.h"
+INITIALIZE_EASYLOGGINGPP\
+
+const char* startupTracePath = "startup_trace.json";
+const char* frameTracePath = "frame_trace.json";
+
+// Returns what follows prefix in the first argument that starts with it, so
+// FindArgument(argc, argv, "--record=") gives back the path.
+const char* FindArgument(int argc, char** argv, const char* prefix)
+{
+	size_t prefixLength = strlen(prefix);
+	for (int32_t i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], prefix, prefixLength) == 0)
+			return argv[i] + prefixLength;
+	}
+	return nullptr;
+}
+
+// With --fail-on-frame-allocations, a run where the frame loop allocated
+// after warming up fails, so replaying a capture can check for it
+int CheckFrameAllocations(int result, bool failOnAllocations)
+{
+	uint64_t failedFrames = AllocationTracker::GetFailedFrames();
+	if (failedFrames > 0)
+		LOG(ERROR) << failedFrames << " frames made heap allocations after warming up";
+	if (result == 0 && failOnAllocations && failedFrames > 0)
+		return -13;
+	return result;
+}
+
+// Describes startup as a set of tasks and what each one needs to wait for. Getting OpenXR
+// going is one long chain, but shader compilation, mesh buffers, actions and the swapchain
+// depth buffers can all happen alongside it, or alongside each other.
+void AddStartupTasks(const char* actionManifestPath, const char* scenePath)
+{
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	int64_t swapchainFormat = D3DRenderer::GetSwapchainFormat();
+#else
+	// Headless sessions don't create swapchains, so the format is never used
+	int64_t swapchainFormat = 0;
+#endif
+
+	StartupGraph::TaskID system = StartupGraph::Add("OpenXR::InitSystem", []() { return OpenXR::InitSystem("OpenXR with DirectX 11"); });
+	StartupGraph::TaskID session = StartupGraph::Add("OpenXR::InitSession", [swapchainFormat]() { return OpenXR::InitSession(swapchainFormat); }, { system });
+	StartupGraph::Add("OpenXR::CreateSwapchains", [swapchainFormat]() { return OpenXR::CreateSwapchains(swapchainFormat); }, { session });
+	StartupGraph::TaskID manifest = StartupGraph::Add("ActionManifest::Load", [actionManifestPath]() { return ActionManifest::Load(actionManifestPath); });
+	StartupGraph::Add("OpenXR::MakeActions", []() { return OpenXR::MakeActions(); }, { session, manifest });
+	StartupGraph::Add("Application::LoadScene", [scenePath]() { Application::LoadScene(scenePath); return true; });
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	StartupGraph::TaskID shaders = StartupGraph::Add("D3DRenderer::CompileShaders", []() { D3DRenderer::CompileShaders(); return true; });
+	StartupGraph::Add("D3DRenderer::CreateShaders", []() { return D3DRenderer::CreateShaders(); }, { shaders, system });
+	StartupGraph::Add("D3DRenderer::CreateMeshBuffers", []() { return D3DRenderer::CreateMeshBuffers(); }, { system });
+#endif
+}
+
+// Undoes as much of startup as got done, whether it all worked or not
+void ShutdownStartup()
+{
+	Application::CloseScene();
+	OpenXR::Shutdown();
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	D3DRenderer::Shutdown();
+#endif
+}
+
+// Most of startup is waiting on the runtime and the driver, so a few threads
+// is all it takes
+uint32_t GetStartupThreadCount()
+{
+	return std::min(std::max(std::thread::hardware_concurrency(), 1u), 4u);
+}
+
+// Starts up and shuts down over and over, timing startup up to the join with
+// every task on one thread, then with threadCount of them. It needs a runtime
+// to start against, on Linux Monado's headless XR_MND_headless will do.
+void RunStartupBenchmark(const char* actionManifestPath, uint32_t threadCount)
+{
+	const uint32_t rounds = 10;
+	const char* scenePath = "startup_benchmark.xrscene";
+	const uint32_t threadCounts[2] = { 1, threadCount };
+	uint64_t best[2] = { UINT64_MAX, UINT64_MAX };
+	uint64_t total[2] = { 0, 0 };
+
+	// The first round pays for loading the runtime and filling in the
+	// capability cache, which every start after it skips, so it isn't counted.
+	// The two thread counts take turns, so they see the same conditions.
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			AddStartupTasks(actionManifestPath, scenePath);
+			uint64_t start = Platform::GetTimeNanoseconds();
+			bool started = StartupGraph::Run(threadCounts[i]);
+			uint64_t elapsed = Platform::GetTimeNanoseconds() - start;
+			ShutdownStartup();
+			if (!started)
+			{
+				LOG(ERROR) << "Startup benchmark: startup failed, it needs an OpenXR runtime to start against";
+				remove(scenePath);
+				return;
+			}
+			if (round > 0)
+			{
+				best[i] = std::min(best[i], elapsed);
+				total[i] += elapsed;
+			}
+		}
+	}
+	remove(scenePath);
+
+	for (uint32_t i = 0; i < 2; i++)
+		LOG(INFO) << "Startup benchmark: " << threadCounts[i] << " threads, best " << best[i] / 1000000.0 << "ms, mean " << total[i] / rounds / 1000000.0 << "ms to the join";
+	LOG(INFO) << "Startup benchmark: " << threadCount << " threads start up " << (double)best[0] / best[1] << "x as fast as one";
+}
+
+// Runs whichever benchmarks were asked for, each of which times one part of
+// the app on generated data and logs the results. Returns false if there
+// weren't any, otherwise the app exits once they're done.
+//
+// --job-benchmark measures how the job system scales from one thread up to
+// jobThreadCount, and what each job costs.
+// --pick-benchmark times the SSE ray cast against the scalar one.
+// --bvh-benchmark times building, refitting, editing and querying the
+// scene BVH at up to a million cubes, with jobThreadCount threads.
+// --scene-benchmark times loading scene files of up to a million cubes.
+// --pose-benchmark round trips an hour of poses through a pose stream.
+// --log-benchmark floods the async log from several threads at once.
+// --blog-benchmark does the same to the binary log, in a scratch file.
+// --profiler-benchmark times profiler markers compiled out and compiled in.
+// --startup-benchmark times startup on one thread against several, with the
+// manifest from --action-manifest=<path>, and needs an OpenXR runtime.
+// --hand-benchmark times turning hand joints into transforms, with joints
+// from a frame capture if it's given as --hand-benchmark=<path>.
+bool RunBenchmarks(int argc, char** argv, uint32_t jobThreadCount)
+{
+	bool ran = false;
+	if (FindArgument(argc, argv, "--job-benchmark") != nullptr)
+	{
+		JobSystem::RunBenchmark(jobThreadCount);
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--pick-benchmark") != nullptr)
+	{
+		Picking::RunBenchmark();
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--bvh-benchmark") != nullptr)
+	{
+		SceneBVH::RunBenchmark(jobThreadCount);
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--scene-benchmark") != nullptr)
+	{
+		SceneFile::RunBenchmark();
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--pose-benchmark") != nullptr)
+	{
+		PoseStream::RunBenchmark();
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--log-benchmark") != nullptr)
+	{
+		AsyncLog::RunBenchmark(jobThreadCount);
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--blog-benchmark") != nullptr)
+	{
+		BinaryLog::RunBenchmark(jobThreadCount);
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--profiler-benchmark") != nullptr)
+	{
+		Profiler::RunBenchmark();
+		ran = true;
+	}
+	if (FindArgument(argc, argv, "--startup-benchmark") != nullptr)
+	{
+		// Comparing one thread against one wouldn't tell us much
+		const char* actionManifestPath = FindArgument(argc, argv, "--action-manifest=");
+		RunStartupBenchmark(actionManifestPath != nullptr ? actionManifestPath : "actions.manifest", std::max(GetStartupThreadCount(), 2u));
+		ran = true;
+	}
+	const char* handBenchmark = FindArgument(argc, argv, "--hand-benchmark");
+	if (handBenchmark != nullptr)
+	{
+		HandTracking::RunBenchmark(*handBenchmark == '=' ? handBenchmark + 1 : nullptr);
+		ran = true;
+	}
+	return ran;
+}
+
+// Plays a frame capture back through the application and the renderer, with
+// no OpenXR runtime involved. There's nothing to wait on, so frames run back
+// to back as fast as they can go.
+int ReplayCapture(const char* path, uint32_t jobThreadCount)
+{
+	if (!FrameCapture::OpenReplay(path))
+		return -12;
+
+	// Start from the placed cubes the capture was recorded with, rather than
+	// whatever the scene file holds now, and don't save anything back
+	size_t sceneSize = 0;
+	const uint8_t* scene = FrameCapture::GetReplayScene(sceneSize);
+	if (!Application::LoadSceneSnapshot(scene, sceneSize))
+	{
+		LOG(ERROR) << "The frame capture " << path << " has a broken scene snapshot";
+		FrameCapture::CloseReplay();
+		return -12;
+	}
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	D3DRenderer::CompileShaders();
+	if (!D3DRenderer::InitWithoutRuntime() || !D3DRenderer::CreateShaders() || !D3DRenderer::CreateMeshBuffers())
+	{
+		LOG(ERROR) << "Couldn't set up Direct3D for replay";
+		D3DRenderer::Shutdown();
+		FrameCapture::CloseReplay();
+		return -12;
+	}
+
+	// Every view renders into the same target, the pixels aren't going anywhere
+	XrExtent2Di extent = FrameCapture::GetReplayViewExtent();
+	SwapchainSurfacedata surface = D3DRenderer::MakeOffscreenSurface(extent.width, extent.height);
+#endif
+
+	Platform::SetCurrentThreadName("Frame Loop");
+	PROFILE_THREAD_NAME("Frame Loop");
+	PROFILE_START(frameTracePath);
+	JobSystem::Start(jobThreadCount);
+	AllocationTracker::TrackCurrentThread();
+
+	uint64_t frameCount = FrameCapture::GetReplayFrameCount();
+	uint64_t replayStart = Platform::GetTimeNanoseconds();
+	for (uint64_t i = 0; i < frameCount; i++)
+	{
+		// Same order as the live frame loop: Update sees the input from
+		// PollActions, UpdatePredicted sees it after PollPredicted, which is
+		// where xrBeginFrame would reset the frame arena.
+		AllocationTracker::BeginFrame();
+		const FrameCapture::CapturedFrame& frame = FrameCapture::GetReplayFrame(i);
+		OpenXR::SetReplayState(frame.sessionState, frame.actionInput);
+		Application::Update();
+		FrameArena::Reset();
+		OpenXR::SetReplayState(frame.sessionState, frame.predictedInput);
+		for (uint32_t h = 0; h < 2; h++)
+			HandTracking::SetJoints(h, frame.hands[h].joints, frame.hands[h].isActive != 0);
+		Application::UpdatePredicted();
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+		XrCompositionLayerProjectionView* views = FrameArena::AllocateArray<XrCompositionLayerProjectionView>(frame.viewCount);
+		for (uint32_t v = 0; v < frame.viewCount; v++)
+		{
+			views[v] = { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW };
+			views[v].pose = frame.viewPose[v];
+			views[v].fov = frame.viewFov[v];
+			views[v].subImage.imageRect.extent = extent;
+		}
+		Application::Cull(views, frame.viewCount);
+		for (uint32_t v = 0; v < frame.viewCount; v++)
+			D3DRenderer::RenderLayer(views[v], v, surface);
+		D3DRenderer::Flush();
+#endif
+		PROFILE_FRAME_MARK();
+		AllocationTracker::EndFrame();
+		FrameTelemetry::EndFrame();
+	}
+	double replayMilliseconds = (Platform::GetTimeNanoseconds() - replayStart) / 1000000.0;
+
+	JobSystem::Stop();
+	PROFILE_STOP();
+	LOG(INFO) << "Replayed " << frameCount << " frames in " << replayMilliseconds << "ms, "
+		<< (frameCount > 0 ? replayMilliseconds / frameCount : 0.0) << "ms per frame";
+	FrameTelemetry::LogSummary();
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+	D3DRenderer::OffscreenSurfaceDestroy(surface);
+	D3DRenderer::Shutdown();
+#endif
+	FrameCapture::CloseReplay();
+	return 0;
+}
+
+int AppMain(int argc, char** argv) 
+{
+	StartupTrace::Start();
+
+	// From here on, log calls only queue their text and a background thread
+	// writes it out, so logging doesn't stall startup or the frame loop.
+	AsyncLog::Start();
+	FrameArena::Init();
+
+	DebugMessenger::Settings debugSettings = DebugMessenger::DefaultSettings();
+	DebugMessenger::ParseArguments(argc, argv, debugSettings);
+	DebugMessenger::Configure(debugSettings);
+
+	// --binary-log=<path> turns on the binary log, which is cheap enough to
+	// leave on at full frame rate. Read it with the BinaryLogDecoder tool.
+	const char* binaryLogPath = FindArgument(argc, argv, "--binary-log=");
+	if (binaryLogPath != nullptr)
+		BinaryLog::Start(binaryLogPath);
+
+	// --job-threads=<count> sets how many threads split up the work of a
+	// frame, including the frame loop itself. 1 keeps everything on it.
+	const char* jobThreadArgument = FindArgument(argc, argv, "--job-threads=");
+	uint32_t jobThreadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), JobSystem::maxThreads);
+	if (jobThreadArgument != nullptr)
+		jobThreadCount = (uint32_t)std::max(atoi(jobThreadArgument), 1);
+
+	if (RunBenchmarks(argc, argv, jobThreadCount))
+	{
+		FrameArena::Shutdown();
+		BinaryLog::Stop();
+		AsyncLog::Stop();
+		return 0;
+	}
+
+	// --replay=<path> plays back a capture made with --record=<path>, and
+	// doesn't touch OpenXR at all.
+	bool failOnFrameAllocations = FindArgument(argc, argv, "--fail-on-frame-allocations") != nullptr;
+	const char* replayPath = FindArgument(argc, argv, "--replay=");
+	if (replayPath != nullptr)
+	{
+		int result = CheckFrameAllocations(ReplayCapture(replayPath, jobThreadCount), failOnFrameAllocations);
+		FrameArena::Shutdown();
+		BinaryLog::Stop();
+		AsyncLog::Stop();
+		return result;
+	}
+
+	// --action-manifest=<path> picks the actions and bindings to use
+	const char* actionManifestPath = FindArgument(argc, argv, "--action-manifest=");
+	if (actionManifestPath == nullptr)
+		actionManifestPath = "actions.manifest";
+
+	// --scene=<path> is where placed cubes are kept between runs
+	const char* scenePath = FindArgument(argc, argv, "--scene=");
+	if (scenePath == nullptr)
+		scenePath = "scene.xrscene";
+
+	AddStartupTasks(actionManifestPath, scenePath);
+
+	// Everything is joined here, before the first xrWaitFrame
+	if (!StartupGraph::Run(GetStartupThreadCount())) 
+	{
+		ShutdownStartup();
+		LOG(ERROR) << "OpenXR initialization failed";
+		StartupTrace::Write(startupTracePath);
+		FrameArena::Shutdown();
+		BinaryLog::Stop();
+		AsyncLog::Stop();
+		return -11;
+	}
+
+	// The frame loop runs on this thread, and xrWaitFrame does the pacing for us,
+	// so don't let background work get scheduled ahead of it.
+	Platform::SetCurrentThreadName("Frame Loop");
+	Platform::SetCurrentThreadPriority(ThreadPriority::High);
+	PROFILE_THREAD_NAME("Frame Loop");
+	PROFILE_START(frameTracePath);
+
+	// The frame loop thread is one of the job threads, it runs jobs while it
+	// waits for them
+	JobSystem::Start(jobThreadCount);
+	AllocationTracker::TrackCurrentThread();
+
+	const char* recordPath = FindArgument(argc, argv, "--record=");
+	if (recordPath != nullptr)
+	{
+		std::vector<uint8_t> scene;
+		Application::SnapshotScene(scene);
+		FrameCapture::StartRecording(recordPath, OpenXR::GetViewExtent(), scene.data(), scene.size());
+	}
+	const char* recordPosesPath = FindArgument(argc, argv, "--record-poses=");
+	if (recordPosesPath != nullptr)
+		FrameCapture::StartPoseRecording(recordPosesPath);
+
+	// --input-rate=<hz> samples input on its own thread, instead of once a frame
+	const char* inputRate = FindArgument(argc, argv, "--input-rate=");
+	if (inputRate != nullptr)
+		InputSampler::Start((uint32_t)atoi(inputRate));
+
+	// --prediction-telemetry checks each predicted pose against where the
+	// runtime later says it really was
+	if (FindArgument(argc, argv, "--prediction-telemetry") != nullptr)
+		OpenXR::StartPredictionAnalyzer();
+
+	bool quit = false;
+	while (!quit) 
+	{
+		OpenXR::PollEvents(quit);
+
+		if (OpenXR::IsRunning()) 
+		{
+			AllocationTracker::BeginFrame();
+			OpenXR::PollActions();
+			FrameCapture::RecordActionInput(OpenXR::GetInputState());
+			Application::Update();
+			OpenXR::RenderFrame();
+			AllocationTracker::EndFrame();
+			FrameTelemetry::EndFrame();
+
+			if (!OpenXR::IsValidSessionState())
+			{
+				Platform::SleepMilliseconds(250);
+			}
+		}
+	}
+
+	JobSystem::Stop();
+	PROFILE_STOP();
+	FrameCapture::StopRecording();
+	FrameCapture::StopPoseRecording();
+	InputSampler::Stop();
+	PredictionAnalyzer::Stop();
+	InputSampler::LogSummary();
+	LatencyTracker::EndSession();
+	DebugMessenger::LogSummary();
+	FrameTelemetry::LogSummary();
+	ShutdownStartup();
+	int result = CheckFrameAllocations(0, failOnFrameAllocations);
+	StartupTrace::Write(startupTracePath);
+	FrameArena::Shutdown();
+	BinaryLog::Stop();
+	AsyncLog::Stop();
+	return result;
+}
\ No newline at end of file
@@ -1,26 +1,48 @@
-#pragma once
-
-#include "TutorialStructs.h"
-
-#include <vector>
-
-namespace OpenXR
-{
-	bool Init(const char* app_name, int64_t swapchain_format);
-	void MakeActions();
-	void Shutdown();
-	
-	void PollEvents(bool& exit);
-	void PollActions();
-	void PollPredicted(XrTime predicted_time);
-	
-	void RenderFrame();
-	bool RenderLayer(XrTime predictedTime, std::vector<XrCompositionLayerProjectionView>& projectionViews, XrCompositionLayerProjection& layer);
-
-	XrSessionState		GetSessionState();
-	const InputState&	GetInputState();
-	const XrPosef&		GetIdentityPose();
-
-	bool IsRunning();
-	bool IsValidSessionState();
+#pragma once
+
+#include "TutorialStructs.h"
+#include "FrameCapture.h"
+#include "PoseHistory.h"
+
+#include <vector>
+
+namespace OpenXR
+{
+	// Startup is split into stages so the independent parts can overlap.
+	// InitSystem creates the instance and graphics device, InitSession needs
+	// both, and CreateSwapchains needs the session.
+	bool InitSystem(const char* app_name);
+	bool InitSession(int64_t swapchain_format);
+	bool CreateSwapchains(int64_t swapchain_format);
+	bool MakeActions();
+	void Shutdown();
+	
+	void PollEvents(bool& exit);
+	void PollActions();
+	void PollPredicted(XrTime predicted_time);
+
+	// Called by the input sampler thread, syncs actions and locates the hands
+	void SampleInput();
+	XrTime GetCurrentXrTime();
+
+	// Starts checking the head and hand predictions after the fact, see
+	// PredictionAnalyzer
+	bool StartPredictionAnalyzer();
+	
+	void RenderFrame();
+	bool RenderLayer(XrTime predictedTime, XrCompositionLayerProjectionView* projectionViews, XrCompositionLayerProjection& layer);
+
+	XrSessionState		GetSessionState();
+	const InputState&	GetInputState();
+	const XrPosef&		GetIdentityPose();
+	XrExtent2Di			GetViewExtent();
+
+	// Located hand poses, safe to query from any thread
+	const PoseHistory::History&	GetHandHistory(uint32_t hand);
+
+	// Stands in for PollEvents and PollActions when replaying a frame capture
+	void				SetReplayState(XrSessionState state, const FrameCapture::CapturedInput& input);
+
+	bool IsRunning();
+	bool IsValidSessionState();
 }
\ No newline at end of file
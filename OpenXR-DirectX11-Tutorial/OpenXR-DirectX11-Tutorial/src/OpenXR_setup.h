@@ -1,23 +1,39 @@
-#pragma once
-
-// Defines necessary to describe the platform we are building for:
-// In this case, we're building for Windows.
-// The full list can be found in openxr_platform.h.
-// Some platforms available:
-// - XR_USE_PLATFORM_ANDROID
-// - XR_USE_PLATFORM_WIN32
-// - XR_USE_PLATFORM_XLIB
-// - XR_USE_PLATFORM_XCB
-// - XR_USE_PLATFORM_WAYLAND
-#define XR_USE_PLATFORM_WIN32
-
-// Defines necessary for the underlying Graphics API
-// In this case, DX11.
-// The full list is in openxr_platform.h, but currently they are:
-// - XR_USE_GRAPHICS_API_VULKAN
-// - XR_USE_GRAPHICS_API_D3D11
-// - XR_USE_GRAPHICS_API_D3D12
-// - XR_USE_GRAPHICS_API_OPENGL_ES
-// - XR_USE_GRAPHICS_API_OPENGL
-// -
-#define XR_USE_GRAPHICS_API_D3D11
\ No newline at end of file
+#pragma once
+
+// Defines necessary to describe the platform we are building for:
+// On Windows we use the Win32 platform, and on Linux we run headless. Those
+// are the two targets Platform_Win32.cpp and Platform_Linux.cpp cover.
+// The full list can be found in openxr_platform.h.
+// Some platforms available:
+// - XR_USE_PLATFORM_ANDROID
+// - XR_USE_PLATFORM_WIN32
+// - XR_USE_PLATFORM_XLIB
+// - XR_USE_PLATFORM_XCB
+// - XR_USE_PLATFORM_WAYLAND
+#if defined(_WIN32)
+#define XR_USE_PLATFORM_WIN32
+#elif defined(__linux__)
+// Linux hosts don't have Direct3D, so instead of picking a windowing platform
+// we create the session through XR_MND_headless. The frame loop, input and 
+// tracking all still work, we just don't submit any layers to the compositor.
+#define XR_TUTORIAL_HEADLESS
+
+// XrTime can be converted to and from CLOCK_MONOTONIC timespecs
+#include <time.h>
+#define XR_USE_TIMESPEC
+#else
+#error "There's no platform layer for this target, see Platform.h"
+#endif
+
+// Defines necessary for the underlying Graphics API
+// In this case, DX11.
+// The full list is in openxr_platform.h, but currently they are:
+// - XR_USE_GRAPHICS_API_VULKAN
+// - XR_USE_GRAPHICS_API_D3D11
+// - XR_USE_GRAPHICS_API_D3D12
+// - XR_USE_GRAPHICS_API_OPENGL_ES
+// - XR_USE_GRAPHICS_API_OPENGL
+// -
+#if !defined(XR_TUTORIAL_HEADLESS)
+#define XR_USE_GRAPHICS_API_D3D11
+#endif
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "Picking.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PICKING_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+using namespace Picking;
+
+void PickingResize(Boxes& boxes, size_t size)
+{
+	boxes.centerX.resize(size);
+	boxes.centerY.resize(size);
+	boxes.centerZ.resize(size);
+	for (int32_t i = 0; i < 3; i++)
+		for (int32_t j = 0; j < 3; j++)
+			boxes.axis[i][j].resize(size);
+	boxes.halfExtent.resize(size);
+}
+
+uint32_t Picking::Add(Boxes& boxes, const XrPosef& pose, float halfExtent)
+{
+	// Grow four lanes at a time. The lanes past count are never read as hits.
+	uint32_t index = boxes.count++;
+	if (boxes.count > boxes.halfExtent.size())
+		PickingResize(boxes, (boxes.count + 3) & ~3u);
+	Set(boxes, index, pose, halfExtent);
+	return index;
+}
+
+void Picking::Set(Boxes& boxes, uint32_t index, const XrPosef& pose, float halfExtent)
+{
+	// The columns of the rotation matrix are the box's axes in world space
+	const XrQuaternionf& q = pose.orientation;
+	float axes[3][3] = {
+		{ 1 - 2 * (q.y * q.y + q.z * q.z), 2 * (q.x * q.y + q.w * q.z),     2 * (q.x * q.z - q.w * q.y) },
+		{ 2 * (q.x * q.y - q.w * q.z),     1 - 2 * (q.x * q.x + q.z * q.z), 2 * (q.y * q.z + q.w * q.x) },
+		{ 2 * (q.x * q.z + q.w * q.y),     2 * (q.y * q.z - q.w * q.x),     1 - 2 * (q.x * q.x + q.y * q.y) },
+	};
+
+	boxes.centerX[index] = pose.position.x;
+	boxes.centerY[index] = pose.position.y;
+	boxes.centerZ[index] = pose.position.z;
+	for (int32_t i = 0; i < 3; i++)
+		for (int32_t j = 0; j < 3; j++)
+			boxes.axis[i][j][index] = axes[i][j];
+	boxes.halfExtent[index] = halfExtent;
+}
+
+void Picking::Clear(Boxes& boxes)
+{
+	boxes.count = 0;
+	PickingResize(boxes, 0);
+}
+
+void Picking::SetCount(Boxes& boxes, uint32_t count)
+{
+	boxes.count = count;
+	if (count > boxes.halfExtent.size())
+		PickingResize(boxes, (count + 3) & ~3u);
+}
+
+Hit Picking::CastRayScalar(const Boxes& boxes, const XrVector3f& origin, const XrVector3f& direction, float maxDistance)
+{
+	Hit hit = { -1, maxDistance };
+	for (uint32_t b = 0; b < boxes.count; b++)
+	{
+		float relative[3] = { origin.x - boxes.centerX[b], origin.y - boxes.centerY[b], origin.z - boxes.centerZ[b] };
+		float h = boxes.halfExtent[b];
+		float enter = 0.0f;
+		float exit = hit.distance;
+		for (int32_t i = 0; i < 3; i++)
+		{
+			// The ray in the box's space, along this axis
+			float o = boxes.axis[i][0][b] * relative[0] + boxes.axis[i][1][b] * relative[1] + boxes.axis[i][2][b] * relative[2];
+			float d = boxes.axis[i][0][b] * direction.x + boxes.axis[i][1][b] * direction.y + boxes.axis[i][2][b] * direction.z;
+			float inverse = 1.0f / d;
+			float t1 = (-h - o) * inverse;
+			float t2 = (h - o) * inverse;
+			enter = std::max(enter, std::min(t1, t2));
+			exit = std::min(exit, std::max(t1, t2));
+		}
+		if (enter <= exit && enter < hit.distance)
+		{
+			hit.index = (int32_t)b;
+			hit.distance = enter;
+		}
+	}
+	return hit;
+}
+
+#if defined(PICKING_SSE)
+Hit Picking::CastRay(const Boxes& boxes, const XrVector3f& origin, const XrVector3f& direction, float maxDistance)
+{
+	PROFILE_ZONE("Picking::CastRay");
+
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 three = _mm_set1_ps(3.0f);
+	const __m128 directionLengthSquared = _mm_set1_ps(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+	const __m128i count = _mm_set1_epi32((int32_t)boxes.count);
+	const __m128i four = _mm_set1_epi32(4);
+
+	// Each lane keeps its own nearest hit, and they're compared at the end
+	__m128  nearest = _mm_set1_ps(maxDistance);
+	__m128i nearestIndex = _mm_set1_epi32(-1);
+	__m128i index = _mm_set_epi32(3, 2, 1, 0);
+
+	for (uint32_t b = 0; b < boxes.count; b += 4)
+	{
+		__m128 rx = _mm_sub_ps(ox, _mm_loadu_ps(&boxes.centerX[b]));
+		__m128 ry = _mm_sub_ps(oy, _mm_loadu_ps(&boxes.centerY[b]));
+		__m128 rz = _mm_sub_ps(oz, _mm_loadu_ps(&boxes.centerZ[b]));
+		__m128 h = _mm_loadu_ps(&boxes.halfExtent[b]);
+
+		// Most boxes are nowhere near the ray, and the test is limited by how
+		// fast the boxes can be read, not the math. So first check the ray
+		// against a sphere around each box, which only needs the centres, and
+		// skip reading the axes unless one of the four might be hit. The ray
+		// misses the sphere if its closest approach to the centre is further
+		// than the radius, sqrt(3) * h.
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, dx), _mm_mul_ps(ry, dy)), _mm_mul_ps(rz, dz));
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz));
+		__m128 closestSquared = _mm_sub_ps(_mm_mul_ps(distanceSquared, directionLengthSquared), _mm_mul_ps(along, along));
+		__m128 radiusSquared = _mm_mul_ps(_mm_mul_ps(three, _mm_mul_ps(h, h)), directionLengthSquared);
+		if (_mm_movemask_ps(_mm_cmple_ps(closestSquared, radiusSquared)) == 0)
+		{
+			index = _mm_add_epi32(index, four);
+			continue;
+		}
+
+		__m128 negativeH = _mm_sub_ps(_mm_setzero_ps(), h);
+
+		__m128 enter = _mm_setzero_ps();
+		__m128 exit = nearest;
+		for (int32_t i = 0; i < 3; i++)
+		{
+			__m128 ax = _mm_loadu_ps(&boxes.axis[i][0][b]);
+			__m128 ay = _mm_loadu_ps(&boxes.axis[i][1][b]);
+			__m128 az = _mm_loadu_ps(&boxes.axis[i][2][b]);
+			__m128 o = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, rx), _mm_mul_ps(ay, ry)), _mm_mul_ps(az, rz));
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, dx), _mm_mul_ps(ay, dy)), _mm_mul_ps(az, dz));
+			__m128 inverse = _mm_div_ps(one, d);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(negativeH, o), inverse);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(h, o), inverse);
+			enter = _mm_max_ps(enter, _mm_min_ps(t1, t2));
+			exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+		}
+
+		// A hit if the slabs overlap, it's nearer than this lane's best so far,
+		// and the lane is a real box rather than padding
+		__m128 isHit = _mm_and_ps(_mm_cmple_ps(enter, exit), _mm_cmplt_ps(enter, nearest));
+		isHit = _mm_and_ps(isHit, _mm_castsi128_ps(_mm_cmplt_epi32(index, count)));
+		nearest = _mm_or_ps(_mm_and_ps(isHit, enter), _mm_andnot_ps(isHit, nearest));
+		nearestIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isHit), index), _mm_andnot_si128(_mm_castps_si128(isHit), nearestIndex));
+		index = _mm_add_epi32(index, four);
+	}
+
+	alignas(16) float laneDistance[4];
+	alignas(16) int32_t laneIndex[4];
+	_mm_store_ps(laneDistance, nearest);
+	_mm_store_si128((__m128i*)laneIndex, nearestIndex);
+
+	Hit hit = { -1, maxDistance };
+	for (int32_t i = 0; i < 4; i++)
+	{
+		if (laneIndex[i] >= 0 && (hit.index < 0 || laneDistance[i] < hit.distance))
+		{
+			hit.index = laneIndex[i];
+			hit.distance = laneDistance[i];
+		}
+	}
+	return hit;
+}
+#else
+Hit Picking::CastRay(const Boxes& boxes, const XrVector3f& origin, const XrVector3f& direction, float maxDistance)
+{
+	PROFILE_ZONE("Picking::CastRay");
+	return CastRayScalar(boxes, origin, direction, maxDistance);
+}
+#endif
+
+void Picking::GetPoseRay(const XrPosef& pose, XrVector3f& origin, XrVector3f& direction)
+{
+	// The third column of the rotation matrix is the pose's +z axis
+	const XrQuaternionf& q = pose.orientation;
+	origin = pose.position;
+	direction = { -2 * (q.x * q.z + q.w * q.y), -2 * (q.y * q.z - q.w * q.x), -(1 - 2 * (q.x * q.x + q.y * q.y)) };
+}
+
+void Picking::RunBenchmark()
+{
+	const uint32_t boxCounts[] = { 1000, 10000, 100000 };
+	const uint32_t rayCount = 1000;
+	const float sceneHalfSize = 5.0f;
+
+	// Cubes the size the app places, scattered and turned every which way,
+	// with rays from the middle of them in random directions
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-sceneHalfSize, sceneHalfSize);
+	std::normal_distribution<float> normal;
+	auto randomUnit = [&](float* v, uint32_t n)
+	{
+		float length = 0.0f;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			v[i] = normal(random);
+			length += v[i] * v[i];
+		}
+		for (uint32_t i = 0; i < n; i++)
+			v[i] /= sqrtf(length);
+	};
+
+	std::vector<XrVector3f> origins(rayCount), directions(rayCount);
+	for (uint32_t r = 0; r < rayCount; r++)
+	{
+		origins[r] = { position(random) * 0.5f, position(random) * 0.5f, position(random) * 0.5f };
+		randomUnit(&directions[r].x, 3);
+	}
+
+	for (uint32_t boxCount : boxCounts)
+	{
+		Boxes boxes;
+		for (uint32_t b = 0; b < boxCount; b++)
+		{
+			XrPosef pose;
+			randomUnit(&pose.orientation.x, 4);
+			pose.position = { position(random), position(random), position(random) };
+			Add(boxes, pose, 0.05f);
+		}
+
+		uint64_t start = Platform::GetTimeNanoseconds();
+		std::vector<Hit> hits(rayCount);
+		for (uint32_t r = 0; r < rayCount; r++)
+			hits[r] = CastRay(boxes, origins[r], directions[r], 2.0f * sceneHalfSize);
+		uint64_t fastNanoseconds = Platform::GetTimeNanoseconds() - start;
+
+		start = Platform::GetTimeNanoseconds();
+		uint32_t hitCount = 0, mismatches = 0;
+		for (uint32_t r = 0; r < rayCount; r++)
+		{
+			Hit hit = CastRayScalar(boxes, origins[r], directions[r], 2.0f * sceneHalfSize);
+			hitCount += hit.index >= 0;
+			if (hit.index != hits[r].index && fabsf(hit.distance - hits[r].distance) > 1e-4f)
+				mismatches++;
+		}
+		uint64_t scalarNanoseconds = Platform::GetTimeNanoseconds() - start;
+
+		LOG(INFO) << "Picking " << boxCount << " boxes: CastRay " << (double)fastNanoseconds / rayCount / 1000.0 << "us per ray ("
+			<< (double)fastNanoseconds / ((double)rayCount * boxCount) << "ns per box), CastRayScalar "
+			<< (double)scalarNanoseconds / rayCount / 1000.0 << "us per ray ("
+			<< (double)scalarNanoseconds / fastNanoseconds << "x slower), "
+			<< hitCount << " of " << rayCount << " rays hit, " << mismatches << " mismatches";
+	}
+}
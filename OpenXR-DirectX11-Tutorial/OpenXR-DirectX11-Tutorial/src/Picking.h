@@ -0,0 +1,50 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Finds the nearest oriented box a ray hits, for pointing at things with a
+// hand. Rather than walk a tree, it tests every box, four at a time with SSE:
+// the ray is moved into each box's own space, where the box is axis aligned,
+// and clipped against its three pairs of faces (the slab test). A cheaper
+// test against a sphere around each box goes first, and most groups of four
+// stop there.
+//
+// Boxes are stored by field, with each box's axes kept as world space
+// vectors, so the kernel never has to turn a quaternion into a rotation.
+// Everything is padded to a multiple of four so the kernel has no tail.
+namespace Picking
+{
+	struct Boxes
+	{
+		std::vector<float>	centerX, centerY, centerZ;
+		std::vector<float>	axis[3][3];		// axis[i][j] is component j of the box's local axis i
+		std::vector<float>	halfExtent;
+		uint32_t			count = 0;
+	};
+
+	struct Hit
+	{
+		int32_t		index;		// -1 if nothing was hit
+		float		distance;	// Along the ray, in units of the direction's length
+	};
+
+	// A cube of the given half size, rotated and placed by pose
+	uint32_t	Add(Boxes& boxes, const XrPosef& pose, float halfExtent);
+	void		Set(Boxes& boxes, uint32_t index, const XrPosef& pose, float halfExtent);
+	void		Clear(Boxes& boxes);
+	// Grows or shrinks to count boxes, keeping the ones below it
+	void		SetCount(Boxes& boxes, uint32_t count);
+
+	Hit			CastRay(const Boxes& boxes, const XrVector3f& origin, const XrVector3f& direction, float maxDistance);
+	Hit			CastRayScalar(const Boxes& boxes, const XrVector3f& origin, const XrVector3f& direction, float maxDistance);
+
+	// The ray a pose points along: from its position, down its -z axis
+	void		GetPoseRay(const XrPosef& pose, XrVector3f& origin, XrVector3f& direction);
+
+	// Times CastRay against CastRayScalar on scattered boxes, checks they find
+	// the same hits, and logs the results
+	void		RunBenchmark();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MSVC provides _countof in stdlib.h, other compilers don't.
+#ifndef _countof
+#define _countof(arr) (sizeof(arr) / sizeof((arr)[0]))
+#endif
+
+// The application entry point. Each platform implementation provides the real
+// entry point (wWinMain on Windows, main on Linux) and forwards to this.
+int AppMain(int argc, char** argv);
+
+enum class ThreadPriority
+{
+	Low,
+	Normal,
+	High,
+	Realtime,
+};
+
+// A file mapped into memory. The handles are whatever the platform needs to
+// keep around until the file is closed.
+struct MappedFile
+{
+	uint8_t*	data;
+	size_t		size;
+	intptr_t	fileHandle;
+	intptr_t	mappingHandle;
+};
+
+namespace Platform
+{
+	uint64_t	GetTimeNanoseconds();
+	void		SleepMilliseconds(uint32_t milliseconds);
+
+	// Sleeps until GetTimeNanoseconds reaches the given time, with better
+	// than millisecond precision where the OS allows it
+	void		SleepUntilNanoseconds(uint64_t time);
+
+	void		DebugOutput(const char* text);
+	void		DebugPrintf(const char* format, ...);
+
+	bool		SetCurrentThreadPriority(ThreadPriority priority);
+	void		SetCurrentThreadName(const char* name);
+
+	// Safe, always null terminated string copy. Replaces strcpy_s, which isn't
+	// available outside of MSVC.
+	void		CopyString(char* destination, size_t destinationSize, const char* source);
+
+	template <size_t N>
+	void		CopyString(char (&destination)[N], const char* source) { CopyString(destination, N, source); }
+
+	// CreateMappedFile creates (or overwrites) a file of the given size and
+	// maps it for writing. OpenMappedFile maps an existing file at its current
+	// size. Writes land in the file even if we crash before closing it.
+	bool		CreateMappedFile(const char* path, size_t size, MappedFile& file);
+	bool		OpenMappedFile(const char* path, bool writable, MappedFile& file);
+	void		FlushMappedFile(MappedFile& file);
+	void		CloseMappedFile(MappedFile& file);
+	bool		TruncateFile(const char* path, size_t size);
+
+	// Renames from to to, replacing to if it's already there
+	bool		RenameFile(const char* from, const char* to);
+}
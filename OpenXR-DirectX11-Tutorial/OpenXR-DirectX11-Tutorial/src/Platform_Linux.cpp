@@ -0,0 +1,178 @@
+#include "Platform.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char** argv)
+{
+	return AppMain(argc, argv);
+}
+
+uint64_t Platform::GetTimeNanoseconds()
+{
+	// CLOCK_MONOTONIC is the same clock the OpenXR runtimes on Linux use as
+	// their XrTime base, which makes comparing timestamps a lot easier.
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+void Platform::SleepMilliseconds(uint32_t milliseconds)
+{
+	timespec duration;
+	duration.tv_sec = milliseconds / 1000;
+	duration.tv_nsec = (long)(milliseconds % 1000) * 1000000l;
+	while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {}
+}
+
+void Platform::SleepUntilNanoseconds(uint64_t time)
+{
+	timespec deadline;
+	deadline.tv_sec = (time_t)(time / 1000000000ull);
+	deadline.tv_nsec = (long)(time % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+}
+
+void Platform::DebugOutput(const char* text)
+{
+	// There's no debugger output window on Linux, stderr is the closest match
+	fputs(text, stderr);
+}
+
+void Platform::DebugPrintf(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+bool Platform::SetCurrentThreadPriority(ThreadPriority priority)
+{
+	// Realtime scheduling usually needs CAP_SYS_NICE or an rtkit grant, so if
+	// that's refused we fall back to the highest nice value we're allowed.
+	if (priority == ThreadPriority::Realtime)
+	{
+		sched_param param = {};
+		param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+			return true;
+		priority = ThreadPriority::High;
+	}
+
+	int niceValue = 0;
+	switch (priority)
+	{
+	case ThreadPriority::Low:    niceValue = 5; break;
+	case ThreadPriority::Normal: niceValue = 0; break;
+	default:                     niceValue = -5; break;
+	}
+
+	// On Linux, the nice value of a thread is set through its thread ID
+	pid_t threadID = (pid_t)syscall(SYS_gettid);
+	return setpriority(PRIO_PROCESS, (id_t)threadID, niceValue) == 0;
+}
+
+void Platform::SetCurrentThreadName(const char* name)
+{
+	// Thread names are limited to 16 characters including the terminator
+	char shortName[16];
+	CopyString(shortName, name);
+	pthread_setname_np(pthread_self(), shortName);
+}
+
+void Platform::CopyString(char* destination, size_t destinationSize, const char* source)
+{
+	if (destinationSize == 0)
+		return;
+	strncpy(destination, source, destinationSize - 1);
+	destination[destinationSize - 1] = '\0';
+}
+
+bool Platform::CreateMappedFile(const char* path, size_t size, MappedFile& file)
+{
+	file = {};
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return false;
+
+	// Growing the file with ftruncate leaves it sparse, so only the pages we
+	// actually write to take up disk space.
+	void* data = MAP_FAILED;
+	if (ftruncate(fd, (off_t)size) == 0)
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	file.data = (uint8_t*)data;
+	file.size = size;
+	file.fileHandle = fd;
+	return true;
+}
+
+bool Platform::OpenMappedFile(const char* path, bool writable, MappedFile& file)
+{
+	file = {};
+	int fd = open(path, writable ? O_RDWR : O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+		data = mmap(nullptr, (size_t)info.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	file.data = (uint8_t*)data;
+	file.size = (size_t)info.st_size;
+	file.fileHandle = fd;
+	return true;
+}
+
+void Platform::FlushMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+		msync(file.data, file.size, MS_ASYNC);
+}
+
+void Platform::CloseMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+	{
+		munmap(file.data, file.size);
+		close((int)file.fileHandle);
+	}
+	file = {};
+}
+
+bool Platform::TruncateFile(const char* path, size_t size)
+{
+	return truncate(path, (off_t)size) == 0;
+}
+
+bool Platform::RenameFile(const char* from, const char* to)
+{
+	return rename(from, to) == 0;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "Platform.h"
+
+#if defined(_WIN32)
+
+#include <windows.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Windows GUI applications start here rather than in main. The CRT has already
+// split the command line for us, so just hand it on.
+int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int)
+{
+	return AppMain(__argc, __argv);
+}
+
+uint64_t Platform::GetTimeNanoseconds()
+{
+	static LARGE_INTEGER frequency = {};
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion up so we don't overflow 64 bits on long uptimes
+	uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+	uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000ull + (remainder * 1000000000ull) / frequency.QuadPart;
+}
+
+void Platform::SleepMilliseconds(uint32_t milliseconds)
+{
+	Sleep(milliseconds);
+}
+
+// Sleep rounds up to the system timer tick, which is 15.6ms unless someone
+// has raised it. High resolution waitable timers (Windows 10 1803 and up)
+// don't have that problem.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void Platform::SleepUntilNanoseconds(uint64_t time)
+{
+	thread_local HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+	uint64_t now = GetTimeNanoseconds();
+	if (time <= now)
+		return;
+
+	if (timer == nullptr)
+	{
+		Sleep((DWORD)((time - now + 999999) / 1000000));
+		return;
+	}
+
+	// Negative due times are relative, in 100ns units
+	LARGE_INTEGER dueTime;
+	dueTime.QuadPart = -(LONGLONG)((time - now) / 100);
+	if (SetWaitableTimer(timer, &dueTime, 0, nullptr, nullptr, FALSE))
+		WaitForSingleObject(timer, INFINITE);
+}
+
+void Platform::DebugOutput(const char* text)
+{
+	OutputDebugStringA(text);
+}
+
+void Platform::DebugPrintf(const char* format, ...)
+{
+	char text[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	OutputDebugStringA(text);
+}
+
+bool Platform::SetCurrentThreadPriority(ThreadPriority priority)
+{
+	int winPriority = THREAD_PRIORITY_NORMAL;
+	switch (priority)
+	{
+	case ThreadPriority::Low:      winPriority = THREAD_PRIORITY_BELOW_NORMAL; break;
+	case ThreadPriority::Normal:   winPriority = THREAD_PRIORITY_NORMAL; break;
+	case ThreadPriority::High:     winPriority = THREAD_PRIORITY_HIGHEST; break;
+	case ThreadPriority::Realtime: winPriority = THREAD_PRIORITY_TIME_CRITICAL; break;
+	}
+	return SetThreadPriority(GetCurrentThread(), winPriority) != 0;
+}
+
+void Platform::SetCurrentThreadName(const char* name)
+{
+	wchar_t wideName[64];
+	MultiByteToWideChar(CP_UTF8, 0, name, -1, wideName, _countof(wideName));
+	wideName[_countof(wideName) - 1] = 0;
+	SetThreadDescription(GetCurrentThread(), wideName);
+}
+
+void Platform::CopyString(char* destination, size_t destinationSize, const char* source)
+{
+	strncpy_s(destination, destinationSize, source, _TRUNCATE);
+}
+
+bool Platform::CreateMappedFile(const char* path, size_t size, MappedFile& file)
+{
+	file = {};
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Creating the mapping with a size larger than the file grows the file
+	uint64_t size64 = (uint64_t)size;
+	HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)(size64 & 0xFFFFFFFF), nullptr);
+	void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+	if (data == nullptr)
+	{
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file.data = (uint8_t*)data;
+	file.size = size;
+	file.fileHandle = (intptr_t)fileHandle;
+	file.mappingHandle = (intptr_t)mapping;
+	return true;
+}
+
+bool Platform::OpenMappedFile(const char* path, bool writable, MappedFile& file)
+{
+	file = {};
+	// Readers don't mind someone else appending to the file while it's mapped,
+	// as the scene file does
+	DWORD access = writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+	DWORD share = writable ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE;
+	HANDLE fileHandle = CreateFileA(path, access, share, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Empty files can't be mapped
+	LARGE_INTEGER fileSize = {};
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0)
+		mapping = CreateFileMappingA(fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping != nullptr ? MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (data == nullptr)
+	{
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file.data = (uint8_t*)data;
+	file.size = (size_t)fileSize.QuadPart;
+	file.fileHandle = (intptr_t)fileHandle;
+	file.mappingHandle = (intptr_t)mapping;
+	return true;
+}
+
+void Platform::FlushMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+		FlushViewOfFile(file.data, 0);
+}
+
+void Platform::CloseMappedFile(MappedFile& file)
+{
+	if (file.data != nullptr)
+	{
+		UnmapViewOfFile(file.data);
+		CloseHandle((HANDLE)file.mappingHandle);
+		CloseHandle((HANDLE)file.fileHandle);
+	}
+	file = {};
+}
+
+bool Platform::TruncateFile(const char* path, size_t size)
+{
+	HANDLE fileHandle = CreateFileA(path, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER position;
+	position.QuadPart = (LONGLONG)size;
+	bool result = SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN) && SetEndOfFile(fileHandle);
+	CloseHandle(fileHandle);
+	return result;
+}
+
+bool Platform::RenameFile(const char* from, const char* to)
+{
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+#endif
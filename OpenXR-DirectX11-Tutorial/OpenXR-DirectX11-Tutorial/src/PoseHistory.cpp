@@ -0,0 +1,156 @@
+#include "PoseHistory.h"
+
+#include <math.h>
+
+using namespace PoseHistory;
+
+XrQuaternionf PoseHistoryMultiply(const XrQuaternionf& a, const XrQuaternionf& b)
+{
+	return {
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z };
+}
+
+XrQuaternionf PoseHistoryNormalize(const XrQuaternionf& q)
+{
+	float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	if (length <= 0)
+		return { 0, 0, 0, 1 };
+	return { q.x / length, q.y / length, q.z / length, q.w / length };
+}
+
+// Copies sample index out of its slot. Fails if the writer has moved on and
+// reused the slot, or is in it right now.
+bool PoseHistoryRead(const History& history, uint64_t index, XrTime& time, XrPosef& pose)
+{
+	const Slot& slot = history.slots[index % capacity];
+	uint64_t expected = index * 2 + 2;
+	if (slot.sequence.load(std::memory_order_acquire) != expected)
+		return false;
+	time = slot.time;
+	pose = slot.pose;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+void PoseHistory::Push(History& history, XrTime time, const XrPosef& pose)
+{
+	uint64_t index = history.count.load(std::memory_order_relaxed);
+	if (index > 0 && history.slots[(index - 1) % capacity].time >= time)
+		return;
+
+	Slot& slot = history.slots[index % capacity];
+	slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.time = time;
+	slot.pose = pose;
+	slot.sequence.store(index * 2 + 2, std::memory_order_release);
+	history.count.store(index + 1, std::memory_order_release);
+}
+
+PoseHistory::Query PoseHistory::Sample(const History& history, XrTime time, XrPosef& pose, XrDuration maxExtrapolation)
+{
+	uint64_t count = history.count.load(std::memory_order_acquire);
+	if (count == 0)
+		return Query::Unavailable;
+
+	// Walk back from the newest sample, since most queries are for recent
+	// times. If the writer laps us, the rest of the history is gone anyway.
+	XrTime  laterTime = 0;
+	XrPosef laterPose = {};
+	uint64_t oldest = count > capacity ? count - capacity : 0;
+	for (uint64_t index = count; index-- > oldest; )
+	{
+		XrTime  sampleTime;
+		XrPosef samplePose;
+		if (!PoseHistoryRead(history, index, sampleTime, samplePose))
+			return Query::Unavailable;
+
+		if (sampleTime > time)
+		{
+			laterTime = sampleTime;
+			laterPose = samplePose;
+			continue;
+		}
+
+		// Inside the history, blend between the samples either side
+		if (index != count - 1)
+		{
+			pose = Interpolate(samplePose, laterPose, (float)(time - sampleTime) / (float)(laterTime - sampleTime));
+			return Query::Interpolated;
+		}
+
+		// Past the newest sample. Carry on at the speed the last two samples
+		// were moving, up to the extrapolation limit.
+		XrTime  previousTime;
+		XrPosef previousPose;
+		if (time == sampleTime || index == 0 || !PoseHistoryRead(history, index - 1, previousTime, previousPose))
+		{
+			pose = samplePose;
+			return time == sampleTime ? Query::Interpolated : Query::Extrapolated;
+		}
+
+		XrDuration ahead = time - sampleTime;
+		if (ahead > maxExtrapolation)
+			ahead = maxExtrapolation;
+		float scale = (float)ahead / (float)(sampleTime - previousTime);
+
+		XrQuaternionf previousInverse = { -previousPose.orientation.x, -previousPose.orientation.y, -previousPose.orientation.z, previousPose.orientation.w };
+		XrQuaternionf step = PoseHistoryMultiply(samplePose.orientation, previousInverse);
+		pose.orientation = PoseHistoryNormalize(PoseHistoryMultiply(Slerp({ 0, 0, 0, 1 }, step, scale), samplePose.orientation));
+		pose.position.x = samplePose.position.x + (samplePose.position.x - previousPose.position.x) * scale;
+		pose.position.y = samplePose.position.y + (samplePose.position.y - previousPose.position.y) * scale;
+		pose.position.z = samplePose.position.z + (samplePose.position.z - previousPose.position.z) * scale;
+		return Query::Extrapolated;
+	}
+	return Query::Unavailable;
+}
+
+bool PoseHistory::GetNewest(const History& history, XrTime& time, XrPosef& pose)
+{
+	uint64_t count = history.count.load(std::memory_order_acquire);
+	return count > 0 && PoseHistoryRead(history, count - 1, time, pose);
+}
+
+XrQuaternionf PoseHistory::Slerp(const XrQuaternionf& a, const XrQuaternionf& b, float t)
+{
+	// Take the short way around
+	float cosAngle = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	float sign = 1;
+	if (cosAngle < 0)
+	{
+		cosAngle = -cosAngle;
+		sign = -1;
+	}
+
+	// Close together, sin gets imprecise, and a plain lerp is just as good.
+	// This also works for t outside 0 to 1, which is how extrapolation uses it.
+	float weightA = 1 - t;
+	float weightB = t;
+	if (cosAngle < 0.9995f)
+	{
+		float angle = acosf(cosAngle);
+		float sinAngle = sinf(angle);
+		weightA = sinf((1 - t) * angle) / sinAngle;
+		weightB = sinf(t * angle) / sinAngle;
+	}
+	weightB *= sign;
+
+	return PoseHistoryNormalize({
+		a.x * weightA + b.x * weightB,
+		a.y * weightA + b.y * weightB,
+		a.z * weightA + b.z * weightB,
+		a.w * weightA + b.w * weightB });
+}
+
+XrPosef PoseHistory::Interpolate(const XrPosef& a, const XrPosef& b, float t)
+{
+	XrPosef result;
+	result.orientation = Slerp(a.orientation, b.orientation, t);
+	result.position.x = a.position.x + (b.position.x - a.position.x) * t;
+	result.position.y = a.position.y + (b.position.y - a.position.y) * t;
+	result.position.z = a.position.z + (b.position.z - a.position.z) * t;
+	return result;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <atomic>
+
+// Keeps the last few hundred poses of a tracked space, so the pose at any
+// recent time can be looked up without asking the runtime again. Between two
+// samples, position is lerped and orientation slerped. Past the newest sample
+// the pose is extrapolated from the last two, but only so far.
+//
+// One thread pushes samples, any number of threads can query at the same
+// time, and nobody takes a lock. Each slot has a sequence number that's odd
+// while the writer is in it, so a reader that raced the writer can tell and
+// skip that slot. Readers never wait on the writer.
+namespace PoseHistory
+{
+	const uint32_t		capacity = 256;
+
+	// How far past the newest sample a query will extrapolate. Beyond this,
+	// the pose is held at the bound rather than flying off.
+	const XrDuration	defaultMaxExtrapolation = 50 * 1000000;
+
+	struct Slot
+	{
+		std::atomic<uint64_t>	sequence;	// 2n+1 while sample n is being written, 2n+2 once it's done
+		XrTime					time;
+		XrPosef					pose;
+	};
+
+	// Zero initialized is empty, so a global History needs no setup
+	struct History
+	{
+		Slot					slots[capacity];
+		std::atomic<uint64_t>	count;		// Samples pushed so far
+	};
+
+	enum class Query
+	{
+		Unavailable,	// Empty, or older than anything still in the history
+		Interpolated,
+		Extrapolated,
+	};
+
+	// Writer only. Samples must arrive in time order, and ones that don't are
+	// dropped.
+	void	Push(History& history, XrTime time, const XrPosef& pose);
+
+	Query	Sample(const History& history, XrTime time, XrPosef& pose, XrDuration maxExtrapolation = defaultMaxExtrapolation);
+	bool	GetNewest(const History& history, XrTime& time, XrPosef& pose);
+
+	// Pose math, shared with anything else that blends poses
+	XrQuaternionf	Slerp(const XrQuaternionf& a, const XrQuaternionf& b, float t);
+	XrPosef			Interpolate(const XrPosef& a, const XrPosef& b, float t);
+}
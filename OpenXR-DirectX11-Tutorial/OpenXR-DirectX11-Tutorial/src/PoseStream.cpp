@@ -0,0 +1,490 @@
+#include "PoseStream.h"
+
+#include "easylogging++.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+using namespace PoseStream;
+
+const char		poseStreamMagic[8] = { 'X', 'R', 'P', 'O', 'S', 'E', '0', '1' };
+const uint32_t	poseStreamVersion = 1;
+
+// Quaternion components other than the largest are within +-1/sqrt(2), and get
+// 15 bits each.
+const float		poseStreamComponentRange = 0.70710678f;
+const float		poseStreamComponentSteps = 32767.0f;
+const float		poseStreamPositionUnitsPerMeter = 10000.0f;
+
+// Orientations are 6 bytes, positions and times are varints
+const size_t	poseStreamOrientationBytes = 6;
+const size_t	poseStreamMaxSampleBytes = 10 + 5 + maxPoses * (poseStreamOrientationBytes + 3 * 5);
+
+// Signed values are zigzag encoded first (0, -1, 1, -2, ...), so small
+// negative numbers stay small.
+void PoseStreamWriteVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+void PoseStreamWriteSigned(std::vector<uint8_t>& out, int64_t value)
+{
+	PoseStreamWriteVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+bool PoseStreamReadVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7)
+	{
+		if (in >= end)
+			return false;
+		uint8_t byte = *in++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool PoseStreamReadSigned(const uint8_t*& in, const uint8_t* end, int64_t& value)
+{
+	uint64_t encoded = 0;
+	if (!PoseStreamReadVarint(in, end, encoded))
+		return false;
+	value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+	return true;
+}
+
+uint64_t PoseStream::EncodeOrientation(const XrQuaternionf& orientation)
+{
+	float components[4] = { orientation.x, orientation.y, orientation.z, orientation.w };
+
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; i++)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so flip it to make the dropped component
+	// positive, then we don't need to store its sign.
+	float sign = components[largest] < 0 ? -1.0f : 1.0f;
+
+	uint64_t encoded = (uint64_t)largest << 45;
+	uint32_t shift = 30;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float normalized = (components[i] * sign / poseStreamComponentRange + 1.0f) * 0.5f;
+		float quantized = std::min(std::max(normalized * poseStreamComponentSteps + 0.5f, 0.0f), poseStreamComponentSteps);
+		encoded |= (uint64_t)quantized << shift;
+		shift -= 15;
+	}
+	return encoded;
+}
+
+XrQuaternionf PoseStream::DecodeOrientation(uint64_t encoded)
+{
+	uint32_t largest = (uint32_t)(encoded >> 45) & 3;
+
+	float components[4];
+	float sumOfSquares = 0;
+	uint32_t shift = 30;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float quantized = (float)((encoded >> shift) & 0x7FFF);
+		components[i] = (quantized / poseStreamComponentSteps * 2.0f - 1.0f) * poseStreamComponentRange;
+		sumOfSquares += components[i] * components[i];
+		shift -= 15;
+	}
+	components[largest] = sqrtf(std::max(1.0f - sumOfSquares, 0.0f));
+
+	// Rounding can leave it slightly off unit length
+	float length = sqrtf(sumOfSquares + components[largest] * components[largest]);
+	return { components[0] / length, components[1] / length, components[2] / length, components[3] / length };
+}
+
+int32_t PoseStream::EncodePosition(float meters)
+{
+	return (int32_t)lroundf(meters * poseStreamPositionUnitsPerMeter);
+}
+
+float PoseStream::DecodePosition(int32_t encoded)
+{
+	return (float)encoded / poseStreamPositionUnitsPerMeter;
+}
+
+void PoseStreamFlushBlock(Writer& writer)
+{
+	if (writer.blockSamples == 0)
+		return;
+
+	BlockHeader* header = (BlockHeader*)writer.block.data();
+	header->size = (uint32_t)writer.block.size();
+	header->sampleCount = writer.blockSamples;
+	writer.file.write((const char*)writer.block.data(), writer.block.size());
+
+	writer.block.clear();
+	writer.blockSamples = 0;
+}
+
+bool PoseStream::OpenWriter(const char* path, uint32_t poseCount, uint32_t keyframeInterval, Writer& writer)
+{
+	if (poseCount == 0 || poseCount > maxPoses || keyframeInterval == 0)
+	{
+		LOG(WARNING) << "A pose stream needs 1 to " << maxPoses << " poses, and a keyframe interval";
+		return false;
+	}
+
+	writer.file.open(path, std::ios::binary | std::ios::trunc);
+	if (!writer.file.is_open())
+	{
+		LOG(WARNING) << "Unable to create the pose stream " << path;
+		return false;
+	}
+
+	FileHeader header = {};
+	memcpy(header.magic, poseStreamMagic, sizeof(poseStreamMagic));
+	header.version = poseStreamVersion;
+	header.poseCount = poseCount;
+	header.keyframeInterval = keyframeInterval;
+	header.headerSize = sizeof(FileHeader);
+	writer.file.write((const char*)&header, sizeof(header));
+
+	writer.poseCount = poseCount;
+	writer.keyframeInterval = keyframeInterval;
+	writer.sampleCount = 0;
+	writer.block.clear();
+	writer.block.reserve(sizeof(BlockHeader) + keyframeInterval * poseStreamMaxSampleBytes);
+	writer.blockSamples = 0;
+	return true;
+}
+
+void PoseStream::CloseWriter(Writer& writer)
+{
+	if (!writer.file.is_open())
+		return;
+
+	PoseStreamFlushBlock(writer);
+	writer.file.seekp(offsetof(FileHeader, sampleCount));
+	writer.file.write((const char*)&writer.sampleCount, sizeof(writer.sampleCount));
+	writer.file.close();
+}
+
+bool PoseStream::IsOpen(const Writer& writer)
+{
+	return writer.file.is_open();
+}
+
+void PoseStream::WriteSample(Writer& writer, XrTime time, const XrPosef* poses, uint32_t validMask)
+{
+	if (!writer.file.is_open())
+		return;
+
+	// Start a new block with a keyframe: nothing to take deltas from
+	if (writer.blockSamples == 0)
+	{
+		BlockHeader header = {};
+		header.firstTime = time;
+		writer.block.resize(sizeof(BlockHeader));
+		memcpy(writer.block.data(), &header, sizeof(header));
+		writer.previousTime = time;
+		writer.hasPrevious = 0;
+	}
+
+	std::vector<uint8_t>& out = writer.block;
+	validMask &= (uint32_t)((1ull << writer.poseCount) - 1);
+	PoseStreamWriteSigned(out, time - writer.previousTime);
+	PoseStreamWriteVarint(out, validMask);
+	writer.previousTime = time;
+
+	for (uint32_t i = 0; i < writer.poseCount; i++)
+	{
+		if ((validMask & (1u << i)) == 0)
+			continue;
+
+		uint64_t orientation = EncodeOrientation(poses[i].orientation);
+		for (uint32_t b = 0; b < poseStreamOrientationBytes; b++)
+			out.push_back((uint8_t)(orientation >> (b * 8)));
+
+		int32_t position[3] = { EncodePosition(poses[i].position.x), EncodePosition(poses[i].position.y), EncodePosition(poses[i].position.z) };
+		bool hasPrevious = (writer.hasPrevious & (1u << i)) != 0;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			PoseStreamWriteSigned(out, hasPrevious ? (int64_t)position[axis] - writer.previousPosition[i][axis] : position[axis]);
+			writer.previousPosition[i][axis] = position[axis];
+		}
+		writer.hasPrevious |= 1u << i;
+	}
+
+	writer.sampleCount++;
+	if (++writer.blockSamples >= writer.keyframeInterval)
+		PoseStreamFlushBlock(writer);
+}
+
+void PoseStreamStartBlock(Reader& reader, size_t blockIndex)
+{
+	const uint8_t* block = reader.file.data + reader.blockOffsets[blockIndex];
+	const BlockHeader* header = (const BlockHeader*)block;
+	reader.nextBlock = blockIndex + 1;
+	reader.cursor = block + sizeof(BlockHeader);
+	reader.blockEnd = block + header->size;
+	reader.blockSamplesLeft = header->sampleCount;
+	reader.previousTime = header->firstTime;
+	reader.hasPrevious = 0;
+}
+
+bool PoseStream::OpenReader(const char* path, Reader& reader)
+{
+	if (!Platform::OpenMappedFile(path, false, reader.file))
+	{
+		LOG(WARNING) << "Unable to open the pose stream " << path;
+		return false;
+	}
+
+	reader.header = (const FileHeader*)reader.file.data;
+	if (reader.file.size < sizeof(FileHeader) ||
+		memcmp(reader.header->magic, poseStreamMagic, sizeof(poseStreamMagic)) != 0 ||
+		reader.header->version != poseStreamVersion ||
+		reader.header->headerSize < sizeof(FileHeader) ||
+		reader.header->poseCount == 0 || reader.header->poseCount > maxPoses)
+	{
+		LOG(WARNING) << path << " isn't a pose stream, or is from a different version";
+		CloseReader(reader);
+		return false;
+	}
+
+	// Index the blocks, stopping at the first one that was cut short
+	reader.blockOffsets.clear();
+	reader.blockTimes.clear();
+	uint64_t offset = reader.header->headerSize;
+	while (offset + sizeof(BlockHeader) <= reader.file.size)
+	{
+		BlockHeader header;
+		memcpy(&header, reader.file.data + offset, sizeof(header));
+		if (header.size < sizeof(BlockHeader) || header.sampleCount == 0 || offset + header.size > reader.file.size)
+			break;
+		reader.blockOffsets.push_back(offset);
+		reader.blockTimes.push_back(header.firstTime);
+		offset += header.size;
+	}
+
+	reader.nextBlock = 0;
+	reader.cursor = nullptr;
+	reader.blockEnd = nullptr;
+	reader.blockSamplesLeft = 0;
+	return true;
+}
+
+void PoseStream::CloseReader(Reader& reader)
+{
+	Platform::CloseMappedFile(reader.file);
+	reader.header = nullptr;
+	reader.blockOffsets.clear();
+	reader.blockTimes.clear();
+	reader.blockSamplesLeft = 0;
+}
+
+uint32_t PoseStream::GetPoseCount(const Reader& reader)
+{
+	return reader.header != nullptr ? reader.header->poseCount : 0;
+}
+
+bool PoseStream::ReadSample(Reader& reader, XrTime& time, XrPosef* poses, uint32_t& validMask)
+{
+	if (reader.blockSamplesLeft == 0)
+	{
+		if (reader.nextBlock >= reader.blockOffsets.size())
+			return false;
+		PoseStreamStartBlock(reader, reader.nextBlock);
+	}
+
+	const uint8_t*& in = reader.cursor;
+	int64_t timeDelta = 0;
+	uint64_t mask = 0;
+	if (!PoseStreamReadSigned(in, reader.blockEnd, timeDelta) || !PoseStreamReadVarint(in, reader.blockEnd, mask))
+		return false;
+	time = reader.previousTime + timeDelta;
+	validMask = (uint32_t)mask;
+	reader.previousTime = time;
+
+	for (uint32_t i = 0; i < reader.header->poseCount; i++)
+	{
+		if ((validMask & (1u << i)) == 0)
+		{
+			poses[i] = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+			continue;
+		}
+
+		if ((size_t)(reader.blockEnd - in) < poseStreamOrientationBytes)
+			return false;
+		uint64_t orientation = 0;
+		for (uint32_t b = 0; b < poseStreamOrientationBytes; b++)
+			orientation |= (uint64_t)*in++ << (b * 8);
+		poses[i].orientation = DecodeOrientation(orientation);
+
+		bool hasPrevious = (reader.hasPrevious & (1u << i)) != 0;
+		float decoded[3];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			int64_t value = 0;
+			if (!PoseStreamReadSigned(in, reader.blockEnd, value))
+				return false;
+			int32_t position = (int32_t)(hasPrevious ? reader.previousPosition[i][axis] + value : value);
+			reader.previousPosition[i][axis] = position;
+			decoded[axis] = DecodePosition(position);
+		}
+		poses[i].position = { decoded[0], decoded[1], decoded[2] };
+		reader.hasPrevious |= 1u << i;
+	}
+
+	reader.blockSamplesLeft--;
+	return true;
+}
+
+void PoseStream::Seek(Reader& reader, XrTime time)
+{
+	if (reader.blockTimes.empty())
+		return;
+
+	// The last block starting at or before time
+	auto after = std::upper_bound(reader.blockTimes.begin(), reader.blockTimes.end(), time);
+	size_t blockIndex = after == reader.blockTimes.begin() ? 0 : (size_t)(after - reader.blockTimes.begin()) - 1;
+	PoseStreamStartBlock(reader, blockIndex);
+}
+
+// Rotation about y then x, which is enough to look around with
+XrQuaternionf PoseStreamYawPitch(float yaw, float pitch)
+{
+	float cy = cosf(yaw * 0.5f), sy = sinf(yaw * 0.5f);
+	float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+	return { cy * sp, sy * cp, -sy * sp, cy * cp };
+}
+
+void PoseStream::RunBenchmark()
+{
+	const uint32_t sampleRate = 90;
+	const uint32_t sampleCount = sampleRate * 60 * 60;
+	const uint32_t poseCount = 4;		// Two views and two hands, as FrameCapture records
+	const uint32_t keyframeInterval = 90;
+	const uint32_t seekCount = 1000;
+	const XrTime startTime = 1000000000;
+	const XrTime samplePeriod = 1000000000 / sampleRate;
+	const char* path = "pose_benchmark.xrposes";
+
+	// A head wandering about and looking around, with hands that move faster
+	// and drop out of tracking every so often
+	std::vector<XrPosef> poses((size_t)sampleCount * poseCount);
+	std::vector<uint32_t> masks(sampleCount);
+	for (uint32_t s = 0; s < sampleCount; s++)
+	{
+		float t = (float)s / sampleRate;
+		XrPosef* sample = &poses[(size_t)s * poseCount];
+		XrVector3f head = { 0.3f * sinf(0.1f * t), 1.6f + 0.05f * sinf(0.7f * t), 0.3f * cosf(0.13f * t) };
+		XrQuaternionf look = PoseStreamYawPitch(0.8f * sinf(0.2f * t), 0.3f * sinf(0.31f * t));
+		masks[s] = 3;
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			float side = i == 0 ? -1.0f : 1.0f;
+			sample[i] = { look, { head.x + side * 0.032f, head.y, head.z } };
+			sample[2 + i] = {
+				PoseStreamYawPitch(1.2f * sinf(0.5f * t + i), 0.6f * sinf(1.1f * t + i)),
+				{ head.x + side * 0.25f, head.y - 0.3f + 0.2f * sinf(1.3f * t + i), head.z - 0.3f + 0.15f * sinf(0.9f * t + i) } };
+			if (sinf(0.05f * t + i) < 0.9f)
+				masks[s] |= 1u << (2 + i);
+		}
+	}
+
+	Writer writer;
+	if (!OpenWriter(path, poseCount, keyframeInterval, writer))
+		return;
+	uint64_t start = Platform::GetTimeNanoseconds();
+	for (uint32_t s = 0; s < sampleCount; s++)
+		WriteSample(writer, startTime + s * samplePeriod, &poses[(size_t)s * poseCount], masks[s]);
+	CloseWriter(writer);
+	uint64_t writeNanoseconds = Platform::GetTimeNanoseconds() - start;
+
+	Reader reader;
+	if (!OpenReader(path, reader))
+	{
+		remove(path);
+		return;
+	}
+
+	// Read everything back, and compare it with what went in
+	uint64_t storedPoses = 0;
+	uint32_t samplesRead = 0, wrongSamples = 0;
+	double positionErrorSum = 0.0;
+	float maxPositionError = 0.0f, maxOrientationError = 0.0f;
+	XrPosef decoded[poseCount];
+	start = Platform::GetTimeNanoseconds();
+	XrTime time;
+	uint32_t validMask;
+	while (samplesRead < sampleCount && ReadSample(reader, time, decoded, validMask))
+	{
+		const XrPosef* sample = &poses[(size_t)samplesRead * poseCount];
+		if (time != startTime + samplesRead * samplePeriod || validMask != masks[samplesRead])
+			wrongSamples++;
+		for (uint32_t i = 0; i < poseCount; i++)
+		{
+			if ((validMask & (1u << i)) == 0)
+				continue;
+			storedPoses++;
+			const XrVector3f& a = sample[i].position;
+			const XrVector3f& b = decoded[i].position;
+			float error = std::max(std::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), fabsf(a.z - b.z));
+			maxPositionError = std::max(maxPositionError, error);
+			positionErrorSum += error;
+
+			// q and -q are the same rotation, so flip q to p's side first. The
+			// angle comes from the distance between them, since acos of a dot
+			// product this close to 1 can't tell small angles apart.
+			const XrQuaternionf& p = sample[i].orientation;
+			const XrQuaternionf& q = decoded[i].orientation;
+			double side = p.x * q.x + p.y * q.y + p.z * q.z + p.w * q.w < 0.0f ? -1.0 : 1.0;
+			double dx = p.x - side * q.x, dy = p.y - side * q.y, dz = p.z - side * q.z, dw = p.w - side * q.w;
+			double angle = 4.0 * asin(std::min(sqrt(dx * dx + dy * dy + dz * dz + dw * dw) * 0.5, 1.0));
+			maxOrientationError = std::max(maxOrientationError, (float)(angle * 57.29577951));
+		}
+		samplesRead++;
+	}
+	uint64_t readNanoseconds = Platform::GetTimeNanoseconds() - start;
+
+	// Jumping about in the recording, as scrubbing through a replay would
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pickSample(0, sampleCount - 1);
+	start = Platform::GetTimeNanoseconds();
+	uint32_t seekMisses = 0;
+	for (uint32_t i = 0; i < seekCount; i++)
+	{
+		XrTime target = startTime + pickSample(random) * samplePeriod;
+		Seek(reader, target);
+		if (!ReadSample(reader, time, decoded, validMask) || time > target || target - time >= keyframeInterval * samplePeriod)
+			seekMisses++;
+	}
+	uint64_t seekNanoseconds = Platform::GetTimeNanoseconds() - start;
+
+	uint64_t fileSize = reader.file.size;
+	CloseReader(reader);
+	remove(path);
+
+	LOG(INFO) << "Pose stream of " << sampleCount << " samples, " << storedPoses << " poses: " << fileSize / (1024.0 * 1024.0) << "MB, "
+		<< (double)fileSize / storedPoses << " bytes per pose (" << sizeof(XrPosef) << " raw), write "
+		<< (double)writeNanoseconds / storedPoses << "ns per pose, read " << (double)readNanoseconds / storedPoses << "ns per pose, Seek "
+		<< (double)seekNanoseconds / seekCount / 1000.0 << "us";
+	LOG(INFO) << "Pose stream error: position " << maxPositionError * 1000.0f << "mm worst, " << positionErrorSum / storedPoses * 1000.0
+		<< "mm mean, orientation " << maxOrientationError << " degrees worst, " << samplesRead << " of " << sampleCount << " samples read, "
+		<< wrongSamples << " with the wrong time or mask, " << seekMisses << " bad seeks";
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Platform.h"
+
+#include "openxr/openxr.h"
+
+#include <fstream>
+#include <vector>
+
+// A compact file format for long recordings of poses, like the head and hands
+// over an hour long soak test. A raw XrPosef is 28 bytes, and at 90Hz that
+// adds up quickly. Here a pose is usually 9 or 10 bytes:
+//
+//  - Orientations use "smallest three": drop the largest quaternion
+//    component (it can be rebuilt, since the quaternion is unit length) and
+//    store the other three as 15 bits each, plus 2 bits saying which one was
+//    dropped. That's 6 bytes.
+//  - Positions are rounded to a tenth of a millimeter, and stored as the
+//    change from the previous sample, as varints. Something moving under
+//    6mm per axis per sample takes a byte per axis.
+//  - Times are varints of the change from the previous sample.
+//
+// Error is bounded, and doesn't build up over a recording, since deltas are
+// taken between the already rounded values:
+//  - Position: 0.05mm per axis, plus whatever float rounding there was.
+//  - Orientation: at most 0.01 degrees.
+//
+// Samples are grouped into blocks. The first sample in a block is a
+// keyframe, with absolute positions, so a reader can start decoding at any
+// block. That's how Seek works.
+namespace PoseStream
+{
+	// Up to this many poses per sample, e.g. two views and two hands
+	const uint32_t maxPoses = 32;
+
+	struct FileHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	poseCount;			// Poses in each sample
+		uint32_t	keyframeInterval;	// Samples per block
+		uint32_t	headerSize;
+		uint64_t	sampleCount;		// Filled in when the writer is closed
+	};
+
+	struct BlockHeader
+	{
+		uint32_t	size;				// In bytes, including this header
+		uint32_t	sampleCount;
+		XrTime		firstTime;
+	};
+
+	struct Writer
+	{
+		std::ofstream			file;
+		uint32_t				poseCount;
+		uint32_t				keyframeInterval;
+		uint64_t				sampleCount;
+
+		std::vector<uint8_t>	block;			// The block being built, written out when full
+		uint32_t				blockSamples;
+		XrTime					previousTime;
+		uint32_t				hasPrevious;	// Bit per pose, set once it has a position to delta from
+		int32_t					previousPosition[maxPoses][3];
+	};
+
+	struct Reader
+	{
+		MappedFile				file;
+		const FileHeader*		header;
+		std::vector<uint64_t>	blockOffsets;	// Built on open, walking the blocks
+		std::vector<XrTime>		blockTimes;
+
+		size_t					nextBlock;
+		const uint8_t*			cursor;
+		const uint8_t*			blockEnd;
+		uint32_t				blockSamplesLeft;
+		XrTime					previousTime;
+		uint32_t				hasPrevious;
+		int32_t					previousPosition[maxPoses][3];
+	};
+
+	bool		OpenWriter(const char* path, uint32_t poseCount, uint32_t keyframeInterval, Writer& writer);
+	void		CloseWriter(Writer& writer);
+	bool		IsOpen(const Writer& writer);
+
+	// validMask has a bit set for each pose that's valid this sample. Invalid
+	// poses aren't stored, and read back as the identity.
+	void		WriteSample(Writer& writer, XrTime time, const XrPosef* poses, uint32_t validMask);
+
+	// The reader maps the whole file. It copes with files that were never
+	// closed, up to the last complete block.
+	bool		OpenReader(const char* path, Reader& reader);
+	void		CloseReader(Reader& reader);
+	uint32_t	GetPoseCount(const Reader& reader);
+
+	// Returns false at the end of the stream
+	bool		ReadSample(Reader& reader, XrTime& time, XrPosef* poses, uint32_t& validMask);
+
+	// Positions the reader at the start of the block holding time, so the next
+	// ReadSample returns the keyframe at or before it.
+	void		Seek(Reader& reader, XrTime time);
+
+	// Encoding of single values. These are what the reader and writer are
+	// built from, and are exposed to measure the error bounds above.
+	uint64_t	EncodeOrientation(const XrQuaternionf& orientation);
+	XrQuaternionf	DecodeOrientation(uint64_t encoded);
+	int32_t		EncodePosition(float meters);
+	float		DecodePosition(int32_t encoded);
+
+	// Writes an hour of generated head and hand poses at 90Hz, reads them
+	// back, and logs how long each took per pose, how big the file was, and
+	// the worst error against the error bounds above. Also times Seek.
+	void		RunBenchmark();
+}
@@ -0,0 +1,162 @@
+#include "PredictionAnalyzer.h"
+#include "OpenXR.h"
+#include "FrameTelemetry.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <atomic>
+#include <math.h>
+#include <thread>
+
+using namespace PredictionAnalyzer;
+
+constexpr int32_t predictionMaxTracked = 8;
+
+// Must be a power of two. This holds everything predicted during the settle
+// time, with plenty to spare.
+constexpr uint32_t predictionQueueSize = 1024;
+
+struct PredictionTracked
+{
+	XrSpace							space;
+	FrameTelemetry::HistogramID		positionError;	// Micrometers
+	FrameTelemetry::HistogramID		angleError;		// Thousandths of a degree
+};
+
+struct PredictionEntry
+{
+	TrackedID	tracked;
+	XrTime		time;
+	XrPosef		pose;
+};
+
+PredictionTracked			predictionTracked[predictionMaxTracked];
+int32_t						predictionTrackedCount = 0;
+XrSpace						predictionBaseSpace = XR_NULL_HANDLE;
+XrDuration					predictionSettleTime = defaultSettleTime;
+
+// Single producer, single consumer, the same as the input sampler's queue.
+// Predicted times only go forward, so the oldest entry is always the next
+// one to settle.
+PredictionEntry				predictionQueue[predictionQueueSize];
+std::atomic<uint64_t>		predictionWritePos = { 0 };
+std::atomic<uint64_t>		predictionReadPos = { 0 };
+
+std::thread					predictionThread;
+std::atomic<bool>			predictionRunning = { false };
+FrameTelemetry::CounterID	predictionChecked = -1;
+FrameTelemetry::CounterID	predictionDropped = -1;
+
+TrackedID PredictionAnalyzer::Track(XrSpace space, const char* positionName, const char* angleName)
+{
+	if (predictionRunning || predictionTrackedCount == predictionMaxTracked)
+		return -1;
+
+	PredictionTracked& tracked = predictionTracked[predictionTrackedCount];
+	tracked.space = space;
+	tracked.positionError = FrameTelemetry::RegisterHistogram(positionName, 1000.0, "mm");
+	tracked.angleError = FrameTelemetry::RegisterHistogram(angleName, 1000.0, " deg");
+	return predictionTrackedCount++;
+}
+
+double PredictionAnalyzer::AngleBetween(const XrQuaternionf& a, const XrQuaternionf& b)
+{
+	// The rotation from a to b is conj(a) * b. Its vector part has length
+	// sin(angle / 2), and its w is cos(angle / 2), so atan2 stays precise
+	// where acos(w) would round small angles away.
+	double x = (double)a.w * b.x - (double)a.x * b.w - (double)a.y * b.z + (double)a.z * b.y;
+	double y = (double)a.w * b.y + (double)a.x * b.z - (double)a.y * b.w - (double)a.z * b.x;
+	double z = (double)a.w * b.z - (double)a.x * b.y + (double)a.y * b.x - (double)a.z * b.w;
+	double w = (double)a.w * b.w + (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	return 2.0 * atan2(sqrt(x * x + y * y + z * z), fabs(w)) * (180.0 / 3.14159265358979323846);
+}
+
+void PredictionCheck(const PredictionEntry& entry)
+{
+	const PredictionTracked& tracked = predictionTracked[entry.tracked];
+	XrSpaceLocation location = { XR_TYPE_SPACE_LOCATION };
+	if (XR_FAILED(xrLocateSpace(tracked.space, predictionBaseSpace, entry.time, &location)))
+		return;
+
+	const XrSpaceLocationFlags validFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+	if ((location.locationFlags & validFlags) != validFlags)
+		return;
+
+	double dx = (double)location.pose.position.x - entry.pose.position.x;
+	double dy = (double)location.pose.position.y - entry.pose.position.y;
+	double dz = (double)location.pose.position.z - entry.pose.position.z;
+	double positionError = sqrt(dx * dx + dy * dy + dz * dz);
+	double angleError = AngleBetween(entry.pose.orientation, location.pose.orientation);
+
+	FrameTelemetry::Record(tracked.positionError, (int64_t)(positionError * 1000000.0 + 0.5));
+	FrameTelemetry::Record(tracked.angleError, (int64_t)(angleError * 1000.0 + 0.5));
+	FrameTelemetry::Add(predictionChecked);
+}
+
+bool PredictionAnalyzer::Start(XrSpace baseSpace, XrDuration settleTime)
+{
+	if (predictionRunning || predictionTrackedCount == 0)
+		return false;
+
+	predictionBaseSpace = baseSpace;
+	predictionSettleTime = settleTime;
+	predictionChecked = FrameTelemetry::RegisterCounter("Prediction checks");
+	predictionDropped = FrameTelemetry::RegisterCounter("Prediction checks dropped");
+	predictionRunning = true;
+	predictionThread = std::thread([]()
+	{
+		Platform::SetCurrentThreadName("Prediction Analyzer");
+		Platform::SetCurrentThreadPriority(ThreadPriority::Low);
+		PROFILE_THREAD_NAME("Prediction Analyzer");
+
+		// Nothing here is urgent, so checking a few times a frame is plenty
+		while (predictionRunning)
+		{
+			XrTime settled = OpenXR::GetCurrentXrTime() - predictionSettleTime;
+			uint64_t readPos = predictionReadPos.load(std::memory_order_relaxed);
+			while (readPos != predictionWritePos.load(std::memory_order_acquire))
+			{
+				const PredictionEntry& entry = predictionQueue[readPos & (predictionQueueSize - 1)];
+				if (entry.time > settled)
+					break;
+				PredictionCheck(entry);
+				predictionReadPos.store(++readPos, std::memory_order_release);
+			}
+			Platform::SleepMilliseconds(5);
+		}
+	});
+
+	LOG(INFO) << "Checking pose predictions for " << predictionTrackedCount << " spaces, "
+		<< settleTime / 1000000 << "ms after the fact";
+	return true;
+}
+
+void PredictionAnalyzer::Stop()
+{
+	if (!predictionRunning)
+		return;
+	predictionRunning = false;
+	predictionThread.join();
+}
+
+bool PredictionAnalyzer::IsRunning()
+{
+	return predictionRunning.load(std::memory_order_relaxed);
+}
+
+void PredictionAnalyzer::RecordPrediction(TrackedID tracked, XrTime time, const XrPosef& pose)
+{
+	if (tracked < 0 || !IsRunning())
+		return;
+
+	uint64_t writePos = predictionWritePos.load(std::memory_order_relaxed);
+	if (writePos - predictionReadPos.load(std::memory_order_acquire) >= predictionQueueSize)
+	{
+		FrameTelemetry::Add(predictionDropped);
+		return;
+	}
+	predictionQueue[writePos & (predictionQueueSize - 1)] = { tracked, time, pose };
+	predictionWritePos.store(writePos + 1, std::memory_order_release);
+}
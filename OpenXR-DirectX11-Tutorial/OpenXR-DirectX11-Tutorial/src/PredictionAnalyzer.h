@@ -0,0 +1,36 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+
+// Measures how good the runtime's pose prediction is. The frame loop hands
+// over every pose it located for a predicted display time, and once that time
+// has come and gone a background thread locates the same space at the same
+// time again. By then the runtime knows where the space really was, so the
+// difference is the prediction error.
+//
+// Position and angle errors go into a pair of FrameTelemetry histograms per
+// tracked space, and come out with the rest of the telemetry.
+namespace PredictionAnalyzer
+{
+	typedef int32_t TrackedID;
+
+	// How long after a predicted time we wait before asking again. Runtimes
+	// keep some history, but not forever.
+	const XrDuration	defaultSettleTime = 50 * 1000000;
+
+	// Spaces must be tracked before Start. The names go to the histograms,
+	// so they must be string literals.
+	TrackedID	Track(XrSpace space, const char* positionName, const char* angleName);
+
+	bool		Start(XrSpace baseSpace, XrDuration settleTime = defaultSettleTime);
+	void		Stop();
+	bool		IsRunning();
+
+	// Frame loop side
+	void		RecordPrediction(TrackedID tracked, XrTime time, const XrPosef& pose);
+
+	// Angle between two orientations in degrees, precise for small angles
+	double		AngleBetween(const XrQuaternionf& a, const XrQuaternionf& b);
+}
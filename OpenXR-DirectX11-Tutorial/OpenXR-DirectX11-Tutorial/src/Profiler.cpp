@@ -0,0 +1,261 @@
+// The profiler is always built, so --profiler-benchmark can compare against
+// it in any configuration. Nothing calls it unless ENABLE_PROFILER is defined
+// where the PROFILE_ macros are used.
+#if !defined(ENABLE_PROFILER)
+#define ENABLE_PROFILER
+#endif
+#include "Profiler.h"
+#include "Histogram.h"
+#include "Platform.h"
+#include "ProfilerBenchmark.h"
+
+#include "easylogging++.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class ProfilerEventType : uint32_t
+{
+	Zone,
+	Counter,
+	FrameMark,
+	ThreadName,
+};
+
+struct ProfilerEvent
+{
+	const char*			name;
+	uint64_t			time;
+	int64_t				value;		// Duration for zones, the value for counters, frame index for frame marks
+	ProfilerEventType	type;
+};
+
+// Must be a power of two. At 32 bytes an event, this is 512KB per thread,
+// which is plenty to cover the time between flushes.
+constexpr uint32_t profilerBufferSize = 16384;
+
+// A single producer, single consumer ring. Only the owning thread moves head,
+// and only the flush thread moves tail.
+struct ProfilerThreadBuffer
+{
+	ProfilerEvent			events[profilerBufferSize];
+	std::atomic<uint32_t>	head = { 0 };
+	std::atomic<uint32_t>	tail = { 0 };
+	std::atomic<uint32_t>	dropped = { 0 };
+	uint32_t				threadID = 0;
+};
+
+std::mutex										profilerBuffersLock;
+std::vector<std::unique_ptr<ProfilerThreadBuffer>> profilerBuffers;
+std::thread										profilerFlushThread;
+std::atomic<bool>								profilerRunning = { false };
+std::ofstream									profilerFile;
+bool											profilerFirstEvent = true;
+uint64_t										profilerOrigin = 0;
+std::atomic<int64_t>							profilerFrameIndex = { 0 };
+
+ProfilerThreadBuffer* ProfilerGetThreadBuffer()
+{
+	// Registration takes the lock, but only happens once per thread
+	thread_local ProfilerThreadBuffer* threadBuffer = nullptr;
+	if (threadBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(profilerBuffersLock);
+		profilerBuffers.push_back(std::make_unique<ProfilerThreadBuffer>());
+		threadBuffer = profilerBuffers.back().get();
+		threadBuffer->threadID = (uint32_t)profilerBuffers.size();
+	}
+	return threadBuffer;
+}
+
+void ProfilerPush(const char* name, uint64_t time, int64_t value, ProfilerEventType type)
+{
+	ProfilerThreadBuffer* buffer = ProfilerGetThreadBuffer();
+	uint32_t head = buffer->head.load(std::memory_order_relaxed);
+	uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+	if (head - tail >= profilerBufferSize)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[head & (profilerBufferSize - 1)] = { name, time, value, type };
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void ProfilerWriteEvent(uint32_t threadID, const ProfilerEvent& profilerEvent)
+{
+	profilerFile << (profilerFirstEvent ? "" : ",\n");
+	profilerFirstEvent = false;
+
+	double timestamp = (double)(int64_t)(profilerEvent.time - profilerOrigin) / 1000.0;
+	switch (profilerEvent.type)
+	{
+	case ProfilerEventType::Zone:
+		profilerFile << "{\"name\":\"" << profilerEvent.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadID
+			<< ",\"ts\":" << timestamp << ",\"dur\":" << profilerEvent.value / 1000.0 << "}";
+		break;
+	case ProfilerEventType::Counter:
+		profilerFile << "{\"name\":\"" << profilerEvent.name << "\",\"ph\":\"C\",\"pid\":1,\"tid\":" << threadID
+			<< ",\"ts\":" << timestamp << ",\"args\":{\"value\":" << profilerEvent.value << "}}";
+		break;
+	case ProfilerEventType::FrameMark:
+		profilerFile << "{\"name\":\"Frame " << profilerEvent.value << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":" << threadID
+			<< ",\"ts\":" << timestamp << "}";
+		break;
+	case ProfilerEventType::ThreadName:
+		profilerFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadID
+			<< ",\"args\":{\"name\":\"" << profilerEvent.name << "\"}}";
+		break;
+	}
+}
+
+void ProfilerFlush()
+{
+	std::lock_guard<std::mutex> lock(profilerBuffersLock);
+	for (std::unique_ptr<ProfilerThreadBuffer>& buffer : profilerBuffers)
+	{
+		uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+		uint32_t head = buffer->head.load(std::memory_order_acquire);
+		for (; tail != head; tail++)
+			ProfilerWriteEvent(buffer->threadID, buffer->events[tail & (profilerBufferSize - 1)]);
+		buffer->tail.store(tail, std::memory_order_release);
+	}
+}
+
+bool Profiler::Start(const char* path)
+{
+	profilerFile.open(path, std::ios::trunc);
+	if (!profilerFile.is_open())
+	{
+		LOG(WARNING) << "Unable to open the profiler trace " << path;
+		return false;
+	}
+
+	profilerOrigin = Now();
+	profilerFirstEvent = true;
+	profilerFile << "{\"traceEvents\":[\n";
+
+	profilerRunning = true;
+	profilerFlushThread = std::thread([]()
+	{
+		Platform::SetCurrentThreadName("Profiler Flush");
+		Platform::SetCurrentThreadPriority(ThreadPriority::Low);
+		while (profilerRunning)
+		{
+			ProfilerFlush();
+			Platform::SleepMilliseconds(10);
+		}
+	});
+	return true;
+}
+
+void Profiler::Stop()
+{
+	if (!profilerRunning)
+		return;
+
+	profilerRunning = false;
+	profilerFlushThread.join();
+	ProfilerFlush();
+
+	// Let whoever reads the trace know if it's missing anything
+	uint32_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(profilerBuffersLock);
+		for (std::unique_ptr<ProfilerThreadBuffer>& buffer : profilerBuffers)
+			dropped += buffer->dropped.load();
+	}
+	profilerFile << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << dropped << "}}\n";
+	profilerFile.close();
+
+	if (dropped > 0)
+		LOG(WARNING) << "Profiler dropped " << dropped << " events";
+}
+
+void Profiler::Counter(const char* name, int64_t value)
+{
+	ProfilerPush(name, Now(), value, ProfilerEventType::Counter);
+}
+
+void Profiler::FrameMark()
+{
+	ProfilerPush("Frame", Now(), profilerFrameIndex++, ProfilerEventType::FrameMark);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ProfilerPush(name, Now(), 0, ProfilerEventType::ThreadName);
+}
+
+void Profiler::RecordZone(const char* name, uint64_t start, uint64_t end)
+{
+	ProfilerPush(name, start, (int64_t)(end - start), ProfilerEventType::Zone);
+}
+
+uint64_t Profiler::Now()
+{
+	return Platform::GetTimeNanoseconds();
+}
+
+void Profiler::RunBenchmark()
+{
+	const uint32_t valueCount = 64 * 1024;
+	const uint32_t frameCount = 1000;
+	const char* path = "profiler_benchmark.json";
+
+	// Every marker in a frame: the frame zone, a zone per block, a counter
+	// every 16 blocks and the frame mark
+	const uint32_t blockCount = valueCount / 64;
+	const uint32_t markersPerFrame = 1 + blockCount + blockCount / 16 + 1;
+
+	if (profilerRunning)
+	{
+		LOG(WARNING) << "The profiler is already recording, so it can't be benchmarked";
+		return;
+	}
+	if (!Start(path))
+		return;
+
+	// The three versions take turns, frame by frame, so they all see the
+	// machine in the same state. The recording version's events are flushed
+	// between frames, outside the timing, so its buffer never fills and
+	// every event is really recorded.
+	std::vector<float> values(valueCount, 1.0f);
+	Histogram::Distribution unmarked = {}, compiledOut = {}, compiledIn = {};
+	float sum = 0.0f;
+	for (uint32_t f = 0; f < frameCount; f++)
+	{
+		uint64_t start = Now();
+		sum += ProfilerBenchmark::RunFrameUnmarked(values.data(), valueCount);
+		uint64_t unmarkedEnd = Now();
+		sum += ProfilerBenchmark::RunFrameOff(values.data(), valueCount);
+		uint64_t compiledOutEnd = Now();
+		sum += ProfilerBenchmarkFrame(values.data(), valueCount);
+		uint64_t compiledInEnd = Now();
+		ProfilerFlush();
+
+		Histogram::Add(unmarked, (int64_t)(unmarkedEnd - start));
+		Histogram::Add(compiledOut, (int64_t)(compiledOutEnd - unmarkedEnd));
+		Histogram::Add(compiledIn, (int64_t)(compiledInEnd - compiledOutEnd));
+	}
+	Stop();
+	remove(path);
+
+	LOG(INFO) << "Profiler benchmark, " << markersPerFrame << " markers a frame, frame times:";
+	Histogram::Log(unmarked, "No markers", 1000.0, "us");
+	Histogram::Log(compiledOut, "Profiler compiled out", 1000.0, "us");
+	Histogram::Log(compiledIn, "Profiler compiled in and recording", 1000.0, "us");
+
+	double unmarkedMean = (double)unmarked.total / unmarked.count;
+	double compiledOutMean = (double)compiledOut.total / compiledOut.count;
+	double compiledInMean = (double)compiledIn.total / compiledIn.count;
+	LOG(INFO) << "Compiled out, a frame takes " << compiledOutMean / unmarkedMean * 100.0
+		<< "% of the time it takes with no markers. Compiled in, each marker costs " << (compiledInMean - unmarkedMean) / markersPerFrame
+		<< "ns. (Checksum " << sum << ")";
+}
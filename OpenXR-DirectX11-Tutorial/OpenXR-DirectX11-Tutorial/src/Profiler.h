@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+// Lightweight instrumentation for the frame loop. Define ENABLE_PROFILER to
+// turn it on; without it every macro below expands to nothing at all, so the
+// markers can stay in the hot paths for good.
+//
+// Events are written into a buffer owned by the thread that records them, so
+// recording never takes a lock. A background thread drains the buffers into a
+// Chrome trace file. If a buffer fills up before it's drained, events are
+// dropped and counted rather than blocking the frame.
+//
+// Zone and counter names must be string literals, only the pointer is stored.
+#if defined(ENABLE_PROFILER)
+
+#define PROFILE_CONCAT_INNER(a, b)		a##b
+#define PROFILE_CONCAT(a, b)			PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_START(path)				Profiler::Start(path)
+#define PROFILE_STOP()					Profiler::Stop()
+#define PROFILE_ZONE(name)				Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_COUNTER(name, value)	Profiler::Counter(name, (int64_t)(value))
+#define PROFILE_FRAME_MARK()			Profiler::FrameMark()
+#define PROFILE_THREAD_NAME(name)		Profiler::SetThreadName(name)
+
+namespace Profiler
+{
+	bool	Start(const char* path);
+	void	Stop();
+
+	void	Counter(const char* name, int64_t value);
+	void	FrameMark();
+	void	SetThreadName(const char* name);
+	void	RecordZone(const char* name, uint64_t start, uint64_t end);
+	uint64_t Now();
+
+	struct Zone
+	{
+		Zone(const char* name) : name(name), start(Now()) {}
+		~Zone() { RecordZone(name, start, Now()); }
+
+		const char*	name;
+		uint64_t	start;
+	};
+}
+
+#else
+
+#define PROFILE_START(path)
+#define PROFILE_STOP()
+#define PROFILE_ZONE(name)
+#define PROFILE_COUNTER(name, value)
+#define PROFILE_FRAME_MARK()
+#define PROFILE_THREAD_NAME(name)
+
+#endif
+
+namespace Profiler
+{
+	// Times the same marker dense frame with no markers, with the profiler
+	// compiled out and with it compiled in and recording, and logs the
+	// results. It's there whether or not ENABLE_PROFILER is defined.
+	void	RunBenchmark();
+}
@@ -0,0 +1,26 @@
+// Whatever the build says, the profiler is compiled out of this file, so
+// there's something to hold the compiled in version against
+#undef ENABLE_PROFILER
+#include "Profiler.h"
+#include "ProfilerBenchmark.h"
+
+float ProfilerBenchmark::RunFrameOff(float* values, uint32_t count)
+{
+	return ProfilerBenchmarkFrame(values, count);
+}
+
+// The loop ProfilerBenchmarkFrame is, written out without any markers
+float ProfilerBenchmark::RunFrameUnmarked(float* values, uint32_t count)
+{
+	float sum = 0.0f;
+	for (uint32_t begin = 0; begin < count; begin += 64)
+	{
+		uint32_t end = begin + 64 < count ? begin + 64 : count;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			values[i] = values[i] * 0.999f + 0.001f;
+			sum += values[i];
+		}
+	}
+	return sum;
+}
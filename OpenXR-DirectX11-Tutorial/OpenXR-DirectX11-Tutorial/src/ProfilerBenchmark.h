@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// The frame --profiler-benchmark times. It's written once, here, and compiled
+// twice: by Profiler.cpp with the profiler compiled in, and by
+// ProfilerBenchmark.cpp with it compiled out, so the only difference between
+// the two is what the PROFILE_ macros turned into. Include Profiler.h first.
+namespace ProfilerBenchmark
+{
+	// With the profiler compiled out, and the same loop with no markers at all
+	float	RunFrameOff(float* values, uint32_t count);
+	float	RunFrameUnmarked(float* values, uint32_t count);
+}
+
+// Marked up more densely than anything in the real frame loop: a zone every
+// 64 values, a counter every 1024, and a zone and a frame mark around the
+// lot. Returns a sum so none of it can be optimised away. It's static so each
+// file that includes it gets its own copy.
+static float ProfilerBenchmarkFrame(float* values, uint32_t count)
+{
+	PROFILE_ZONE("Profiler benchmark frame");
+	float sum = 0.0f;
+	for (uint32_t begin = 0; begin < count; begin += 64)
+	{
+		PROFILE_ZONE("Profiler benchmark block");
+		uint32_t end = begin + 64 < count ? begin + 64 : count;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			values[i] = values[i] * 0.999f + 0.001f;
+			sum += values[i];
+		}
+		if ((begin & 1023) == 0)
+		{
+			PROFILE_COUNTER("Profiler benchmark sum", sum);
+		}
+	}
+	PROFILE_FRAME_MARK();
+	return sum;
+}
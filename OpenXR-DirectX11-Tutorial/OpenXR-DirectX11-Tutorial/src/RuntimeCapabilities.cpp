@@ -0,0 +1,187 @@
+#include "RuntimeCapabilities.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdlib.h>
+#include <unordered_map>
+
+// Bump this whenever the file layout changes, old caches are simply ignored
+constexpr int capabilityCacheVersion = 1;
+
+std::unordered_map<std::string, RuntimeCapabilitySnapshot>	capabilitySnapshots;
+std::string													capabilityLastUsedKey;
+bool														capabilitiesDirty = false;
+
+std::string MakeCapabilityKey(const std::string& runtimeName, XrVersion runtimeVersion)
+{
+	return runtimeName + "|" + std::to_string(runtimeVersion);
+}
+
+bool RuntimeCapabilities::Load(const char* path)
+{
+	capabilitySnapshots.clear();
+	capabilityLastUsedKey.clear();
+	capabilitiesDirty = false;
+
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	// The cache is a plain text file, one "keyword value" pair per line. A
+	// "runtime" line starts a new snapshot, and everything up to the next
+	// "runtime" line belongs to it. That keeps it easy to inspect by hand.
+	std::string line;
+	if (!std::getline(file, line) || line != "openxr-capabilities " + std::to_string(capabilityCacheVersion))
+		return false;
+
+	RuntimeCapabilitySnapshot current = {};
+	bool        hasCurrent = false;
+	std::string lastUsedName;
+	XrVersion   lastUsedVersion = 0;
+	auto storeCurrent = [&]()
+	{
+		if (hasCurrent)
+			capabilitySnapshots[MakeCapabilityKey(current.runtimeName, current.runtimeVersion)] = std::move(current);
+		current = {};
+		hasCurrent = false;
+	};
+
+	while (std::getline(file, line))
+	{
+		size_t split = line.find(' ');
+		if (split == std::string::npos)
+			continue;
+		std::string keyword = line.substr(0, split);
+		std::string value = line.substr(split + 1);
+
+		if (keyword == "runtime")
+		{
+			storeCurrent();
+			current.runtimeName = value;
+			hasCurrent = true;
+		}
+		else if (keyword == "version")
+			current.runtimeVersion = strtoull(value.c_str(), nullptr, 10);
+		else if (keyword == "system")
+			current.systemName = value;
+		else if (keyword == "ext")
+			current.extensions.insert(value);
+		else if (keyword == "view_config")
+			current.viewConfigurations.push_back((XrViewConfigurationType)strtol(value.c_str(), nullptr, 10));
+		else if (keyword == "blend")
+			current.blendModes.push_back((XrEnvironmentBlendMode)strtol(value.c_str(), nullptr, 10));
+		else if (keyword == "format")
+			current.swapchainFormats.insert(strtoll(value.c_str(), nullptr, 10));
+		else if (keyword == "last_runtime")
+			lastUsedName = value;
+		else if (keyword == "last_version")
+			lastUsedVersion = strtoull(value.c_str(), nullptr, 10);
+	}
+	storeCurrent();
+
+	capabilityLastUsedKey = MakeCapabilityKey(lastUsedName, lastUsedVersion);
+	return true;
+}
+
+bool RuntimeCapabilities::Save(const char* path)
+{
+	if (!capabilitiesDirty)
+		return true;
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG(WARNING) << "Unable to write the runtime capability cache to " << path;
+		return false;
+	}
+
+	file << "openxr-capabilities " << capabilityCacheVersion << "\n";
+	for (const auto& entry : capabilitySnapshots)
+	{
+		const RuntimeCapabilitySnapshot& snapshot = entry.second;
+		file << "runtime " << snapshot.runtimeName << "\n";
+		file << "version " << snapshot.runtimeVersion << "\n";
+		file << "system " << snapshot.systemName << "\n";
+		for (const std::string& extension : snapshot.extensions)
+			file << "ext " << extension << "\n";
+		for (XrViewConfigurationType viewConfiguration : snapshot.viewConfigurations)
+			file << "view_config " << (int)viewConfiguration << "\n";
+		for (XrEnvironmentBlendMode blendMode : snapshot.blendModes)
+			file << "blend " << (int)blendMode << "\n";
+		for (int64_t format : snapshot.swapchainFormats)
+			file << "format " << format << "\n";
+	}
+
+	auto lastUsed = capabilitySnapshots.find(capabilityLastUsedKey);
+	if (lastUsed != capabilitySnapshots.end())
+	{
+		file << "last_runtime " << lastUsed->second.runtimeName << "\n";
+		file << "last_version " << lastUsed->second.runtimeVersion << "\n";
+	}
+
+	capabilitiesDirty = false;
+	return true;
+}
+
+const RuntimeCapabilitySnapshot* RuntimeCapabilities::GetLastUsed()
+{
+	auto found = capabilitySnapshots.find(capabilityLastUsedKey);
+	return found == capabilitySnapshots.end() ? nullptr : &found->second;
+}
+
+RuntimeCapabilitySnapshot& RuntimeCapabilities::GetOrCreate(const char* runtimeName, XrVersion runtimeVersion)
+{
+	std::string key = MakeCapabilityKey(runtimeName, runtimeVersion);
+	if (capabilityLastUsedKey != key)
+	{
+		capabilityLastUsedKey = key;
+		capabilitiesDirty = true;
+	}
+
+	auto found = capabilitySnapshots.find(key);
+	if (found != capabilitySnapshots.end())
+		return found->second;
+
+	RuntimeCapabilitySnapshot& snapshot = capabilitySnapshots[key];
+	snapshot.runtimeName = runtimeName;
+	snapshot.runtimeVersion = runtimeVersion;
+	capabilitiesDirty = true;
+	return snapshot;
+}
+
+void RuntimeCapabilities::Remove(const char* runtimeName, XrVersion runtimeVersion)
+{
+	if (capabilitySnapshots.erase(MakeCapabilityKey(runtimeName, runtimeVersion)) > 0)
+		capabilitiesDirty = true;
+}
+
+void RuntimeCapabilities::MarkDirty()
+{
+	capabilitiesDirty = true;
+}
+
+void RuntimeCapabilities::ResetSystem(RuntimeCapabilitySnapshot& snapshot, const char* systemName)
+{
+	snapshot.systemName = systemName;
+	snapshot.viewConfigurations.clear();
+	snapshot.blendModes.clear();
+	snapshot.swapchainFormats.clear();
+	capabilitiesDirty = true;
+}
+
+bool RuntimeCapabilities::HasExtension(const RuntimeCapabilitySnapshot& snapshot, const char* extensionName)
+{
+	return snapshot.extensions.find(extensionName) != snapshot.extensions.end();
+}
+
+bool RuntimeCapabilities::HasViewConfiguration(const RuntimeCapabilitySnapshot& snapshot, XrViewConfigurationType viewConfiguration)
+{
+	return std::find(snapshot.viewConfigurations.begin(), snapshot.viewConfigurations.end(), viewConfiguration) != snapshot.viewConfigurations.end();
+}
+
+bool RuntimeCapabilities::HasSwapchainFormat(const RuntimeCapabilitySnapshot& snapshot, int64_t format)
+{
+	return snapshot.swapchainFormats.find(format) != snapshot.swapchainFormats.end();
+}
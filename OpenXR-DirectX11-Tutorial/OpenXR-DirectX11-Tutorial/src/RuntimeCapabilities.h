@@ -0,0 +1,45 @@
+#pragma once
+
+#include "OpenXR_setup.h"
+
+#include <openxr/openxr.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Everything we learn about a runtime by enumerating it. None of this changes
+// unless the runtime itself changes, so we keep it on disk keyed by the
+// runtime's name and version and skip the enumeration on the next launch.
+struct RuntimeCapabilitySnapshot
+{
+	std::string								runtimeName;
+	XrVersion								runtimeVersion;
+	std::unordered_set<std::string>			extensions;
+
+	// View configurations, blend modes and formats belong to the system (the
+	// headset) rather than the runtime, so they're dropped if the system changes.
+	std::string								systemName;
+	std::vector<XrViewConfigurationType>	viewConfigurations;
+	std::vector<XrEnvironmentBlendMode>		blendModes;
+	std::unordered_set<int64_t>				swapchainFormats;
+};
+
+namespace RuntimeCapabilities
+{
+	bool	Load(const char* path);
+	bool	Save(const char* path);
+
+	// The snapshot for the runtime we saw last time, which is our best guess at
+	// the runtime the loader is going to give us this time.
+	const RuntimeCapabilitySnapshot*	GetLastUsed();
+	RuntimeCapabilitySnapshot&			GetOrCreate(const char* runtimeName, XrVersion runtimeVersion);
+	void								Remove(const char* runtimeName, XrVersion runtimeVersion);
+	void								MarkDirty();
+
+	void	ResetSystem(RuntimeCapabilitySnapshot& snapshot, const char* systemName);
+
+	bool	HasExtension(const RuntimeCapabilitySnapshot& snapshot, const char* extensionName);
+	bool	HasViewConfiguration(const RuntimeCapabilitySnapshot& snapshot, XrViewConfigurationType viewConfiguration);
+	bool	HasSwapchainFormat(const RuntimeCapabilitySnapshot& snapshot, int64_t format);
+}
@@ -0,0 +1,936 @@
+#include "SceneBVH.h"
+#include "JobSystem.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+using namespace SceneBVH;
+
+// Below this many items, a subtree isn't worth making a job for
+constexpr uint32_t bvhParallelMinItems = 4096;
+
+// Traversal stacks are fixed size. A balanced tree of a million items is
+// about 30 deep, and a stack never holds more than the height plus one.
+constexpr uint32_t bvhStackSize = 128;
+
+Bounds BVHUnion(const Bounds& a, const Bounds& b)
+{
+	Bounds result;
+	result.min = { std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) };
+	result.max = { std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) };
+	return result;
+}
+
+bool BVHContains(const Bounds& outer, const Bounds& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+		&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+// Half the surface area, which is all the insertion cost needs
+float BVHArea(const Bounds& bounds)
+{
+	float x = bounds.max.x - bounds.min.x;
+	float y = bounds.max.y - bounds.min.y;
+	float z = bounds.max.z - bounds.min.z;
+	return x * y + y * z + z * x;
+}
+
+Bounds BVHFatten(const Bounds& bounds, float margin)
+{
+	Bounds result;
+	result.min = { bounds.min.x - margin, bounds.min.y - margin, bounds.min.z - margin };
+	result.max = { bounds.max.x + margin, bounds.max.y + margin, bounds.max.z + margin };
+	return result;
+}
+
+bool BVHIsLeaf(const Node& node)
+{
+	return node.left == nullNode;
+}
+
+uint32_t BVHAllocate(Tree& tree)
+{
+	if (tree.freeList == nullNode)
+	{
+		tree.nodes.push_back({});
+		return (uint32_t)tree.nodes.size() - 1;
+	}
+	uint32_t index = tree.freeList;
+	tree.freeList = tree.nodes[index].parent;
+	return index;
+}
+
+void BVHFree(Tree& tree, uint32_t index)
+{
+	tree.nodes[index].parent = tree.freeList;
+	tree.nodes[index].height = -1;
+	tree.freeList = index;
+}
+
+void BVHReplaceChild(Tree& tree, uint32_t parent, uint32_t oldChild, uint32_t newChild)
+{
+	if (parent == nullNode)
+	{
+		tree.root = newChild;
+		return;
+	}
+	if (tree.nodes[parent].left == oldChild)
+		tree.nodes[parent].left = newChild;
+	else
+		tree.nodes[parent].right = newChild;
+}
+
+// Rotates a grandchild up if one side of a is more than one level taller than
+// the other. Returns whichever node ends up where a was.
+uint32_t BVHBalance(Tree& tree, uint32_t iA)
+{
+	Node& A = tree.nodes[iA];
+	if (BVHIsLeaf(A) || A.height < 2)
+		return iA;
+
+	uint32_t iB = A.left;
+	uint32_t iC = A.right;
+	Node& B = tree.nodes[iB];
+	Node& C = tree.nodes[iC];
+	int32_t balance = C.height - B.height;
+
+	if (balance > 1)
+	{
+		// C moves up, and a takes whichever of C's children is shorter
+		uint32_t iF = C.left;
+		uint32_t iG = C.right;
+		Node& F = tree.nodes[iF];
+		Node& G = tree.nodes[iG];
+
+		C.left = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+		BVHReplaceChild(tree, C.parent, iA, iC);
+
+		if (F.height > G.height)
+		{
+			C.right = iF;
+			A.right = iG;
+			G.parent = iA;
+			A.bounds = BVHUnion(B.bounds, G.bounds);
+			C.bounds = BVHUnion(A.bounds, F.bounds);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else
+		{
+			C.right = iG;
+			A.right = iF;
+			F.parent = iA;
+			A.bounds = BVHUnion(B.bounds, F.bounds);
+			C.bounds = BVHUnion(A.bounds, G.bounds);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+		return iC;
+	}
+
+	if (balance < -1)
+	{
+		// The mirror image, with B moving up
+		uint32_t iD = B.left;
+		uint32_t iE = B.right;
+		Node& D = tree.nodes[iD];
+		Node& E = tree.nodes[iE];
+
+		B.left = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+		BVHReplaceChild(tree, B.parent, iA, iB);
+
+		if (D.height > E.height)
+		{
+			B.right = iD;
+			A.left = iE;
+			E.parent = iA;
+			A.bounds = BVHUnion(C.bounds, E.bounds);
+			B.bounds = BVHUnion(A.bounds, D.bounds);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else
+		{
+			B.right = iE;
+			A.left = iD;
+			D.parent = iA;
+			A.bounds = BVHUnion(C.bounds, D.bounds);
+			B.bounds = BVHUnion(A.bounds, E.bounds);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
+
+// Walks from a node to the root, rebalancing and refitting on the way
+void BVHFixUpwards(Tree& tree, uint32_t index)
+{
+	while (index != nullNode)
+	{
+		index = BVHBalance(tree, index);
+		Node& node = tree.nodes[index];
+		const Node& left = tree.nodes[node.left];
+		const Node& right = tree.nodes[node.right];
+		node.height = 1 + std::max(left.height, right.height);
+		node.bounds = BVHUnion(left.bounds, right.bounds);
+		index = node.parent;
+	}
+}
+
+void BVHInsertLeaf(Tree& tree, uint32_t leaf)
+{
+	tree.generation++;
+	if (tree.root == nullNode)
+	{
+		tree.root = leaf;
+		tree.nodes[leaf].parent = nullNode;
+		return;
+	}
+
+	// Go down whichever way grows the tree's boxes the least, and stop when
+	// pairing up with the current node is cheaper than going further
+	const Bounds leafBounds = tree.nodes[leaf].bounds;
+	uint32_t index = tree.root;
+	while (!BVHIsLeaf(tree.nodes[index]))
+	{
+		const Node& node = tree.nodes[index];
+		float area = BVHArea(node.bounds);
+		float combinedArea = BVHArea(BVHUnion(node.bounds, leafBounds));
+
+		// Pairing here makes a new parent with the combined box, and everything
+		// above grows the same either way we go
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		uint32_t children[2] = { node.left, node.right };
+		for (int32_t i = 0; i < 2; i++)
+		{
+			const Node& child = tree.nodes[children[i]];
+			float grown = BVHArea(BVHUnion(child.bounds, leafBounds));
+			childCost[i] = (BVHIsLeaf(child) ? grown : grown - BVHArea(child.bounds)) + inheritance;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = tree.nodes[sibling].parent;
+	uint32_t newParent = BVHAllocate(tree);
+	Node& parent = tree.nodes[newParent];
+	parent.parent = oldParent;
+	parent.left = sibling;
+	parent.right = leaf;
+	parent.item = 0;
+	parent.bounds = BVHUnion(leafBounds, tree.nodes[sibling].bounds);
+	parent.height = tree.nodes[sibling].height + 1;
+	BVHReplaceChild(tree, oldParent, sibling, newParent);
+	tree.nodes[sibling].parent = newParent;
+	tree.nodes[leaf].parent = newParent;
+
+	BVHFixUpwards(tree, newParent);
+}
+
+void BVHRemoveLeaf(Tree& tree, uint32_t leaf)
+{
+	tree.generation++;
+	if (leaf == tree.root)
+	{
+		tree.root = nullNode;
+		return;
+	}
+
+	// The leaf's sibling takes its parent's place
+	uint32_t parent = tree.nodes[leaf].parent;
+	uint32_t grandParent = tree.nodes[parent].parent;
+	uint32_t sibling = tree.nodes[parent].left == leaf ? tree.nodes[parent].right : tree.nodes[parent].left;
+
+	BVHReplaceChild(tree, grandParent, parent, sibling);
+	tree.nodes[sibling].parent = grandParent;
+	BVHFree(tree, parent);
+	BVHFixUpwards(tree, grandParent);
+}
+
+void SceneBVH::Clear(Tree& tree)
+{
+	tree.nodes.clear();
+	tree.itemLeaf.clear();
+	tree.root = nullNode;
+	tree.freeList = nullNode;
+	tree.itemCount = 0;
+	tree.generation++;
+}
+
+void SceneBVH::Insert(Tree& tree, ItemID item, const Bounds& bounds)
+{
+	if (item >= tree.itemLeaf.size())
+		tree.itemLeaf.resize(std::max((size_t)item + 1, tree.itemLeaf.size() * 2), nullNode);
+	if (tree.itemLeaf[item] != nullNode)
+	{
+		Update(tree, item, bounds);
+		return;
+	}
+
+	uint32_t leaf = BVHAllocate(tree);
+	Node& node = tree.nodes[leaf];
+	node.bounds = BVHFatten(bounds, tree.margin);
+	node.left = nullNode;
+	node.right = nullNode;
+	node.item = item;
+	node.height = 0;
+	tree.itemLeaf[item] = leaf;
+	tree.itemCount++;
+	BVHInsertLeaf(tree, leaf);
+}
+
+void SceneBVH::Remove(Tree& tree, ItemID item)
+{
+	if (!Contains(tree, item))
+		return;
+	uint32_t leaf = tree.itemLeaf[item];
+	BVHRemoveLeaf(tree, leaf);
+	BVHFree(tree, leaf);
+	tree.itemLeaf[item] = nullNode;
+	tree.itemCount--;
+}
+
+bool SceneBVH::Contains(const Tree& tree, ItemID item)
+{
+	return item < tree.itemLeaf.size() && tree.itemLeaf[item] != nullNode;
+}
+
+bool SceneBVH::Update(Tree& tree, ItemID item, const Bounds& bounds)
+{
+	if (!Contains(tree, item))
+	{
+		Insert(tree, item, bounds);
+		return true;
+	}
+
+	uint32_t leaf = tree.itemLeaf[item];
+	if (BVHContains(tree.nodes[leaf].bounds, bounds))
+		return false;
+
+	BVHRemoveLeaf(tree, leaf);
+	tree.nodes[leaf].bounds = BVHFatten(bounds, tree.margin);
+	BVHInsertLeaf(tree, leaf);
+	return true;
+}
+
+void SceneBVH::SetBounds(Tree& tree, ItemID item, const Bounds& bounds)
+{
+	if (!Contains(tree, item))
+		return;
+	Node& leaf = tree.nodes[tree.itemLeaf[item]];
+	if (!BVHContains(leaf.bounds, bounds))
+		leaf.bounds = BVHFatten(bounds, tree.margin);
+}
+
+// Top down build over order[begin, end), into the 2 * (end - begin) - 1 nodes
+// starting at index. The left subtree goes right after its parent and the
+// right subtree after that, so jobs building different ranges never touch
+// the same nodes, and nothing needs a lock.
+struct BVHBuildTask
+{
+	Tree*			tree;
+	const Bounds*	bounds;
+	uint32_t*		order;
+	uint32_t		begin;
+	uint32_t		end;
+	uint32_t		index;
+	uint32_t		parent;
+	int32_t			height;		// Filled in by the build
+};
+
+void BVHBuildRange(BVHBuildTask& task)
+{
+	Tree& tree = *task.tree;
+	const Bounds* bounds = task.bounds;
+	uint32_t* order = task.order;
+	uint32_t begin = task.begin, end = task.end, index = task.index;
+	Node& node = tree.nodes[index];
+	node.parent = task.parent;
+
+	if (end - begin == 1)
+	{
+		node.bounds = BVHFatten(bounds[order[begin]], tree.margin);
+		node.left = nullNode;
+		node.right = nullNode;
+		node.item = order[begin];
+		node.height = 0;
+		tree.itemLeaf[order[begin]] = index;
+		task.height = 0;
+		return;
+	}
+
+	// Split at the median centre along the longest axis of the centres
+	XrVector3f lo = { INFINITY, INFINITY, INFINITY };
+	XrVector3f hi = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const Bounds& b = bounds[order[i]];
+		float x = b.min.x + b.max.x, y = b.min.y + b.max.y, z = b.min.z + b.max.z;
+		lo = { std::min(lo.x, x), std::min(lo.y, y), std::min(lo.z, z) };
+		hi = { std::max(hi.x, x), std::max(hi.y, y), std::max(hi.z, z) };
+	}
+	float extentX = hi.x - lo.x, extentY = hi.y - lo.y, extentZ = hi.z - lo.z;
+	int32_t axis = extentX >= extentY && extentX >= extentZ ? 0 : extentY >= extentZ ? 1 : 2;
+
+	uint32_t middle = begin + (end - begin) / 2;
+	std::nth_element(order + begin, order + middle, order + end, [bounds, axis](uint32_t a, uint32_t b)
+	{
+		const float* ca = &bounds[a].min.x;
+		const float* cb = &bounds[b].min.x;
+		return ca[axis] + ca[axis + 3] < cb[axis] + cb[axis + 3];
+	});
+
+	node.left = index + 1;
+	node.right = index + 2 * (middle - begin);
+	BVHBuildTask left = { task.tree, bounds, order, begin, middle, node.left, index, 0 };
+	BVHBuildTask right = { task.tree, bounds, order, middle, end, node.right, index, 0 };
+	if (end - begin >= bvhParallelMinItems)
+	{
+		// The left half becomes a job that another thread can steal, and this
+		// one carries on down the right
+		JobSystem::Counter counter;
+		BVHBuildTask* leftTask = &left;
+		JobSystem::Run([leftTask]() { BVHBuildRange(*leftTask); }, &counter);
+		BVHBuildRange(right);
+		JobSystem::Wait(counter);
+	}
+	else
+	{
+		BVHBuildRange(left);
+		BVHBuildRange(right);
+	}
+
+	node.bounds = BVHUnion(tree.nodes[node.left].bounds, tree.nodes[node.right].bounds);
+	node.height = 1 + std::max(left.height, right.height);
+	task.height = node.height;
+}
+
+void SceneBVH::Build(Tree& tree, const Bounds* bounds, uint32_t count)
+{
+	std::vector<ItemID> items(count);
+	for (uint32_t i = 0; i < count; i++)
+		items[i] = i;
+	Build(tree, bounds, items.data(), count);
+}
+
+void SceneBVH::Build(Tree& tree, const Bounds* bounds, const ItemID* items, uint32_t count)
+{
+	PROFILE_ZONE("SceneBVH::Build");
+	Clear(tree);
+	if (count == 0)
+		return;
+
+	ItemID maxItem = 0;
+	for (uint32_t i = 0; i < count; i++)
+		maxItem = std::max(maxItem, items[i]);
+
+	tree.nodes.resize(2 * (size_t)count - 1);
+	tree.itemLeaf.assign((size_t)maxItem + 1, nullNode);
+	tree.itemCount = count;
+
+	std::vector<uint32_t> order(items, items + count);
+	BVHBuildTask task = { &tree, bounds, order.data(), 0, count, 0, nullNode, 0 };
+	BVHBuildRange(task);
+	tree.root = 0;
+}
+
+// Refits every box below root, children before parents
+void BVHRefitSubtree(Tree& tree, uint32_t root)
+{
+	uint32_t stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	uint32_t index = root;
+	uint32_t lastVisited = nullNode;
+	while (stackSize > 0 || index != nullNode)
+	{
+		if (index != nullNode)
+		{
+			// Leaves are already right
+			if (BVHIsLeaf(tree.nodes[index]))
+			{
+				lastVisited = index;
+				index = nullNode;
+				continue;
+			}
+			stack[stackSize++] = index;
+			index = tree.nodes[index].left;
+			continue;
+		}
+
+		uint32_t top = stack[stackSize - 1];
+		Node& node = tree.nodes[top];
+		if (lastVisited != node.right && !BVHIsLeaf(tree.nodes[node.right]))
+		{
+			index = node.right;
+			continue;
+		}
+		node.bounds = BVHUnion(tree.nodes[node.left].bounds, tree.nodes[node.right].bounds);
+		lastVisited = top;
+		stackSize--;
+	}
+}
+
+void SceneBVH::Refit(Tree& tree)
+{
+	PROFILE_ZONE("SceneBVH::Refit");
+	if (tree.root == nullNode)
+		return;
+
+	// Split off the top few levels, a handful of subtrees per thread so they
+	// even out, and refit the subtrees as jobs
+	uint32_t threadCount = JobSystem::GetThreadCount();
+	std::vector<uint32_t> upper;
+	std::vector<uint32_t> subtrees = { tree.root };
+	if (threadCount > 1 && JobSystem::IsWorkerThread() && tree.itemCount >= bvhParallelMinItems)
+	{
+		while (subtrees.size() < threadCount * 4)
+		{
+			std::vector<uint32_t> next;
+			bool split = false;
+			for (uint32_t index : subtrees)
+			{
+				const Node& node = tree.nodes[index];
+				if (BVHIsLeaf(node))
+				{
+					next.push_back(index);
+					continue;
+				}
+				upper.push_back(index);
+				next.push_back(node.left);
+				next.push_back(node.right);
+				split = true;
+			}
+			subtrees.swap(next);
+			if (!split)
+				break;
+		}
+	}
+
+	Tree* treePointer = &tree;
+	const uint32_t* subtreeRoots = subtrees.data();
+	JobSystem::ParallelFor((uint32_t)subtrees.size(), 1, [treePointer, subtreeRoots](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			BVHRefitSubtree(*treePointer, subtreeRoots[i]);
+	});
+
+	// upper is in breadth first order, so backwards is children first
+	for (auto it = upper.rbegin(); it != upper.rend(); ++it)
+	{
+		Node& node = tree.nodes[*it];
+		node.bounds = BVHUnion(tree.nodes[node.left].bounds, tree.nodes[node.right].bounds);
+	}
+}
+
+// -1 if the box is entirely outside, 1 if it's entirely inside, 0 if it
+// crosses a plane
+int32_t BVHClassify(const Frustum& frustum, const Bounds& bounds)
+{
+	float cx = (bounds.min.x + bounds.max.x) * 0.5f, ex = (bounds.max.x - bounds.min.x) * 0.5f;
+	float cy = (bounds.min.y + bounds.max.y) * 0.5f, ey = (bounds.max.y - bounds.min.y) * 0.5f;
+	float cz = (bounds.min.z + bounds.max.z) * 0.5f, ez = (bounds.max.z - bounds.min.z) * 0.5f;
+	int32_t result = 1;
+	for (int32_t i = 0; i < 6; i++)
+	{
+		const float* p = frustum.planes[i];
+		float distance = p[0] * cx + p[1] * cy + p[2] * cz + p[3];
+		float radius = fabsf(p[0]) * ex + fabsf(p[1]) * ey + fabsf(p[2]) * ez;
+		if (distance + radius < 0)
+			return -1;
+		if (distance - radius < 0)
+			result = 0;
+	}
+	return result;
+}
+
+// Everything below a node that's entirely inside, no more tests needed
+void BVHCollect(const Tree& tree, uint32_t root, std::vector<ItemID>& results)
+{
+	uint32_t stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = root;
+	while (stackSize > 0)
+	{
+		const Node& node = tree.nodes[stack[--stackSize]];
+		if (BVHIsLeaf(node))
+		{
+			results.push_back(node.item);
+			continue;
+		}
+		stack[stackSize++] = node.left;
+		stack[stackSize++] = node.right;
+	}
+}
+
+void SceneBVH::QueryFrustum(const Tree& tree, const Frustum& frustum, std::vector<ItemID>& results)
+{
+	if (tree.root == nullNode)
+		return;
+
+	uint32_t stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = tree.root;
+	while (stackSize > 0)
+	{
+		uint32_t index = stack[--stackSize];
+		const Node& node = tree.nodes[index];
+		int32_t inside = BVHClassify(frustum, node.bounds);
+		if (inside < 0)
+			continue;
+		if (inside > 0 || BVHIsLeaf(node))
+		{
+			BVHCollect(tree, index, results);
+			continue;
+		}
+		stack[stackSize++] = node.left;
+		stack[stackSize++] = node.right;
+	}
+}
+
+bool SceneBVH::UpdateLeafOrder(const Tree& tree, LeafOrder& order)
+{
+	if (order.generation == tree.generation)
+		return false;
+
+	PROFILE_ZONE("SceneBVH::UpdateLeafOrder");
+	order.items.clear();
+	order.nodeFirst.assign(tree.nodes.size(), 0);
+	order.nodeCount.assign(tree.nodes.size(), 0);
+	order.generation = tree.generation;
+	if (tree.root == nullNode)
+		return true;
+
+	// Left first, so a node's leaves start wherever the items are up to when
+	// it's reached. Parents come before their children, so going back over
+	// them afterwards can add up how many leaves each one has.
+	std::vector<uint32_t> parents;
+	uint32_t stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = tree.root;
+	while (stackSize > 0)
+	{
+		uint32_t index = stack[--stackSize];
+		const Node& node = tree.nodes[index];
+		order.nodeFirst[index] = (uint32_t)order.items.size();
+		if (BVHIsLeaf(node))
+		{
+			order.nodeCount[index] = 1;
+			order.items.push_back(node.item);
+			continue;
+		}
+		parents.push_back(index);
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = node.left;
+	}
+	for (auto it = parents.rbegin(); it != parents.rend(); ++it)
+	{
+		const Node& node = tree.nodes[*it];
+		order.nodeCount[*it] = order.nodeCount[node.left] + order.nodeCount[node.right];
+	}
+	return true;
+}
+
+// Adds a run after the last one, or joins it on if the gap is small enough
+void BVHAppendRange(std::vector<Range>& results, uint32_t first, uint32_t count, uint32_t maxGap)
+{
+	if (!results.empty())
+	{
+		Range& last = results.back();
+		if (first - (last.first + last.count) <= maxGap)
+		{
+			last.count = first + count - last.first;
+			return;
+		}
+	}
+	results.push_back({ first, count });
+}
+
+void SceneBVH::QueryFrustum(const Tree& tree, const LeafOrder& order, const Frustum& frustum, uint32_t maxGap, std::vector<Range>& results)
+{
+	if (tree.root == nullNode)
+		return;
+
+	// Left first, so the runs come out in order
+	uint32_t stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = tree.root;
+	while (stackSize > 0)
+	{
+		uint32_t index = stack[--stackSize];
+		const Node& node = tree.nodes[index];
+		int32_t inside = BVHClassify(frustum, node.bounds);
+		if (inside < 0)
+			continue;
+		if (inside > 0 || BVHIsLeaf(node))
+		{
+			BVHAppendRange(results, order.nodeFirst[index], order.nodeCount[index], maxGap);
+			continue;
+		}
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = node.left;
+	}
+}
+
+// Slab test, giving the distance the ray enters the box at, or INFINITY if
+// it misses within maxDistance
+float BVHRayEnter(const Bounds& bounds, const XrVector3f& origin, const XrVector3f& inverseDirection, float maxDistance)
+{
+	float tx1 = (bounds.min.x - origin.x) * inverseDirection.x, tx2 = (bounds.max.x - origin.x) * inverseDirection.x;
+	float ty1 = (bounds.min.y - origin.y) * inverseDirection.y, ty2 = (bounds.max.y - origin.y) * inverseDirection.y;
+	float tz1 = (bounds.min.z - origin.z) * inverseDirection.z, tz2 = (bounds.max.z - origin.z) * inverseDirection.z;
+	float enter = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+	float exit = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxDistance));
+	return enter <= exit ? enter : INFINITY;
+}
+
+void SceneBVH::QueryRay(const Tree& tree, const XrVector3f& origin, const XrVector3f& direction, float maxDistance,
+	const std::function<float(ItemID item, float maxDistance)>& hit)
+{
+	if (tree.root == nullNode)
+		return;
+
+	// Dividing by a zero component gives infinity, which the slab test handles
+	XrVector3f inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+	if (BVHRayEnter(tree.nodes[tree.root].bounds, origin, inverseDirection, maxDistance) == INFINITY)
+		return;
+
+	struct Entry { uint32_t node; float enter; };
+	Entry stack[bvhStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { tree.root, 0.0f };
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		if (entry.enter > maxDistance)
+			continue;
+
+		const Node& node = tree.nodes[entry.node];
+		if (BVHIsLeaf(node))
+		{
+			maxDistance = hit(node.item, maxDistance);
+			continue;
+		}
+
+		// Push the further child first, so the nearer one comes off next
+		float leftEnter = BVHRayEnter(tree.nodes[node.left].bounds, origin, inverseDirection, maxDistance);
+		float rightEnter = BVHRayEnter(tree.nodes[node.right].bounds, origin, inverseDirection, maxDistance);
+		Entry near = { node.left, leftEnter };
+		Entry far = { node.right, rightEnter };
+		if (rightEnter < leftEnter)
+			std::swap(near, far);
+		if (far.enter != INFINITY)
+			stack[stackSize++] = far;
+		if (near.enter != INFINITY)
+			stack[stackSize++] = near;
+	}
+}
+
+Bounds SceneBVH::MakeBounds(const XrPosef& pose, float halfExtent)
+{
+	// The box's extent along each world axis is the sum of how much each of
+	// the cube's rotated axes points along it
+	const XrQuaternionf& q = pose.orientation;
+	float r00 = 1 - 2 * (q.y * q.y + q.z * q.z), r01 = 2 * (q.x * q.y - q.w * q.z), r02 = 2 * (q.x * q.z + q.w * q.y);
+	float r10 = 2 * (q.x * q.y + q.w * q.z), r11 = 1 - 2 * (q.x * q.x + q.z * q.z), r12 = 2 * (q.y * q.z - q.w * q.x);
+	float r20 = 2 * (q.x * q.z - q.w * q.y), r21 = 2 * (q.y * q.z + q.w * q.x), r22 = 1 - 2 * (q.x * q.x + q.y * q.y);
+	float ex = halfExtent * (fabsf(r00) + fabsf(r01) + fabsf(r02));
+	float ey = halfExtent * (fabsf(r10) + fabsf(r11) + fabsf(r12));
+	float ez = halfExtent * (fabsf(r20) + fabsf(r21) + fabsf(r22));
+
+	const XrVector3f& p = pose.position;
+	Bounds bounds;
+	bounds.min = { p.x - ex, p.y - ey, p.z - ez };
+	bounds.max = { p.x + ex, p.y + ey, p.z + ez };
+	return bounds;
+}
+
+XrVector3f BVHRotate(const XrQuaternionf& q, const XrVector3f& v)
+{
+	// v + 2w(q x v) + 2q x (q x v)
+	XrVector3f t = { 2 * (q.y * v.z - q.z * v.y), 2 * (q.z * v.x - q.x * v.z), 2 * (q.x * v.y - q.y * v.x) };
+	return {
+		v.x + q.w * t.x + (q.y * t.z - q.z * t.y),
+		v.y + q.w * t.y + (q.z * t.x - q.x * t.z),
+		v.z + q.w * t.z + (q.x * t.y - q.y * t.x) };
+}
+
+Frustum SceneBVH::MakeFrustum(const XrPosef& pose, const XrFovf& fov, float nearZ, float farZ)
+{
+	// In view space, looking down -z. The side planes go through the eye, and
+	// their normals point in towards the middle of the view.
+	XrVector3f normals[6] = {
+		{  cosf(fov.angleLeft),  0, sinf(fov.angleLeft) },
+		{ -cosf(fov.angleRight), 0, -sinf(fov.angleRight) },
+		{ 0,  cosf(fov.angleDown), sinf(fov.angleDown) },
+		{ 0, -cosf(fov.angleUp),  -sinf(fov.angleUp) },
+		{ 0, 0, -1 },
+		{ 0, 0,  1 },
+	};
+	float distances[6] = { 0, 0, 0, 0, -nearZ, farZ };
+
+	// Into the pose's space: the normal rotates, and the plane moves with the eye
+	Frustum frustum;
+	for (int32_t i = 0; i < 6; i++)
+	{
+		XrVector3f n = BVHRotate(pose.orientation, normals[i]);
+		frustum.planes[i][0] = n.x;
+		frustum.planes[i][1] = n.y;
+		frustum.planes[i][2] = n.z;
+		frustum.planes[i][3] = distances[i] - (n.x * pose.position.x + n.y * pose.position.y + n.z * pose.position.z);
+	}
+	return frustum;
+}
+
+int32_t SceneBVH::GetHeight(const Tree& tree)
+{
+	return tree.root == nullNode ? 0 : tree.nodes[tree.root].height;
+}
+
+void SceneBVH::RunBenchmark(uint32_t threadCount)
+{
+	const uint32_t itemCounts[] = { 10000, 100000, 1000000 };
+	const uint32_t changeCount = 1000;
+	const uint32_t viewCount = 100;
+	const uint32_t rayCount = 1000;
+	const float cubeHalfExtent = 0.05f;
+
+	// Build only splits into jobs on a job thread, and Start makes this one
+	JobSystem::Start(threadCount);
+
+	for (uint32_t itemCount : itemCounts)
+	{
+		// Cubes the size the app places, at the same density whatever the
+		// count, so queries see about as much of the scene each time
+		float halfSize = 5.0f * cbrtf(itemCount / 10000.0f);
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-halfSize, halfSize);
+		std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+		std::uniform_real_distribution<float> nudge(-0.02f, 0.02f);
+		std::uniform_int_distribution<uint32_t> pickItem(0, itemCount - 1);
+
+		std::vector<Bounds> bounds(itemCount);
+		for (Bounds& b : bounds)
+		{
+			float a = angle(random);
+			XrPosef pose = { { 0.0f, sinf(a * 0.5f), 0.0f, cosf(a * 0.5f) }, { position(random), position(random), position(random) } };
+			b = MakeBounds(pose, cubeHalfExtent);
+		}
+
+		Tree tree;
+		uint64_t start = Platform::GetTimeNanoseconds();
+		Build(tree, bounds.data(), itemCount);
+		double buildMilliseconds = (Platform::GetTimeNanoseconds() - start) / 1000000.0;
+		int32_t builtHeight = GetHeight(tree);
+
+		// Everything moves a little, some of it out of its leaf's margin
+		for (uint32_t i = 0; i < itemCount; i++)
+		{
+			float dx = nudge(random), dy = nudge(random), dz = nudge(random);
+			bounds[i].min = { bounds[i].min.x + dx, bounds[i].min.y + dy, bounds[i].min.z + dz };
+			bounds[i].max = { bounds[i].max.x + dx, bounds[i].max.y + dy, bounds[i].max.z + dz };
+			SetBounds(tree, i, bounds[i]);
+		}
+		start = Platform::GetTimeNanoseconds();
+		Refit(tree);
+		double refitMilliseconds = (Platform::GetTimeNanoseconds() - start) / 1000000.0;
+
+		// Taking cubes out and putting them back somewhere else, as editing does
+		std::vector<ItemID> changed(changeCount);
+		for (ItemID& item : changed)
+			item = pickItem(random);
+		start = Platform::GetTimeNanoseconds();
+		for (ItemID item : changed)
+			Remove(tree, item);
+		double removeNanoseconds = (double)(Platform::GetTimeNanoseconds() - start) / changeCount;
+		for (ItemID item : changed)
+		{
+			XrPosef pose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { position(random), position(random), position(random) } };
+			bounds[item] = MakeBounds(pose, cubeHalfExtent);
+		}
+		start = Platform::GetTimeNanoseconds();
+		for (ItemID item : changed)
+			Insert(tree, item, bounds[item]);
+		double insertNanoseconds = (double)(Platform::GetTimeNanoseconds() - start) / changeCount;
+
+		// Views from inside the scene looking every which way, with about the
+		// field of view of a headset
+		XrFovf fov = { -0.8f, 0.8f, 0.8f, -0.8f };
+		std::vector<Frustum> frustums(viewCount);
+		for (Frustum& frustum : frustums)
+		{
+			float a = angle(random);
+			XrPosef pose = { { 0.0f, sinf(a * 0.5f), 0.0f, cosf(a * 0.5f) }, { position(random) * 0.5f, position(random) * 0.5f, position(random) * 0.5f } };
+			frustum = MakeFrustum(pose, fov, 0.05f, 100.0f);
+		}
+
+		std::vector<ItemID> visible;
+		visible.reserve(itemCount);
+		uint64_t visibleTotal = 0;
+		start = Platform::GetTimeNanoseconds();
+		for (const Frustum& frustum : frustums)
+		{
+			visible.clear();
+			QueryFrustum(tree, frustum, visible);
+			visibleTotal += visible.size();
+		}
+		double frustumMicroseconds = (Platform::GetTimeNanoseconds() - start) / 1000.0 / viewCount;
+
+		LeafOrder order;
+		start = Platform::GetTimeNanoseconds();
+		UpdateLeafOrder(tree, order);
+		double leafOrderMilliseconds = (Platform::GetTimeNanoseconds() - start) / 1000000.0;
+
+		std::vector<Range> runs;
+		runs.reserve(itemCount);
+		uint64_t runTotal = 0;
+		start = Platform::GetTimeNanoseconds();
+		for (const Frustum& frustum : frustums)
+		{
+			runs.clear();
+			QueryFrustum(tree, order, frustum, 16, runs);
+			runTotal += runs.size();
+		}
+		double runsMicroseconds = (Platform::GetTimeNanoseconds() - start) / 1000.0 / viewCount;
+
+		// Rays from inside the scene to a corner of a random cube, each calling
+		// back for every leaf it passes through on the way
+		uint64_t leafTotal = 0;
+		start = Platform::GetTimeNanoseconds();
+		for (uint32_t r = 0; r < rayCount; r++)
+		{
+			const Bounds& target = bounds[pickItem(random)];
+			XrVector3f origin = { position(random) * 0.5f, position(random) * 0.5f, position(random) * 0.5f };
+			XrVector3f direction = { target.min.x - origin.x, target.min.y - origin.y, target.min.z - origin.z };
+			QueryRay(tree, origin, direction, 1.0f, [&leafTotal](ItemID, float maxDistance) { leafTotal++; return maxDistance; });
+		}
+		double rayMicroseconds = (Platform::GetTimeNanoseconds() - start) / 1000.0 / rayCount;
+
+		LOG(INFO) << "BVH of " << itemCount << " cubes with " << threadCount << " threads: Build " << buildMilliseconds << "ms (height "
+			<< builtHeight << "), Refit " << refitMilliseconds << "ms, Remove " << removeNanoseconds << "ns, Insert "
+			<< insertNanoseconds << "ns (height " << GetHeight(tree) << ")";
+		LOG(INFO) << "BVH of " << itemCount << " cubes: QueryFrustum " << frustumMicroseconds << "us (" << visibleTotal / viewCount
+			<< " visible), as runs " << runsMicroseconds << "us (" << runTotal / viewCount << " runs, leaf order "
+			<< leafOrderMilliseconds << "ms), QueryRay " << rayMicroseconds << "us (" << (double)leafTotal / rayCount << " leaves)";
+	}
+
+	JobSystem::Stop();
+}
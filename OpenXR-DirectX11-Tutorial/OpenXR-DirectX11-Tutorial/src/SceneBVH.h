@@ -0,0 +1,131 @@
+#pragma once
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// A bounding volume hierarchy over scene instances, so culling and picking
+// only look at the part of the scene they might touch instead of all of it.
+//
+// It's a binary tree of axis aligned boxes, kept balanced with the same tree
+// rotations as an AVL tree. Items can be inserted, moved and removed one at a
+// time as the scene changes, which costs O(log n) each. Leaf boxes are a
+// little bigger than the item (the margin), so small moves don't touch the
+// tree at all. A whole scene can also be built in one go, and many moved
+// items refit in one pass, with both split into jobs for the JobSystem.
+namespace SceneBVH
+{
+	typedef uint32_t ItemID;
+
+	const uint32_t nullNode = 0xFFFFFFFF;
+
+	struct Bounds
+	{
+		XrVector3f	min;
+		XrVector3f	max;
+	};
+
+	struct Node
+	{
+		Bounds		bounds;
+		uint32_t	parent;		// Next free node, for nodes on the free list
+		uint32_t	left;		// nullNode for leaves
+		uint32_t	right;
+		ItemID		item;		// Leaves only
+		int32_t		height;		// Leaves are 0
+	};
+
+	struct Tree
+	{
+		std::vector<Node>		nodes;
+		std::vector<uint32_t>	itemLeaf;	// Indexed by ItemID, nullNode when not in the tree
+		uint32_t				root = nullNode;
+		uint32_t				freeList = nullNode;
+		uint32_t				itemCount = 0;
+		float					margin = 0.01f;
+		uint64_t				generation = 0;	// Bumped whenever the tree's shape changes
+	};
+
+	// Every item in the order of the tree's leaves, left to right, and where
+	// each node's leaves start in it and how many there are. Everything below
+	// a node is then one run of items, so queries can hand back runs instead
+	// of single items. It only changes when the tree's shape does.
+	struct LeafOrder
+	{
+		std::vector<ItemID>		items;
+		std::vector<uint32_t>	nodeFirst;	// Indexed by node
+		std::vector<uint32_t>	nodeCount;
+		uint64_t				generation = 0;
+	};
+
+	// A run of items in a LeafOrder
+	struct Range
+	{
+		uint32_t	first;
+		uint32_t	count;
+	};
+
+	// Six planes facing inwards: a point is inside when dot(normal, p) + d >= 0
+	// for all of them. Planes are x, y, z, d.
+	struct Frustum
+	{
+		float		planes[6][4];
+	};
+
+	void		Clear(Tree& tree);
+
+	// Replaces whatever was in the tree with items 0 to count - 1, splitting
+	// at the median of the longest axis. Only runs in parallel when called
+	// from a job thread.
+	void		Build(Tree& tree, const Bounds* bounds, uint32_t count);
+	// The same, for items that aren't numbered 0 to count - 1. bounds is
+	// indexed by item.
+	void		Build(Tree& tree, const Bounds* bounds, const ItemID* items, uint32_t count);
+
+	void		Insert(Tree& tree, ItemID item, const Bounds& bounds);
+	void		Remove(Tree& tree, ItemID item);
+	bool		Contains(const Tree& tree, ItemID item);
+
+	// Moves an item, and only restructures the tree if it's left its leaf's
+	// box. Returns true if it had to.
+	bool		Update(Tree& tree, ItemID item, const Bounds& bounds);
+
+	// For moving lots of items at once: SetBounds only changes the leaf, and
+	// Refit then fixes up every box above the leaves in one pass. The tree's
+	// shape doesn't change, so it's only as good as it was before the move.
+	void		SetBounds(Tree& tree, ItemID item, const Bounds& bounds);
+	void		Refit(Tree& tree);
+
+	// Brings order up to date with the tree's shape. Returns true if it changed.
+	bool		UpdateLeafOrder(const Tree& tree, LeafOrder& order);
+
+	// Appends every item whose leaf box touches the frustum to results
+	void		QueryFrustum(const Tree& tree, const Frustum& frustum, std::vector<ItemID>& results);
+	// The same, as runs of an up to date LeafOrder, in order. Runs with fewer
+	// than maxGap items between them are joined, so the items in the gap come
+	// along too.
+	void		QueryFrustum(const Tree& tree, const LeafOrder& order, const Frustum& frustum, uint32_t maxGap, std::vector<Range>& results);
+
+	// Calls hit for every item whose leaf box the ray passes through within
+	// maxDistance, nearest boxes first. hit returns the new maxDistance, so a
+	// nearest hit search can shrink it as it goes and skip everything further.
+	// The direction doesn't need to be normalized, distances are in units of
+	// its length.
+	void		QueryRay(const Tree& tree, const XrVector3f& origin, const XrVector3f& direction, float maxDistance,
+					const std::function<float(ItemID item, float maxDistance)>& hit);
+
+	// A box around a cube of the given half size, rotated and placed by pose
+	Bounds		MakeBounds(const XrPosef& pose, float halfExtent);
+
+	// The view volume of an OpenXR view, in the space its pose is in
+	Frustum		MakeFrustum(const XrPosef& pose, const XrFovf& fov, float nearZ, float farZ);
+
+	int32_t		GetHeight(const Tree& tree);
+
+	// Times Build, Refit, Insert and Remove, and frustum and ray queries on
+	// scattered cubes, from 10 thousand up to a million, and logs the results.
+	// Starts the JobSystem with threadCount threads, and stops it again.
+	void		RunBenchmark(uint32_t threadCount);
+}
@@ -0,0 +1,549 @@
+#include "SceneFile.h"
+#include "AllocationTracker.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <random>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SceneFile;
+
+// Don't bother compacting until the journal has at least this many records,
+// however small the snapshot is
+constexpr uint64_t sceneFileCompactMinRecords = 4096;
+
+// The file being saved to. The journal is appended with plain file writes,
+// since a mapping can't grow.
+FILE*					sceneFile = nullptr;
+std::string				sceneFilePath;
+FileHeader				sceneFileHeader = {};
+uint64_t				sceneFileSavedGeneration = 0;
+uint32_t				sceneFileSavedCount = 0;
+std::vector<uint32_t>	sceneFileChanged;
+std::vector<Record>		sceneFileRecords;
+
+// Compaction runs on its own thread, from a snapshot of the file as it was
+// when it started. Whatever was appended after that is copied over when it's
+// done.
+std::thread				sceneFileCompactor;
+std::atomic<bool>		sceneFileCompactDone = { false };
+bool					sceneFileCompacting = false;
+bool					sceneFileCompactResult = false;
+uint64_t				sceneFileCompactFrom = 0;
+uint64_t				sceneFileCompactAt = 0;
+
+uint64_t SceneFileAlign(uint64_t offset)
+{
+	return (offset + columnAlignment - 1) & ~(uint64_t)(columnAlignment - 1);
+}
+
+bool SceneFileIsHeader(const FileHeader& header)
+{
+	return memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version
+		&& header.headerSize >= sizeof(FileHeader) && header.columns == columnCount;
+}
+
+// Checks a file really is a scene file, and that everything the header
+// points at is inside it
+const FileHeader* SceneFileCheckHeader(const uint8_t* data, size_t size)
+{
+	if (size < sizeof(FileHeader))
+		return nullptr;
+
+	const FileHeader* header = (const FileHeader*)data;
+	if (!SceneFileIsHeader(*header))
+		return nullptr;
+
+	for (uint32_t i = 0; i < columnCount; i++)
+	{
+		if (header->columnOffsets[i] % columnAlignment != 0 || header->columnOffsets[i] + (uint64_t)header->count * 4 > size)
+			return nullptr;
+	}
+	if (header->journalOffset > size || header->journalSize > size - header->journalOffset)
+		return nullptr;
+	return header;
+}
+
+void SceneFileApply(SceneStore::Store& store, SceneStore::Partition partition, const Record& record)
+{
+	SceneStore::Columns& columns = store.partitions[partition];
+	if (record.kind == RecordKind::Set)
+	{
+		XrPosef pose;
+		pose.orientation = { record.orientation[0], record.orientation[1], record.orientation[2], record.orientation[3] };
+		pose.position = { record.position[0], record.position[1], record.position[2] };
+		if (record.index < columns.count)
+		{
+			SceneStore::Handle handle = columns.handles[record.index];
+			SceneStore::SetPose(store, handle, pose);
+			SceneStore::SetScale(store, handle, record.scale);
+			SceneStore::SetColor(store, handle, record.color);
+		}
+		else if (record.index == columns.count)
+		{
+			SceneStore::Add(store, partition, pose, record.scale, record.color);
+		}
+	}
+	else if (record.kind == RecordKind::Resize)
+	{
+		// Removing from the end doesn't move anything
+		while (columns.count > record.index)
+			SceneStore::Remove(store, columns.handles[columns.count - 1]);
+	}
+}
+
+// Load from a scene file that's in memory, but only taking the first
+// journalLimit bytes of the journal. name is only for the log.
+bool SceneFileLoadData(const uint8_t* fileData, size_t fileSize, const char* name, SceneStore::Store& store, SceneStore::Partition partition,
+	uint64_t journalLimit, uint64_t& journalSize)
+{
+	const FileHeader* header = SceneFileCheckHeader(fileData, fileSize);
+	if (header == nullptr)
+	{
+		LOG(WARNING) << "Scene file " << name << " isn't a version " << version << " scene file";
+		return false;
+	}
+
+	// The snapshot's columns are laid out just like the store's, so each one
+	// is a single copy out of the file, with nothing to parse
+	SceneStore::ColumnData data;
+	data.positionX = (const float*)(fileData + header->columnOffsets[columnPositionX]);
+	data.positionY = (const float*)(fileData + header->columnOffsets[columnPositionY]);
+	data.positionZ = (const float*)(fileData + header->columnOffsets[columnPositionZ]);
+	data.orientationX = (const float*)(fileData + header->columnOffsets[columnOrientationX]);
+	data.orientationY = (const float*)(fileData + header->columnOffsets[columnOrientationY]);
+	data.orientationZ = (const float*)(fileData + header->columnOffsets[columnOrientationZ]);
+	data.orientationW = (const float*)(fileData + header->columnOffsets[columnOrientationW]);
+	data.scale = (const float*)(fileData + header->columnOffsets[columnScale]);
+	data.color = (const uint32_t*)(fileData + header->columnOffsets[columnColor]);
+	SceneStore::AddColumns(store, partition, data, header->count);
+
+	journalSize = std::min(header->journalSize, journalLimit);
+	journalSize -= journalSize % sizeof(Record);
+	const Record* records = (const Record*)(fileData + header->journalOffset);
+	for (uint64_t i = 0; i < journalSize / sizeof(Record); i++)
+		SceneFileApply(store, partition, records[i]);
+	return true;
+}
+
+bool SceneFileLoad(const char* path, SceneStore::Store& store, SceneStore::Partition partition, uint64_t journalLimit, uint64_t& journalSize)
+{
+	MappedFile file;
+	if (!Platform::OpenMappedFile(path, false, file))
+		return false;
+	bool result = SceneFileLoadData(file.data, file.size, path, store, partition, journalLimit, journalSize);
+	Platform::CloseMappedFile(file);
+	return result;
+}
+
+bool SceneFile::Load(const char* path, SceneStore::Store& store, SceneStore::Partition partition)
+{
+	PROFILE_ZONE("SceneFile::Load");
+
+	uint64_t start = Platform::GetTimeNanoseconds();
+	uint32_t countBefore = store.partitions[partition].count;
+	uint64_t journalSize = 0;
+	if (!SceneFileLoad(path, store, partition, UINT64_MAX, journalSize))
+		return false;
+
+	LOG(INFO) << "Loaded " << store.partitions[partition].count - countBefore << " cubes and " << journalSize / sizeof(Record)
+		<< " journal records from " << path << " in " << (Platform::GetTimeNanoseconds() - start) / 1000000.0 << "ms";
+	return true;
+}
+
+bool SceneFile::Load(const uint8_t* data, size_t size, SceneStore::Store& store, SceneStore::Partition partition)
+{
+	PROFILE_ZONE("SceneFile::Load");
+
+	uint32_t countBefore = store.partitions[partition].count;
+	uint64_t journalSize = 0;
+	if (!SceneFileLoadData(data, size, "in memory", store, partition, UINT64_MAX, journalSize))
+		return false;
+
+	LOG(INFO) << "Loaded " << store.partitions[partition].count - countBefore << " cubes and " << journalSize / sizeof(Record)
+		<< " journal records from memory";
+	return true;
+}
+
+// Fills in a header for a snapshot of count cubes, and returns how big the
+// file is
+uint64_t SceneFileLayout(uint32_t count, FileHeader& header)
+{
+	header = {};
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.headerSize = sizeof(FileHeader);
+	header.count = count;
+	header.columns = columnCount;
+
+	uint64_t offset = SceneFileAlign(sizeof(FileHeader));
+	for (uint32_t i = 0; i < columnCount; i++)
+	{
+		header.columnOffsets[i] = offset;
+		offset = SceneFileAlign(offset + (uint64_t)count * 4);
+	}
+	header.journalOffset = offset;
+	header.journalSize = 0;
+	return offset;
+}
+
+// data needs room for the whole file SceneFileLayout described
+void SceneFileFill(uint8_t* data, const FileHeader& header, const SceneStore::Columns& columns)
+{
+	const void* sources[columnCount] = {
+		columns.positionX.data(), columns.positionY.data(), columns.positionZ.data(),
+		columns.orientationX.data(), columns.orientationY.data(), columns.orientationZ.data(), columns.orientationW.data(),
+		columns.scale.data(), columns.color.data(),
+	};
+	memcpy(data, &header, sizeof(header));
+	for (uint32_t i = 0; i < columnCount; i++)
+	{
+		if (columns.count > 0)
+			memcpy(data + header.columnOffsets[i], sources[i], (size_t)columns.count * 4);
+	}
+}
+
+bool SceneFile::Write(const char* path, const SceneStore::Columns& columns)
+{
+	PROFILE_ZONE("SceneFile::Write");
+
+	FileHeader header;
+	uint64_t size = SceneFileLayout(columns.count, header);
+	MappedFile file;
+	if (!Platform::CreateMappedFile(path, (size_t)size, file))
+	{
+		LOG(ERROR) << "Couldn't create scene file " << path;
+		return false;
+	}
+	SceneFileFill(file.data, header, columns);
+
+	Platform::FlushMappedFile(file);
+	Platform::CloseMappedFile(file);
+	return true;
+}
+
+void SceneFile::Write(const SceneStore::Columns& columns, std::vector<uint8_t>& data)
+{
+	FileHeader header;
+	data.resize((size_t)SceneFileLayout(columns.count, header));
+	SceneFileFill(data.data(), header, columns);
+}
+
+bool SceneFileSeek(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(file, (int64_t)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Opens a scene file for appending, and reads its header
+FILE* SceneFileOpen(const char* path, FileHeader& header)
+{
+	FILE* file = fopen(path, "r+b");
+	if (file == nullptr)
+		return nullptr;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || !SceneFileIsHeader(header))
+	{
+		fclose(file);
+		return nullptr;
+	}
+	return file;
+}
+
+// Writes records after the end of the journal, then moves the end past them.
+// If we crash in between, the records are past the end and get ignored.
+bool SceneFileAppend(FILE* file, FileHeader& header, const void* records, uint64_t size)
+{
+	if (size == 0)
+		return true;
+
+	if (!SceneFileSeek(file, header.journalOffset + header.journalSize)
+		|| fwrite(records, 1, (size_t)size, file) != size
+		|| fflush(file) != 0)
+		return false;
+
+	header.journalSize += size;
+	return SceneFileSeek(file, offsetof(FileHeader, journalSize))
+		&& fwrite(&header.journalSize, sizeof(header.journalSize), 1, file) == 1
+		&& fflush(file) == 0;
+}
+
+std::string SceneFileCompactPath()
+{
+	return sceneFilePath + ".compact";
+}
+
+void SceneFileCompact(std::string path, std::string compactPath, uint64_t journalLimit)
+{
+	Platform::SetCurrentThreadName("Scene Compactor");
+	Platform::SetCurrentThreadPriority(ThreadPriority::Low);
+	PROFILE_THREAD_NAME("Scene Compactor");
+
+	// Play the journal into a store of our own, and write that out whole
+	SceneStore::Store store;
+	uint64_t journalSize = 0;
+	sceneFileCompactResult = SceneFileLoad(path.c_str(), store, SceneStore::partitionStatic, journalLimit, journalSize)
+		&& Write(compactPath.c_str(), store.partitions[SceneStore::partitionStatic]);
+	sceneFileCompactDone.store(true, std::memory_order_release);
+}
+
+// Swaps the compacted file in, with anything appended since it started
+void SceneFileFinishCompaction()
+{
+	sceneFileCompactor.join();
+	sceneFileCompacting = false;
+	sceneFileCompactDone.store(false, std::memory_order_relaxed);
+
+	std::string compactPath = SceneFileCompactPath();
+	FileHeader compactHeader;
+	FILE* compactFile = sceneFileCompactResult ? SceneFileOpen(compactPath.c_str(), compactHeader) : nullptr;
+	if (compactFile == nullptr)
+	{
+		LOG(WARNING) << "Couldn't compact scene file " << sceneFilePath;
+		remove(compactPath.c_str());
+		sceneFileCompactAt = sceneFileHeader.journalSize * 2;
+		return;
+	}
+
+	std::vector<uint8_t> tail((size_t)(sceneFileHeader.journalSize - sceneFileCompactFrom));
+	bool result = SceneFileSeek(sceneFile, sceneFileHeader.journalOffset + sceneFileCompactFrom)
+		&& (tail.empty() || fread(tail.data(), 1, tail.size(), sceneFile) == tail.size())
+		&& SceneFileAppend(compactFile, compactHeader, tail.data(), tail.size());
+	fclose(compactFile);
+
+	if (result)
+	{
+		fclose(sceneFile);
+		sceneFile = nullptr;
+		result = Platform::RenameFile(compactPath.c_str(), sceneFilePath.c_str());
+		sceneFile = SceneFileOpen(sceneFilePath.c_str(), sceneFileHeader);
+	}
+	if (!result || sceneFile == nullptr)
+	{
+		LOG(WARNING) << "Couldn't swap in the compacted scene file " << sceneFilePath;
+		remove(compactPath.c_str());
+		sceneFileCompactAt = sceneFileHeader.journalSize * 2;
+		return;
+	}
+
+	LOG(INFO) << "Compacted scene file " << sceneFilePath << " to " << sceneFileHeader.count << " cubes and "
+		<< sceneFileHeader.journalSize / sizeof(Record) << " journal records";
+	sceneFileCompactAt = 0;
+}
+
+bool SceneFile::StartSaving(const char* path, const SceneStore::Columns& columns)
+{
+	sceneFilePath = path;
+	sceneFile = SceneFileOpen(path, sceneFileHeader);
+	if (sceneFile == nullptr)
+	{
+		if (!Write(path, columns))
+			return false;
+		sceneFile = SceneFileOpen(path, sceneFileHeader);
+		if (sceneFile == nullptr)
+			return false;
+	}
+
+	sceneFileSavedGeneration = columns.generation;
+	sceneFileSavedCount = columns.count;
+	sceneFileCompactAt = 0;
+	return true;
+}
+
+void SceneFile::Save(const SceneStore::Columns& columns)
+{
+	if (sceneFile == nullptr)
+		return;
+	if (sceneFileCompacting && sceneFileCompactDone.load(std::memory_order_acquire))
+	{
+		SceneFileFinishCompaction();
+		AllocationTracker::AllowThisFrame();
+	}
+	if (sceneFile == nullptr || columns.generation == sceneFileSavedGeneration)
+		return;
+
+	PROFILE_ZONE("SceneFile::Save");
+
+	// Every cube that changed since the last save, in order, so appended cubes
+	// are replayed in the order they were added
+	sceneFileChanged.clear();
+	bool saveAll = sceneFileSavedGeneration < columns.dirtySince;
+	uint32_t count = saveAll ? columns.count : (uint32_t)columns.dirty.size();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t index = saveAll ? i : columns.dirty[i];
+		if (index < columns.count && columns.changed[index] > sceneFileSavedGeneration)
+			sceneFileChanged.push_back(index);
+	}
+	std::sort(sceneFileChanged.begin(), sceneFileChanged.end());
+
+	sceneFileRecords.clear();
+	for (uint32_t index : sceneFileChanged)
+	{
+		Record record;
+		record.kind = RecordKind::Set;
+		record.index = index;
+		record.position[0] = columns.positionX[index];
+		record.position[1] = columns.positionY[index];
+		record.position[2] = columns.positionZ[index];
+		record.orientation[0] = columns.orientationX[index];
+		record.orientation[1] = columns.orientationY[index];
+		record.orientation[2] = columns.orientationZ[index];
+		record.orientation[3] = columns.orientationW[index];
+		record.scale = columns.scale[index];
+		record.color = columns.color[index];
+		sceneFileRecords.push_back(record);
+	}
+	if (columns.count != sceneFileSavedCount)
+	{
+		Record record = {};
+		record.kind = RecordKind::Resize;
+		record.index = columns.count;
+		sceneFileRecords.push_back(record);
+	}
+
+	if (!SceneFileAppend(sceneFile, sceneFileHeader, sceneFileRecords.data(), sceneFileRecords.size() * sizeof(Record)))
+	{
+		LOG(ERROR) << "Couldn't save to scene file " << sceneFilePath;
+		return;
+	}
+	sceneFileSavedGeneration = columns.generation;
+	sceneFileSavedCount = columns.count;
+
+	// Once the journal is bigger than the snapshot, loading spends more time
+	// replaying it than copying columns, so fold it in
+	uint64_t records = sceneFileHeader.journalSize / sizeof(Record);
+	if (!sceneFileCompacting && records > std::max(sceneFileCompactMinRecords, (uint64_t)sceneFileHeader.count)
+		&& sceneFileHeader.journalSize > sceneFileCompactAt)
+	{
+		sceneFileCompacting = true;
+		sceneFileCompactFrom = sceneFileHeader.journalSize;
+		sceneFileCompactor = std::thread(SceneFileCompact, sceneFilePath, SceneFileCompactPath(), sceneFileCompactFrom);
+		AllocationTracker::AllowThisFrame();
+	}
+}
+
+void SceneFile::StopSaving()
+{
+	if (sceneFileCompacting)
+		SceneFileFinishCompaction();
+	if (sceneFile != nullptr)
+		fclose(sceneFile);
+	sceneFile = nullptr;
+}
+
+void SceneFile::RunBenchmark()
+{
+	const uint32_t cubeCounts[] = { 1000, 10000, 100000, 1000000 };
+	const uint32_t journalFraction = 8;		// One journal record per this many cubes
+	const uint32_t repeats = 10;
+	const char* path = "scene_benchmark.xrscene";
+
+	for (uint32_t cubeCount : cubeCounts)
+	{
+		// Cubes scattered and turned about the vertical, the way they're placed
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+		std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+		// Color is the last column, and the only one that isn't floats
+		std::vector<float> columns[columnColor];
+		for (std::vector<float>& column : columns)
+			column.resize(cubeCount);
+		std::vector<uint32_t> colors(cubeCount, 0xFFFFFFFF);
+		for (uint32_t i = 0; i < cubeCount; i++)
+		{
+			float a = angle(random);
+			columns[columnPositionX][i] = position(random);
+			columns[columnPositionY][i] = position(random);
+			columns[columnPositionZ][i] = position(random);
+			columns[columnOrientationX][i] = 0.0f;
+			columns[columnOrientationY][i] = sinf(a * 0.5f);
+			columns[columnOrientationZ][i] = 0.0f;
+			columns[columnOrientationW][i] = cosf(a * 0.5f);
+			columns[columnScale][i] = 0.05f;
+		}
+		SceneStore::ColumnData data = {
+			columns[columnPositionX].data(), columns[columnPositionY].data(), columns[columnPositionZ].data(),
+			columns[columnOrientationX].data(), columns[columnOrientationY].data(), columns[columnOrientationZ].data(), columns[columnOrientationW].data(),
+			columns[columnScale].data(), colors.data(),
+		};
+		SceneStore::Store written;
+		SceneStore::AddColumns(written, SceneStore::partitionStatic, data, cubeCount);
+		if (!Write(path, written.partitions[SceneStore::partitionStatic]))
+			return;
+
+		// Best of a few loads, each into an empty store as the app does
+		auto timeLoads = [path, cubeCount](const Record* moved, uint32_t movedCount, bool& correct)
+		{
+			uint64_t best = UINT64_MAX;
+			correct = true;
+			for (uint32_t r = 0; r < repeats; r++)
+			{
+				SceneStore::Store loaded;
+				uint64_t start = Platform::GetTimeNanoseconds();
+				bool ok = Load(path, loaded, SceneStore::partitionStatic);
+				best = std::min(best, Platform::GetTimeNanoseconds() - start);
+
+				const SceneStore::Columns& cubes = loaded.partitions[SceneStore::partitionStatic];
+				correct = correct && ok && cubes.count == cubeCount;
+				for (uint32_t i = 0; correct && i < movedCount; i++)
+					correct = cubes.positionX[moved[i].index] == moved[i].position[0];
+			}
+			return best / 1000000.0;
+		};
+
+		bool snapshotCorrect = false;
+		double snapshotMilliseconds = timeLoads(nullptr, 0, snapshotCorrect);
+
+		// Then the same again with a journal of moved cubes to replay
+		uint32_t movedCount = cubeCount / journalFraction;
+		std::uniform_int_distribution<uint32_t> pickCube(0, cubeCount - 1);
+		std::vector<Record> moved(movedCount);
+		for (Record& record : moved)
+			record = { RecordKind::Set, pickCube(random), { position(random), position(random), position(random) }, { 0.0f, 0.0f, 0.0f, 1.0f }, 0.05f, 0xFFFFFFFF };
+		// Later records for the same cube win, so only check the last of each
+		std::vector<Record> last;
+		std::vector<bool> seen(cubeCount, false);
+		for (auto it = moved.rbegin(); it != moved.rend(); ++it)
+		{
+			if (!seen[it->index])
+				last.push_back(*it);
+			seen[it->index] = true;
+		}
+
+		FileHeader header;
+		FILE* file = SceneFileOpen(path, header);
+		bool appended = file != nullptr && SceneFileAppend(file, header, moved.data(), (uint64_t)movedCount * sizeof(Record));
+		if (file != nullptr)
+			fclose(file);
+		if (!appended)
+		{
+			LOG(ERROR) << "Couldn't append a journal to " << path;
+			remove(path);
+			return;
+		}
+
+		bool journalCorrect = false;
+		double journalMilliseconds = timeLoads(last.data(), (uint32_t)last.size(), journalCorrect);
+
+		double megabytes = (double)header.journalOffset / (1024.0 * 1024.0);
+		LOG(INFO) << "Scene of " << cubeCount << " cubes (" << megabytes << "MB): Load " << snapshotMilliseconds << "ms ("
+			<< snapshotMilliseconds * 1000000.0 / cubeCount << "ns per cube, " << megabytes * 1000.0 / snapshotMilliseconds << "MB/s), with "
+			<< movedCount << " journal records " << journalMilliseconds << "ms"
+			<< (snapshotCorrect && journalCorrect ? "" : ", LOADED WRONG");
+	}
+	remove(path);
+}
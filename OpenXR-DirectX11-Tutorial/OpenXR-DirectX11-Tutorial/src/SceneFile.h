@@ -0,0 +1,98 @@
+#pragma once
+
+#include "SceneStore.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Saves a partition of the scene to disk and loads it back, so placed cubes
+// are still there next time.
+//
+// A file starts with a snapshot: the partition's columns, one after another,
+// exactly as SceneStore keeps them in memory. Loading maps the file and
+// copies each column into the store in one go. There's nothing to parse, but
+// the store owns its columns, so every cube is still copied once.
+//
+// After the snapshot comes the journal. Saving only appends records for the
+// cubes that changed since the last save, and then bumps journalSize in the
+// header, so a crash part way through a save loses that save and nothing
+// else. Once the journal outgrows the snapshot, a background thread writes a
+// fresh snapshot with everything folded in and swaps it in for the old file.
+namespace SceneFile
+{
+	const char		magic[8] = { 'X', 'R', 'S', 'C', 'E', 'N', 'E', '1' };
+	const uint32_t	version = 1;
+
+	enum Column
+	{
+		columnPositionX,
+		columnPositionY,
+		columnPositionZ,
+		columnOrientationX,
+		columnOrientationY,
+		columnOrientationZ,
+		columnOrientationW,
+		columnScale,
+		columnColor,
+		columnCount,
+	};
+
+	// Columns start on 16 byte boundaries, so they can be read with SSE
+	// straight from the mapping
+	const uint32_t	columnAlignment = 16;
+
+	struct FileHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	headerSize;
+		uint32_t	count;					// Cubes in the snapshot
+		uint32_t	columns;				// columnCount when written
+		uint64_t	columnOffsets[columnCount];
+		uint64_t	journalOffset;
+		uint64_t	journalSize;			// Bytes of complete records
+	};
+
+	enum class RecordKind : uint32_t
+	{
+		Set = 1,		// The cube at index is now this, index can be one past the end
+		Resize = 2,		// There are now index cubes, the rest were removed
+	};
+
+	// Removing a cube moves the last one into its place, which SceneStore
+	// marks dirty, so a Set for the moved cube and a Resize is all it takes
+	struct Record
+	{
+		RecordKind	kind;
+		uint32_t	index;
+		float		position[3];
+		float		orientation[4];
+		float		scale;
+		uint32_t	color;
+	};
+
+	// Adds the cubes in the file to the partition. Returns false if there's
+	// no file, or it isn't a scene file.
+	bool		Load(const char* path, SceneStore::Store& store, SceneStore::Partition partition);
+	// The same, from a scene file that's already in memory
+	bool		Load(const uint8_t* data, size_t size, SceneStore::Store& store, SceneStore::Partition partition);
+
+	// Writes a snapshot of every cube in the columns, with an empty journal,
+	// to a file or to memory
+	bool		Write(const char* path, const SceneStore::Columns& columns);
+	void		Write(const SceneStore::Columns& columns, std::vector<uint8_t>& data);
+
+	// Saving appends to the file at path, which should already hold the
+	// columns as they are now, either because they were just loaded from it
+	// or because StartSaving had to write it. Save only writes what changed
+	// since the last call, so it can be called every frame.
+	bool		StartSaving(const char* path, const SceneStore::Columns& columns);
+	void		Save(const SceneStore::Columns& columns);
+	void		StopSaving();
+
+	// Writes scenes of a thousand up to a million cubes, with and without a
+	// journal, and times loading them back. Logs the results, and leaves no
+	// files behind.
+	void		RunBenchmark();
+}
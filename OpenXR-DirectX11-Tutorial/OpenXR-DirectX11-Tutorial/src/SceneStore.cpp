@@ -0,0 +1,273 @@
+#include "SceneStore.h"
+#include "Profiler.h"
+
+#include <string.h>
+
+using namespace SceneStore;
+
+void StoreResize(Columns& columns, size_t size)
+{
+	columns.positionX.resize(size);
+	columns.positionY.resize(size);
+	columns.positionZ.resize(size);
+	columns.orientationX.resize(size);
+	columns.orientationY.resize(size);
+	columns.orientationZ.resize(size);
+	columns.orientationW.resize(size);
+	columns.scale.resize(size);
+	columns.color.resize(size);
+	columns.handles.resize(size);
+	columns.changed.resize(size);
+	columns.isDirty.resize(size);
+}
+
+void StoreMarkDirty(Store& store, Columns& columns, uint32_t index)
+{
+	columns.generation = ++store.generation;
+	columns.changed[index] = columns.generation;
+	if (!columns.isDirty[index])
+	{
+		columns.isDirty[index] = 1;
+		columns.dirty.push_back(index);
+	}
+}
+
+void StoreSetPose(Columns& columns, uint32_t index, const XrPosef& pose)
+{
+	columns.positionX[index] = pose.position.x;
+	columns.positionY[index] = pose.position.y;
+	columns.positionZ[index] = pose.position.z;
+	columns.orientationX[index] = pose.orientation.x;
+	columns.orientationY[index] = pose.orientation.y;
+	columns.orientationZ[index] = pose.orientation.z;
+	columns.orientationW[index] = pose.orientation.w;
+}
+
+const Slot& StoreGetSlot(const Store& store, Handle handle)
+{
+	return store.slots[GetSlot(handle)];
+}
+
+// Reuse a slot if there's one free, they keep count of how many times
+// they've been used so old handles to them stop working
+Handle StoreAllocateSlot(Store& store, Partition partition, uint32_t index)
+{
+	uint32_t slot = store.freeSlot;
+	if (slot == nullHandle)
+	{
+		slot = (uint32_t)store.slots.size();
+		store.slots.push_back({});
+	}
+	else
+	{
+		store.freeSlot = store.slots[slot].index;
+	}
+
+	Slot& s = store.slots[slot];
+	s.index = index;
+	s.partition = (uint8_t)partition;
+	s.isUsed = true;
+	return ((uint32_t)s.reuse << handleSlotBits) | slot;
+}
+
+void SceneStore::Clear(Store& store)
+{
+	for (int32_t i = 0; i < partitionCount; i++)
+	{
+		store.partitions[i] = {};
+		store.partitions[i].generation = ++store.generation;
+	}
+	store.slots.clear();
+	store.freeSlot = nullHandle;
+}
+
+Handle SceneStore::Add(Store& store, Partition partition, const XrPosef& pose, float scale, uint32_t color)
+{
+	Columns& columns = store.partitions[partition];
+	uint32_t index = columns.count++;
+	if (columns.count > columns.handles.size())
+		StoreResize(columns, columns.count);
+
+	Handle handle = StoreAllocateSlot(store, partition, index);
+	StoreSetPose(columns, index, pose);
+	columns.scale[index] = scale;
+	columns.color[index] = color;
+	columns.handles[index] = handle;
+	StoreMarkDirty(store, columns, index);
+	return handle;
+}
+
+void SceneStore::AddColumns(Store& store, Partition partition, const ColumnData& data, uint32_t count)
+{
+	PROFILE_ZONE("SceneStore::AddColumns");
+	Columns& columns = store.partitions[partition];
+	if (count == 0)
+		return;
+
+	// Copy whole columns at a time, then give every new cube a slot
+	uint32_t first = columns.count;
+	columns.count += count;
+	if (columns.count > columns.handles.size())
+		StoreResize(columns, columns.count);
+
+	memcpy(&columns.positionX[first], data.positionX, count * sizeof(float));
+	memcpy(&columns.positionY[first], data.positionY, count * sizeof(float));
+	memcpy(&columns.positionZ[first], data.positionZ, count * sizeof(float));
+	memcpy(&columns.orientationX[first], data.orientationX, count * sizeof(float));
+	memcpy(&columns.orientationY[first], data.orientationY, count * sizeof(float));
+	memcpy(&columns.orientationZ[first], data.orientationZ, count * sizeof(float));
+	memcpy(&columns.orientationW[first], data.orientationW, count * sizeof(float));
+	memcpy(&columns.scale[first], data.scale, count * sizeof(float));
+	memcpy(&columns.color[first], data.color, count * sizeof(uint32_t));
+
+	columns.generation = ++store.generation;
+	for (uint32_t index = first; index < columns.count; index++)
+	{
+		columns.handles[index] = StoreAllocateSlot(store, partition, index);
+		columns.changed[index] = columns.generation;
+		if (!columns.isDirty[index])
+		{
+			columns.isDirty[index] = 1;
+			columns.dirty.push_back(index);
+		}
+	}
+}
+
+void SceneStore::Remove(Store& store, Handle handle)
+{
+	if (!IsValid(store, handle))
+		return;
+
+	uint32_t slot = GetSlot(handle);
+	Slot& s = store.slots[slot];
+	Columns& columns = store.partitions[s.partition];
+
+	// Move the last cube into the gap, so the columns stay packed. The moved
+	// cube is dirty at its new index; anything past count is simply gone.
+	uint32_t index = s.index;
+	uint32_t last = --columns.count;
+	if (index != last)
+	{
+		columns.positionX[index] = columns.positionX[last];
+		columns.positionY[index] = columns.positionY[last];
+		columns.positionZ[index] = columns.positionZ[last];
+		columns.orientationX[index] = columns.orientationX[last];
+		columns.orientationY[index] = columns.orientationY[last];
+		columns.orientationZ[index] = columns.orientationZ[last];
+		columns.orientationW[index] = columns.orientationW[last];
+		columns.scale[index] = columns.scale[last];
+		columns.color[index] = columns.color[last];
+		columns.handles[index] = columns.handles[last];
+		store.slots[GetSlot(columns.handles[index])].index = index;
+		StoreMarkDirty(store, columns, index);
+	}
+	else
+	{
+		columns.generation = ++store.generation;
+	}
+	columns.handles[last] = nullHandle;
+
+	// Once the count reaches retiredReuse the slot is never used again,
+	// rather than wrapping round to handles that were given out before
+	s.isUsed = false;
+	s.reuse++;
+	if (s.reuse == retiredReuse)
+		return;
+	s.index = store.freeSlot;
+	store.freeSlot = slot;
+}
+
+bool SceneStore::IsValid(const Store& store, Handle handle)
+{
+	if (handle == nullHandle || GetSlot(handle) >= store.slots.size())
+		return false;
+	const Slot& s = StoreGetSlot(store, handle);
+	return s.isUsed && s.reuse == (uint8_t)(handle >> handleSlotBits);
+}
+
+void SceneStore::SetPose(Store& store, Handle handle, const XrPosef& pose)
+{
+	const Slot& s = StoreGetSlot(store, handle);
+	Columns& columns = store.partitions[s.partition];
+	StoreSetPose(columns, s.index, pose);
+	StoreMarkDirty(store, columns, s.index);
+}
+
+void SceneStore::SetScale(Store& store, Handle handle, float scale)
+{
+	const Slot& s = StoreGetSlot(store, handle);
+	Columns& columns = store.partitions[s.partition];
+	columns.scale[s.index] = scale;
+	StoreMarkDirty(store, columns, s.index);
+}
+
+void SceneStore::SetColor(Store& store, Handle handle, uint32_t color)
+{
+	const Slot& s = StoreGetSlot(store, handle);
+	Columns& columns = store.partitions[s.partition];
+	columns.color[s.index] = color;
+	StoreMarkDirty(store, columns, s.index);
+}
+
+XrPosef SceneStore::GetPose(const Store& store, Handle handle)
+{
+	const Slot& s = StoreGetSlot(store, handle);
+	return GetPose(store.partitions[s.partition], s.index);
+}
+
+XrPosef SceneStore::GetPose(const Columns& columns, uint32_t index)
+{
+	XrPosef pose;
+	pose.orientation = { columns.orientationX[index], columns.orientationY[index], columns.orientationZ[index], columns.orientationW[index] };
+	pose.position = { columns.positionX[index], columns.positionY[index], columns.positionZ[index] };
+	return pose;
+}
+
+float SceneStore::GetScale(const Store& store, Handle handle)
+{
+	const Slot& s = StoreGetSlot(store, handle);
+	return store.partitions[s.partition].scale[s.index];
+}
+
+uint32_t SceneStore::GetIndex(const Store& store, Handle handle)
+{
+	return StoreGetSlot(store, handle).index;
+}
+
+Partition SceneStore::GetPartition(const Store& store, Handle handle)
+{
+	return (Partition)StoreGetSlot(store, handle).partition;
+}
+
+void SceneStore::ClearDirty(Store& store, Partition partition)
+{
+	Columns& columns = store.partitions[partition];
+	for (uint32_t index : columns.dirty)
+	{
+		if (index < columns.isDirty.size())
+			columns.isDirty[index] = 0;
+	}
+	columns.dirty.clear();
+	columns.dirtySince = columns.generation;
+}
+
+void StoreBuildTransform(const Columns& columns, uint32_t i, InstanceTransform& transform)
+{
+	// The rotation matrix from the quaternion, with each column scaled, and
+	// the position in the last column
+	float x = columns.orientationX[i], y = columns.orientationY[i], z = columns.orientationZ[i], w = columns.orientationW[i];
+	float s = columns.scale[i];
+	transform = { {
+		{ s * (1 - 2 * (y * y + z * z)), s * 2 * (x * y - w * z),       s * 2 * (x * z + w * y),       columns.positionX[i] },
+		{ s * 2 * (x * y + w * z),       s * (1 - 2 * (x * x + z * z)), s * 2 * (y * z - w * x),       columns.positionY[i] },
+		{ s * 2 * (x * z - w * y),       s * 2 * (y * z + w * x),       s * (1 - 2 * (x * x + y * y)), columns.positionZ[i] },
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+	} };
+}
+
+void SceneStore::BuildTransforms(const Columns& columns, const uint32_t* indices, uint32_t count, InstanceTransform* transforms)
+{
+	PROFILE_ZONE("SceneStore::BuildTransforms");
+	for (uint32_t i = 0; i < count; i++)
+		StoreBuildTransform(columns, indices[i], transforms[i]);
+}
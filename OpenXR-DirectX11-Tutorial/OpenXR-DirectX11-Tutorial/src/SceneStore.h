@@ -0,0 +1,123 @@
+#pragma once
+
+#include "TutorialStructs.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Every cube in the scene, kept by field rather than by cube: all the x
+// positions together, then all the y positions, and so on, so anything that
+// walks the whole scene only reads the fields it needs.
+//
+// Cubes live in one of two partitions. Dynamic ones, like the cubes on the
+// hands, are expected to change every frame; static ones, like placed cubes,
+// rarely change at all. Within a partition cubes are packed, so removing one
+// moves the last one into its place. Handles stay the same however a cube
+// moves about, and a handle to a removed cube is never valid again.
+//
+// Every change marks the cube dirty and bumps a generation counter, so the
+// renderer, culling and picking can skip a partition that hasn't changed
+// since they last looked, and otherwise only touch the cubes that did.
+namespace SceneStore
+{
+	// The low bits are a slot, the high bits count how many times the slot
+	// has been reused. A slot is retired when the count reaches retiredReuse,
+	// so no handle is ever given out twice, and none is ever nullHandle.
+	typedef uint32_t Handle;
+
+	const Handle	nullHandle = 0xFFFFFFFF;
+	const uint32_t	handleSlotBits = 24;
+	const uint32_t	handleSlotMask = (1u << handleSlotBits) - 1;
+	const uint8_t	retiredReuse = 0xFF;
+
+	enum Partition
+	{
+		partitionDynamic,
+		partitionStatic,
+		partitionCount,
+	};
+
+	struct Columns
+	{
+		std::vector<float>		positionX, positionY, positionZ;
+		std::vector<float>		orientationX, orientationY, orientationZ, orientationW;
+		std::vector<float>		scale;		// Half the size of the cube
+		std::vector<uint32_t>	color;		// 0xAABBGGRR
+		std::vector<Handle>		handles;
+
+		// changed is the generation each cube last changed in. dirty lists
+		// every index that's changed since the last ClearDirty, once each;
+		// ones at or past count were removed.
+		std::vector<uint64_t>	changed;
+		std::vector<uint32_t>	dirty;
+		std::vector<uint8_t>	isDirty;
+
+		uint32_t				count = 0;
+		uint64_t				generation = 0;		// Of the last change to this partition
+		uint64_t				dirtySince = 0;		// dirty has every change after this generation
+	};
+
+	struct Slot
+	{
+		uint32_t	index;		// Into the partition's columns, or the next free slot
+		uint8_t		partition;
+		uint8_t		reuse;
+		bool		isUsed;
+	};
+
+	struct Store
+	{
+		Columns				partitions[partitionCount];
+		std::vector<Slot>	slots;
+		uint32_t			freeSlot = nullHandle;
+		uint64_t			generation = 0;
+	};
+
+	void		Clear(Store& store);
+
+	Handle		Add(Store& store, Partition partition, const XrPosef& pose, float scale, uint32_t color);
+
+	// Column pointers for adding lots of cubes at once, such as from a file
+	struct ColumnData
+	{
+		const float*	positionX;
+		const float*	positionY;
+		const float*	positionZ;
+		const float*	orientationX;
+		const float*	orientationY;
+		const float*	orientationZ;
+		const float*	orientationW;
+		const float*	scale;
+		const uint32_t*	color;
+	};
+	void		AddColumns(Store& store, Partition partition, const ColumnData& data, uint32_t count);
+	void		Remove(Store& store, Handle handle);
+	bool		IsValid(const Store& store, Handle handle);
+
+	void		SetPose(Store& store, Handle handle, const XrPosef& pose);
+	void		SetScale(Store& store, Handle handle, float scale);
+	void		SetColor(Store& store, Handle handle, uint32_t color);
+
+	XrPosef		GetPose(const Store& store, Handle handle);
+	XrPosef		GetPose(const Columns& columns, uint32_t index);
+	float		GetScale(const Store& store, Handle handle);
+
+	// Where a cube currently is in its partition's columns. Only good until
+	// the next Remove.
+	uint32_t	GetIndex(const Store& store, Handle handle);
+	Partition	GetPartition(const Store& store, Handle handle);
+
+	// The slot part of a handle, small and dense enough to index arrays by
+	inline uint32_t GetSlot(Handle handle) { return handle & handleSlotMask; }
+
+	// Call once everything that reads the dirty list has had a look, usually
+	// at the start of a frame. Something that reads the list less often can
+	// remember the generation it last saw instead, and only take cubes whose
+	// changed generation is newer. If what it saw is older than dirtySince,
+	// the list no longer has everything, and it needs to look at every cube.
+	void		ClearDirty(Store& store, Partition partition);
+
+	// World transforms for the cubes at the given indices of a partition, in
+	// the layout DrawTransforms wants
+	void		BuildTransforms(const Columns& columns, const uint32_t* indices, uint32_t count, InstanceTransform* transforms);
+}
@@ -0,0 +1,141 @@
+#include "SpaceLocator.h"
+#include "FrameTelemetry.h"
+#include "Profiler.h"
+
+#include "easylogging++.h"
+
+using namespace SpaceLocator;
+
+// A frame usually asks about one or two times (the predicted display time, and
+// maybe when a button was pressed), so a handful of cached times is plenty.
+const uint32_t				locatorCacheSize = 4;
+
+XrSession					locatorSession = XR_NULL_HANDLE;
+XrSpace						locatorBaseSpace = XR_NULL_HANDLE;
+XrSpace						locatorSpaces[maxSpaces] = {};
+uint32_t					locatorSpaceCount = 0;
+
+Locations					locatorCache[locatorCacheSize] = {};
+bool						locatorCacheValid[locatorCacheSize] = {};
+uint32_t					locatorCacheNext = 0;
+FrameTelemetry::CounterID	locatorRuntimeCalls = -1;
+
+// XR_KHR_locate_spaces came after the OpenXR headers we ship with. With newer
+// headers it gets picked up automatically.
+#if defined(XR_KHR_locate_spaces)
+PFN_xrLocateSpacesKHR		xrLocateSpacesKHREXT = nullptr;
+#endif
+
+void SpaceLocator::Init(XrInstance instance, XrSession session, XrSpace baseSpace)
+{
+	locatorSession = session;
+	locatorBaseSpace = baseSpace;
+	locatorRuntimeCalls = FrameTelemetry::RegisterCounter("Space locate calls");
+	NewFrame();
+
+#if defined(XR_KHR_locate_spaces)
+	xrGetInstanceProcAddr(instance, "xrLocateSpacesKHR", (PFN_xrVoidFunction*)(&xrLocateSpacesKHREXT));
+	if (xrLocateSpacesKHREXT != nullptr)
+		LOG(INFO) << "Locating spaces in batches with xrLocateSpacesKHR";
+#else
+	(void)instance;
+#endif
+}
+
+void SpaceLocator::Shutdown()
+{
+	locatorSpaceCount = 0;
+	locatorSession = XR_NULL_HANDLE;
+	locatorBaseSpace = XR_NULL_HANDLE;
+	NewFrame();
+}
+
+SpaceID SpaceLocator::Register(XrSpace space)
+{
+	if (locatorSpaceCount >= maxSpaces)
+	{
+		LOG(WARNING) << "SpaceLocator is full, raise maxSpaces";
+		return -1;
+	}
+
+	// Anything already cached doesn't have the new space in it
+	NewFrame();
+	locatorSpaces[locatorSpaceCount] = space;
+	return (SpaceID)locatorSpaceCount++;
+}
+
+void SpaceLocator::NewFrame()
+{
+	for (uint32_t i = 0; i < locatorCacheSize; i++)
+		locatorCacheValid[i] = false;
+}
+
+const Locations& SpaceLocator::Locate(XrTime time)
+{
+	for (uint32_t i = 0; i < locatorCacheSize; i++)
+	{
+		if (locatorCacheValid[i] && locatorCache[i].time == time)
+			return locatorCache[i];
+	}
+
+	PROFILE_ZONE("SpaceLocator::Locate");
+	uint32_t slot = locatorCacheNext;
+	locatorCacheNext = (locatorCacheNext + 1) % locatorCacheSize;
+	Locations& locations = locatorCache[slot];
+	locations.time = time;
+	locations.count = locatorSpaceCount;
+	locatorCacheValid[slot] = true;
+	if (locatorSpaceCount == 0)
+		return locations;
+
+#if defined(XR_KHR_locate_spaces)
+	if (xrLocateSpacesKHREXT != nullptr)
+	{
+		XrSpaceLocationDataKHR data[maxSpaces];
+		XrSpacesLocateInfoKHR locateInfo = { XR_TYPE_SPACES_LOCATE_INFO_KHR };
+		locateInfo.baseSpace = locatorBaseSpace;
+		locateInfo.time = time;
+		locateInfo.spaceCount = locatorSpaceCount;
+		locateInfo.spaces = locatorSpaces;
+		XrSpaceLocationsKHR spaceLocations = { XR_TYPE_SPACE_LOCATIONS_KHR };
+		spaceLocations.locationCount = locatorSpaceCount;
+		spaceLocations.locations = data;
+
+		XrResult result = xrLocateSpacesKHREXT(locatorSession, &locateInfo, &spaceLocations);
+		FrameTelemetry::Add(locatorRuntimeCalls);
+		for (uint32_t i = 0; i < locatorSpaceCount; i++)
+		{
+			locations.flags[i] = XR_UNQUALIFIED_SUCCESS(result) ? data[i].locationFlags : 0;
+			locations.position[i] = data[i].pose.position;
+			locations.orientation[i] = data[i].pose.orientation;
+		}
+		return locations;
+	}
+#endif
+
+	for (uint32_t i = 0; i < locatorSpaceCount; i++)
+	{
+		XrSpaceLocation location = { XR_TYPE_SPACE_LOCATION };
+		XrResult result = xrLocateSpace(locatorSpaces[i], locatorBaseSpace, time, &location);
+		locations.flags[i] = XR_UNQUALIFIED_SUCCESS(result) ? location.locationFlags : 0;
+		locations.position[i] = location.pose.position;
+		locations.orientation[i] = location.pose.orientation;
+	}
+	FrameTelemetry::Add(locatorRuntimeCalls, locatorSpaceCount);
+	return locations;
+}
+
+bool SpaceLocator::GetPose(SpaceID space, XrTime time, XrPosef& pose)
+{
+	if (space < 0 || (uint32_t)space >= locatorSpaceCount)
+		return false;
+
+	const Locations& locations = Locate(time);
+	const XrSpaceLocationFlags required = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT;
+	if ((locations.flags[space] & required) != required)
+		return false;
+
+	pose.orientation = locations.orientation[space];
+	pose.position = locations.position[space];
+	return true;
+}
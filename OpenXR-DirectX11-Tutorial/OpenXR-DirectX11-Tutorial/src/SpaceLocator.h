@@ -0,0 +1,47 @@
+#pragma once
+
+#include "OpenXR_setup.h"
+
+#include "openxr/openxr.h"
+
+#include <stdint.h>
+
+// Locates every space the app tracks in one go, for a given time. Hands today,
+// anchors and controllers later: register each space once, and a single
+// Locate call resolves all of them, with xrLocateSpacesKHR where the runtime
+// has it and a tight loop over xrLocateSpace where it doesn't.
+//
+// Results are kept per time value, so asking about another space at the same
+// time in the same frame costs nothing. NewFrame throws the results away,
+// since the runtime's predictions get better as the time gets closer.
+//
+// This is for the frame loop thread. The input sampler locates its own.
+namespace SpaceLocator
+{
+	typedef int32_t SpaceID;
+
+	const uint32_t maxSpaces = 32;
+
+	// One time value's worth of results, laid out by field so code that only
+	// wants positions (or only the flags) reads them straight through.
+	struct Locations
+	{
+		XrTime					time;
+		uint32_t				count;
+		XrSpaceLocationFlags	flags[maxSpaces];
+		XrVector3f				position[maxSpaces];
+		XrQuaternionf			orientation[maxSpaces];
+	};
+
+	void		Init(XrInstance instance, XrSession session, XrSpace baseSpace);
+	void		Shutdown();
+
+	// Returns -1 once maxSpaces are registered
+	SpaceID		Register(XrSpace space);
+
+	void		NewFrame();
+	const Locations&	Locate(XrTime time);
+
+	// True if the space's position and orientation were both valid at time
+	bool		GetPose(SpaceID space, XrTime time, XrPosef& pose);
+}
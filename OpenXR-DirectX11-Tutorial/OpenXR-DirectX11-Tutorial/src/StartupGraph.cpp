@@ -0,0 +1,132 @@
+#include "StartupGraph.h"
+#include "StartupTrace.h"
+#include "Platform.h"
+
+#include "easylogging++.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StartupTask
+{
+	std::string				name;
+	std::function<bool()>	work;
+	std::vector<StartupGraph::TaskID> dependents;
+	uint32_t				pendingDependencies;
+	bool					finished;
+	bool					succeeded;
+};
+
+// A deque so that adding tasks never moves the ones that are already there
+std::mutex							startupGraphLock;
+std::condition_variable				startupGraphWake;
+std::deque<StartupTask>				startupTasks;
+std::vector<StartupGraph::TaskID>	startupReadyTasks;
+uint32_t							startupUnfinishedTasks = 0;
+
+StartupGraph::TaskID StartupGraph::Add(const char* name, std::function<bool()> work, std::initializer_list<TaskID> dependencies)
+{
+	std::lock_guard<std::mutex> lock(startupGraphLock);
+
+	TaskID id = (TaskID)startupTasks.size();
+	startupTasks.push_back({ name, std::move(work), {}, 0, false, true });
+	StartupTask& task = startupTasks.back();
+
+	// Only wait on dependencies that haven't already finished. A dependency
+	// that failed means this task will never be able to succeed either.
+	for (TaskID dependency : dependencies)
+	{
+		StartupTask& dependencyTask = startupTasks[dependency];
+		if (!dependencyTask.finished)
+		{
+			dependencyTask.dependents.push_back(id);
+			task.pendingDependencies++;
+		}
+		else if (!dependencyTask.succeeded)
+		{
+			task.succeeded = false;
+		}
+	}
+
+	startupUnfinishedTasks++;
+	if (task.pendingDependencies == 0)
+	{
+		startupReadyTasks.push_back(id);
+		startupGraphWake.notify_one();
+	}
+	return id;
+}
+
+void StartupGraphWorker()
+{
+	std::unique_lock<std::mutex> lock(startupGraphLock);
+	while (true)
+	{
+		startupGraphWake.wait(lock, [] { return !startupReadyTasks.empty() || startupUnfinishedTasks == 0; });
+		if (startupReadyTasks.empty())
+			return;
+
+		StartupGraph::TaskID id = startupReadyTasks.back();
+		startupReadyTasks.pop_back();
+
+		// Run the task without holding the lock, so other workers can pick
+		// up tasks, and so the task itself can add new ones.
+		bool succeeded = startupTasks[id].succeeded;
+		if (succeeded)
+		{
+			std::function<bool()> work = std::move(startupTasks[id].work);
+			std::string name = startupTasks[id].name;
+			lock.unlock();
+			{
+				StartupTrace::Scope trace(name);
+				succeeded = work();
+			}
+			if (!succeeded)
+				LOG(ERROR) << "Startup task failed: " << name;
+			lock.lock();
+		}
+
+		StartupTask& task = startupTasks[id];
+		task.finished = true;
+		task.succeeded = succeeded;
+		for (StartupGraph::TaskID dependentID : task.dependents)
+		{
+			StartupTask& dependent = startupTasks[dependentID];
+			if (!succeeded)
+				dependent.succeeded = false;
+			if (--dependent.pendingDependencies == 0)
+				startupReadyTasks.push_back(dependentID);
+		}
+		startupUnfinishedTasks--;
+		startupGraphWake.notify_all();
+	}
+}
+
+bool StartupGraph::Run(uint32_t threadCount)
+{
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		workers.emplace_back([]()
+		{
+			Platform::SetCurrentThreadName("Startup Worker");
+			StartupGraphWorker();
+		});
+	}
+	StartupGraphWorker();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// Everything has run, so reset for the next time someone builds a graph
+	std::lock_guard<std::mutex> lock(startupGraphLock);
+	bool succeeded = true;
+	for (const StartupTask& task : startupTasks)
+		succeeded = succeeded && task.succeeded;
+	startupTasks.clear();
+	startupReadyTasks.clear();
+	return succeeded;
+}
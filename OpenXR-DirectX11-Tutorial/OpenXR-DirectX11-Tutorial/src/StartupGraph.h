@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <initializer_list>
+
+// Startup is a handful of slow stages, some of which depend on each other and
+// some of which don't. Each stage is added as a task along with the tasks it
+// has to wait for, and Run works through them on a small pool of threads,
+// starting every task as soon as its dependencies have finished.
+namespace StartupGraph
+{
+	typedef int32_t TaskID;
+
+	// Tasks return false to report failure. Anything depending on a failed
+	// task is skipped. It's fine to add more tasks from inside a running task.
+	TaskID	Add(const char* name, std::function<bool()> work, std::initializer_list<TaskID> dependencies = {});
+
+	// Runs every task that's been added and waits for all of them to finish.
+	// The calling thread helps out, so threadCount includes it.
+	bool	Run(uint32_t threadCount);
+}
@@ -0,0 +1,120 @@
+#include "StartupTrace.h"
+#include "Platform.h"
+
+#include "easylogging++.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+struct StartupTraceEvent
+{
+	std::string	name;
+	uint64_t	start;
+	uint64_t	duration;
+	uint32_t	threadID;
+	bool		instant;
+};
+
+std::mutex						startupTraceLock;
+std::vector<StartupTraceEvent>	startupTraceEvents;
+std::atomic<uint32_t>			startupTraceNextThreadID = { 1 };
+uint64_t						startupTraceOrigin = 0;
+
+// Chrome trace viewers group events by thread ID. std::thread::id isn't a
+// number, so every thread that records something gets a small one of its own.
+uint32_t StartupTraceThreadID()
+{
+	thread_local uint32_t threadID = startupTraceNextThreadID++;
+	return threadID;
+}
+
+void StartupTrace::Start()
+{
+	startupTraceOrigin = Platform::GetTimeNanoseconds();
+}
+
+uint64_t StartupTrace::GetStartTime()
+{
+	return startupTraceOrigin;
+}
+
+void StartupTrace::Record(const std::string& name, uint64_t startNanoseconds, uint64_t endNanoseconds)
+{
+	StartupTraceEvent traceEvent = { name, startNanoseconds, endNanoseconds - startNanoseconds, StartupTraceThreadID(), false };
+	std::lock_guard<std::mutex> lock(startupTraceLock);
+	startupTraceEvents.push_back(std::move(traceEvent));
+}
+
+void StartupTrace::Instant(const std::string& name)
+{
+	StartupTraceEvent traceEvent = { name, Platform::GetTimeNanoseconds(), 0, StartupTraceThreadID(), true };
+	std::lock_guard<std::mutex> lock(startupTraceLock);
+	startupTraceEvents.push_back(std::move(traceEvent));
+}
+
+std::string EscapeTraceString(const std::string& text)
+{
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+bool StartupTrace::Write(const char* path)
+{
+	std::lock_guard<std::mutex> lock(startupTraceLock);
+	if (startupTraceEvents.empty())
+		return true;
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG(WARNING) << "Unable to write the startup trace to " << path;
+		return false;
+	}
+
+	// Timestamps are in microseconds, and relative to application start (or
+	// the first thing we recorded) so the timeline starts at zero.
+	uint64_t origin = startupTraceEvents[0].start;
+	for (const StartupTraceEvent& traceEvent : startupTraceEvents)
+		origin = traceEvent.start < origin ? traceEvent.start : origin;
+	if (startupTraceOrigin != 0 && startupTraceOrigin < origin)
+		origin = startupTraceOrigin;
+
+	file << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < startupTraceEvents.size(); i++)
+	{
+		const StartupTraceEvent& traceEvent = startupTraceEvents[i];
+		file << "{\"name\":\"" << EscapeTraceString(traceEvent.name) << "\",\"cat\":\"startup\",\"pid\":1,\"tid\":" << traceEvent.threadID
+			<< ",\"ts\":" << (traceEvent.start - origin) / 1000.0;
+		if (traceEvent.instant)
+			file << ",\"ph\":\"i\",\"s\":\"g\"}";
+		else
+			file << ",\"ph\":\"X\",\"dur\":" << traceEvent.duration / 1000.0 << "}";
+		file << (i + 1 < startupTraceEvents.size() ? ",\n" : "\n");
+	}
+	file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+	LOG(INFO) << "Startup trace written to " << path;
+	return true;
+}
+
+StartupTrace::Scope::Scope(const char* name) : name(name), start(Platform::GetTimeNanoseconds())
+{
+}
+
+StartupTrace::Scope::Scope(std::string name) : name(std::move(name)), start(Platform::GetTimeNanoseconds())
+{
+}
+
+StartupTrace::Scope::~Scope()
+{
+	Record(name, start, Platform::GetTimeNanoseconds());
+}
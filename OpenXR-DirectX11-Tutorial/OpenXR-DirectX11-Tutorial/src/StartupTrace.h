@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// A very small timeline recorder for application startup. Each Scope records
+// one complete event, and Write dumps them all out as a Chrome trace, which
+// can be opened in chrome://tracing or https://ui.perfetto.dev
+namespace StartupTrace
+{
+	// Marks the moment the application started, everything is relative to this
+	void		Start();
+	uint64_t	GetStartTime();
+
+	void	Record(const std::string& name, uint64_t startNanoseconds, uint64_t endNanoseconds);
+	void	Instant(const std::string& name);
+	bool	Write(const char* path);
+
+	struct Scope
+	{
+		Scope(const char* name);
+		Scope(std::string name);
+		~Scope();
+
+		std::string	name;
+		uint64_t	start;
+	};
+}
@@ -1,44 +1,62 @@
-#pragma once
-
-#include "OpenXR_setup.h"
-
-#include <d3d11.h>
-#include <directxmath.h>
-#include <d3dcompiler.h>
-#include <vector>
-
-#include "openxr/openxr.h"
-#include "openxr/openxr_platform.h"
-
-struct SwapchainSurfacedata 
-{
-	ID3D11DepthStencilView* depthView;
-	ID3D11RenderTargetView* targetView;
-};
-
-struct Swapchain 
-{
-	XrSwapchain handle;
-	int32_t     width;
-	int32_t     height;
-	std::vector<XrSwapchainImageD3D11KHR> surfaceImages;
-	std::vector<SwapchainSurfacedata>     surfaceData;
-};
-
-struct InputState 
-{
-	XrActionSet actionSet;
-	XrAction    poseAction;
-	XrAction    selectAction;
-	XrPath   handSubactionPath[2];
-	XrSpace  handSpace[2];
-	XrPosef  handPose[2];
-	XrBool32 renderHand[2];
-	XrBool32 handSelect[2];
-};
-
-struct TransformBuffer 
-{
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 viewproj;
-};
\ No newline at end of file
+#pragma once
+
+#include "OpenXR_setup.h"
+#include "Platform.h"
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+#include <d3d11.h>
+#include <directxmath.h>
+#include <d3dcompiler.h>
+#endif
+#include <vector>
+
+#include "openxr/openxr.h"
+#include "openxr/openxr_platform.h"
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+struct SwapchainSurfacedata 
+{
+	ID3D11DepthStencilView* depthView;
+	ID3D11RenderTargetView* targetView;
+};
+
+struct Swapchain 
+{
+	XrSwapchain handle;
+	int32_t     width;
+	int32_t     height;
+	std::vector<XrSwapchainImageD3D11KHR> surfaceImages;
+	std::vector<SwapchainSurfacedata>     surfaceData;
+};
+#endif
+
+// A world transform for one instance of a mesh, laid out the way the shaders
+// want it: column vectors, stored a row at a time. It's the same layout as a
+// transposed DirectX::XMFLOAT4X4, and the renderer uploads its top three rows.
+struct InstanceTransform
+{
+	float m[4][4];
+};
+
+struct InputState 
+{
+	XrActionSet actionSet;
+	XrAction    poseAction;
+	XrAction    selectAction;
+	XrPath   handSubactionPath[2];
+	XrSpace  handSpace[2];
+	XrPosef  handPose[2];
+	XrBool32 renderHand[2];
+	XrBool32 handSelect[2];
+	// With the input sampler running, it picks as select is pressed, and
+	// this is the cube it hit (a SceneStore::Handle, nullHandle for none)
+	XrBool32 handPicked[2];
+	uint32_t handPickedCube[2];
+};
+
+#if defined(XR_USE_GRAPHICS_API_D3D11)
+struct TransformBuffer 
+{
+	DirectX::XMFLOAT4X4 viewproj;
+};
+#endif
\ No newline at end of file
@@ -1,4 +1,4 @@
-#pragma once
-
-// Utility functions
-bool xrValidate(XrInstance instance, XrResult result, const char* message, ...);
+#pragma once
+
+// Utility functions
+bool xrValidate(XrInstance instance, XrResult result, const char* message, ...);